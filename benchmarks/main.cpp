@@ -0,0 +1,423 @@
+#include "Rendering/OpenGL/OpenGLPipeline.h"
+#include "Rendering/CPU/CPUPipeline.h"
+#include "Scenes/ProceduralScenes.h"
+
+namespace {
+	/**
+	 * This is the configuration given on the command line.
+	 */
+	struct Options {
+		std::vector<std::string> scenes;
+
+		std::vector<glm::uvec2> resolutions;
+
+		/**
+		 * The number of measured frames for each scene and resolution.
+		 */
+		glm::uint32 frames = 30;
+
+		/**
+		 * The number of frames rendered (and not measured) before measured ones.
+		 */
+		glm::uint32 warmupFrames = 3;
+
+		/**
+		 * Measure the CPU renderer instead of the OpenGL one: no OpenGL context is created.
+		 */
+		bool cpu = false;
+
+		/**
+		 * The number of threads of the CPU renderer, 0 means one for each hardware thread.
+		 */
+		glm::uint32 threads = 0;
+
+		/**
+		 * The number of work groups of the persistent threads rendering mode, 0 dispatches one work group for each screen tile.
+		 */
+		glm::uint32 persistentThreads = 0;
+
+		/**
+		 * The JSON report file, the report is written on the standard output when empty.
+		 */
+		std::string output;
+	};
+
+	/**
+	 * This is the measurement of a scene at a resolution.
+	 */
+	struct BenchmarkResult {
+		std::string scene;
+
+		size_t modelsCount;
+
+		size_t primitivesCount;
+
+		glm::uvec2 resolution;
+
+		glm::uint32 frames;
+
+		/**
+		 * The time needed to place the whole scene on the pipeline, waiting for the GPU (if any) to complete.
+		 */
+		glm::float64 insertWallMilliseconds;
+
+		/**
+		 * Timings of measured frames, from the submission to the completion of the frame.
+		 */
+		Tachyon::Rendering::StageStatistics frameWall;
+
+		/**
+		 * Timings of each pipeline stage, measured on the GPU by the OpenGL renderer.
+		 */
+		std::vector<Tachyon::Rendering::StageStatistics> stages;
+
+		/**
+		 * Millions of primary rays traced each second by the render stage.
+		 */
+		glm::float64 megaRaysPerSecond;
+	};
+
+	void printUsage(const char* program) {
+		std::cout << "Usage: " << program << " [options]" << std::endl
+			<< "  --scenes <a,b,...>          scenes to measure (default: all but demo), among:";
+		for (const auto& name : Tachyon::Scenes::getSceneNames())
+			std::cout << " " << name;
+		std::cout << std::endl
+			<< "  --resolutions <WxH,...>     resolutions to measure (default 320x240,640x480,1280x720)" << std::endl
+			<< "  --frames <count>            measured frames for each scene and resolution (default 30)" << std::endl
+			<< "  --warmup <count>            frames rendered before measuring (default 3)" << std::endl
+			<< "  --persistent-threads <groups>  render with this many work groups pulling screen tiles (default 0: one work group for each tile)" << std::endl
+			<< "  --cpu                       measure the CPU renderer instead of the OpenGL one (not with --persistent-threads)" << std::endl
+			<< "  --threads <count>           the number of CPU rendering threads (default 0: one for each hardware thread)" << std::endl
+			<< "  --output <file>             the JSON report (default: standard output)" << std::endl;
+	}
+
+	std::vector<std::string> split(const std::string& text, char separator) {
+		std::vector<std::string> tokens;
+
+		std::istringstream stream(text);
+		std::string token;
+		while (std::getline(stream, token, separator))
+			if (!token.empty()) tokens.push_back(token);
+
+		return tokens;
+	}
+
+	bool parseUnsigned(const std::string& text, glm::uint32& value) {
+		char* end = nullptr;
+		const unsigned long parsed = std::strtoul(text.c_str(), &end, 10);
+		if ((end == text.c_str()) || (*end != '\0') || (parsed > std::numeric_limits<glm::uint32>::max())) return false;
+
+		value = glm::uint32(parsed);
+		return true;
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options) {
+		for (int i = 1; i < argc; ++i) {
+			const std::string option(argv[i]);
+
+			if (option == "--cpu") {
+				options.cpu = true;
+				continue;
+			}
+
+			// Every other option has a value
+			if (i + 1 >= argc) return false;
+			const std::string value(argv[++i]);
+
+			if (option == "--scenes") {
+				options.scenes = split(value, ',');
+			} else if (option == "--resolutions") {
+				options.resolutions.clear();
+				for (const auto& resolution : split(value, ',')) {
+					const std::vector<std::string> sizes = split(resolution, 'x');
+
+					glm::uvec2 size;
+					if ((sizes.size() != 2) || (!parseUnsigned(sizes[0], size.x)) || (!parseUnsigned(sizes[1], size.y)) || (size.x == 0) || (size.y == 0)) return false;
+					options.resolutions.push_back(size);
+				}
+			} else if (option == "--frames") {
+				if ((!parseUnsigned(value, options.frames)) || (options.frames == 0)) return false;
+			} else if (option == "--warmup") {
+				if (!parseUnsigned(value, options.warmupFrames)) return false;
+			} else if (option == "--persistent-threads") {
+				if (!parseUnsigned(value, options.persistentThreads)) return false;
+			} else if (option == "--threads") {
+				if (!parseUnsigned(value, options.threads)) return false;
+			} else if (option == "--output") {
+				options.output = value;
+			} else {
+				return false;
+			}
+		}
+
+		if (options.scenes.empty())
+			for (const auto& name : Tachyon::Scenes::getSceneNames())
+				if (name != "demo") options.scenes.push_back(name);
+
+		if (options.resolutions.empty())
+			options.resolutions = { glm::uvec2(320, 240), glm::uvec2(640, 480), glm::uvec2(1280, 720) };
+
+		// Persistent work groups are an OpenGL dispatch mode
+		if ((options.cpu) && (options.persistentThreads != 0)) return false;
+
+		// Threads are counted as the thread pool does, so that the report tells how many have been used
+		if ((options.cpu) && (options.threads == 0)) options.threads = std::max(glm::uint32(std::thread::hardware_concurrency()), glm::uint32(1));
+
+		return true;
+	}
+
+	const Tachyon::Rendering::StageStatistics* findStage(const std::vector<Tachyon::Rendering::StageStatistics>& stages, const std::string& name) {
+		for (const auto& stage : stages)
+			if (stage.name == name) return &stage;
+
+		return nullptr;
+	}
+
+	/**
+	 * Measure a scene at the given resolution on a new pipeline.
+	 *
+	 * Every measured frame moves all models, so that the TLAS update is measured as well.
+	 *
+	 * @param raytracer the pipeline, with nothing placed on it yet
+	 * @param finish waits for the completion of the work submitted to the pipeline
+	 * @param result the measurement, whose scene and resolution are already set
+	 */
+	void measurePipeline(Tachyon::Rendering::RenderingPipeline& raytracer, const std::function<void()>& finish, const Tachyon::Scenes::Scene& scene, const glm::uvec2& resolution, const Options& options, BenchmarkResult& result) {
+		finish();
+		const glm::uint64 insertBegin = Tachyon::Rendering::FrameProfiler::now();
+		Tachyon::Scenes::loadScene(scene, raytracer);
+		finish();
+		result.insertWallMilliseconds = glm::float64(Tachyon::Rendering::FrameProfiler::now() - insertBegin) / glm::float64(1000000);
+
+		// GPU timings are read back by the next frame: keep the insertion ones before forgetting warm-up frames
+		for (glm::uint32 frame = 0; frame < std::max(options.warmupFrames, glm::uint32(1)); ++frame) {
+			raytracer.render(resolution.x, resolution.y);
+			finish();
+		}
+
+		const std::vector<Tachyon::Rendering::StageStatistics> warmupStages = raytracer.getFrameStats();
+		const Tachyon::Rendering::StageStatistics* const insertStage = findStage(warmupStages, "Insert");
+		if (insertStage) result.stages.push_back(*insertStage);
+
+		raytracer.resetFrameStats();
+
+		Tachyon::Rendering::FrameProfiler frameProfiler(options.frames);
+
+		// Instances are moved as models are
+		std::vector<Tachyon::Rendering::ModelTransform> transforms;
+		transforms.reserve(result.modelsCount);
+		for (const auto& model : scene.models)
+			transforms.push_back(Tachyon::Rendering::ModelTransform{ model.location, glm::mat4(1) });
+		for (const auto& instance : scene.instances)
+			transforms.push_back(Tachyon::Rendering::ModelTransform{ instance.location, glm::mat4(1) });
+		for (const auto& transform : scene.transforms)
+			for (auto& movedTransform : transforms)
+				if (movedTransform.location == transform.location) movedTransform.transform = transform.transform;
+		const std::vector<Tachyon::Rendering::ModelTransform> initialTransforms(transforms);
+
+		for (glm::uint32 frame = 0; frame < options.frames; ++frame) {
+			// Spin every model a little around its own vertical axis
+			const glm::float32 angle = glm::float32(0.01) * glm::float32(frame + 1);
+			for (size_t i = 0; i < transforms.size(); ++i)
+				transforms[i].transform = initialTransforms[i].transform * glm::rotate(angle, glm::vec3(0, 1, 0));
+
+			const glm::uint64 frameBegin = Tachyon::Rendering::FrameProfiler::now();
+
+			raytracer.setModelTransforms(transforms);
+			raytracer.render(resolution.x, resolution.y);
+			finish();
+
+			frameProfiler.record("Frame", frameBegin, Tachyon::Rendering::FrameProfiler::now());
+		}
+
+		result.frameWall = frameProfiler.getStatistics().front();
+
+		// The last frame is accounted only when the next one is rendered
+		for (const auto& stage : raytracer.getFrameStats())
+			result.stages.push_back(stage);
+
+		const Tachyon::Rendering::StageStatistics* const renderStage = findStage(result.stages, "Render");
+		const glm::float64 renderMilliseconds = (renderStage) ? renderStage->averageMilliseconds : result.frameWall.averageMilliseconds;
+		result.megaRaysPerSecond = (glm::float64(resolution.x) * glm::float64(resolution.y)) / (std::max(renderMilliseconds, glm::float64(1e-6)) * glm::float64(1000));
+	}
+
+	/**
+	 * Measure a scene at the given resolution on a new pipeline of the renderer given on the command line.
+	 */
+	BenchmarkResult runBenchmark(const std::string& sceneName, const Tachyon::Scenes::Scene& scene, const glm::uvec2& resolution, const Options& options) {
+		BenchmarkResult result;
+		result.scene = sceneName;
+		result.modelsCount = scene.models.size() + scene.instances.size();
+		result.primitivesCount = scene.getPrimitivesCount();
+		result.resolution = resolution;
+		result.frames = options.frames;
+
+		// CPU frames are complete as soon as render returns
+		if (options.cpu) {
+			Tachyon::Rendering::CPU::CPUPipeline raytracer(scene.capacity, options.threads);
+			measurePipeline(raytracer, []() {}, scene, resolution, options, result);
+
+			return result;
+		}
+
+		// Render offscreen, as the hidden window framebuffer may not be backed by memory
+		GLuint framebuffer = 0, colorbuffer = 0;
+		glCreateRenderbuffers(1, &colorbuffer);
+		glNamedRenderbufferStorage(colorbuffer, GL_RGBA8, GLsizei(resolution.x), GLsizei(resolution.y));
+		glCreateFramebuffers(1, &framebuffer);
+		glNamedFramebufferRenderbuffer(framebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorbuffer);
+		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+		std::unique_ptr<Tachyon::Rendering::OpenGL::OpenGLPipeline> raytracer(new Tachyon::Rendering::OpenGL::OpenGLPipeline(scene.capacity));
+		raytracer->setPersistentThreads(options.persistentThreads);
+
+		measurePipeline(*raytracer, []() { glFinish(); }, scene, resolution, options, result);
+
+		raytracer.reset();
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &framebuffer);
+		glDeleteRenderbuffers(1, &colorbuffer);
+
+		return result;
+	}
+
+	void writeStatistics(std::ostream& json, const Tachyon::Rendering::StageStatistics& statistics) {
+		json << "{\"samples\": " << statistics.samplesCount
+			<< ", \"minMs\": " << statistics.minMilliseconds
+			<< ", \"avgMs\": " << statistics.averageMilliseconds
+			<< ", \"p99Ms\": " << statistics.p99Milliseconds << "}";
+	}
+
+	void writeReport(std::ostream& json, const std::string& renderer, const Options& options, const std::vector<BenchmarkResult>& results) {
+		json << std::fixed << std::setprecision(4);
+
+		// The dispatch mode is the same for every result: 0 persistent work groups is one work group for each screen tile,
+		// the CPU renderer always schedules screen tiles on its threads
+		json << "{" << std::endl
+			<< "  \"renderer\": \"" << renderer << "\"," << std::endl
+			<< "  \"backend\": \"" << ((options.cpu) ? "cpu" : "opengl") << "\"," << std::endl
+			<< "  \"threads\": " << options.threads << "," << std::endl
+			<< "  \"dispatch\": \"" << ((options.persistentThreads != 0) ? "persistent" : "tiles") << "\"," << std::endl
+			<< "  \"persistentThreads\": " << options.persistentThreads << "," << std::endl
+			<< "  \"results\": [";
+
+		for (size_t i = 0; i < results.size(); ++i) {
+			const BenchmarkResult& result = results[i];
+
+			json << ((i == 0) ? "" : ",") << std::endl
+				<< "    {" << std::endl
+				<< "      \"scene\": \"" << result.scene << "\"," << std::endl
+				<< "      \"models\": " << result.modelsCount << "," << std::endl
+				<< "      \"spheres\": " << result.primitivesCount << "," << std::endl
+				<< "      \"width\": " << result.resolution.x << "," << std::endl
+				<< "      \"height\": " << result.resolution.y << "," << std::endl
+				<< "      \"frames\": " << result.frames << "," << std::endl
+				<< "      \"insertWallMs\": " << result.insertWallMilliseconds << "," << std::endl
+				<< "      \"frameWall\": ";
+			writeStatistics(json, result.frameWall);
+			json << "," << std::endl
+				<< "      \"stages\": {";
+
+			for (size_t s = 0; s < result.stages.size(); ++s) {
+				json << ((s == 0) ? "" : ",") << std::endl
+					<< "        \"" << result.stages[s].name << "\": ";
+				writeStatistics(json, result.stages[s]);
+			}
+
+			json << std::endl << "      }," << std::endl
+				<< "      \"mraysPerSecond\": " << result.megaRaysPerSecond << std::endl
+				<< "    }";
+		}
+
+		json << std::endl << "  ]" << std::endl << "}" << std::endl;
+	}
+}
+
+int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+
+		return EXIT_FAILURE;
+	}
+
+	// Generate scenes upfront, so that a wrong name does not waste a whole run
+	std::vector<Tachyon::Scenes::Scene> scenes(options.scenes.size());
+	for (size_t i = 0; i < options.scenes.size(); ++i) {
+		if (!Tachyon::Scenes::makeScene(options.scenes[i], scenes[i])) {
+			std::cerr << "Error: unknown scene " << options.scenes[i] << std::endl;
+
+			return EXIT_FAILURE;
+		}
+	}
+
+	// The CPU renderer needs no OpenGL context
+	GLFWwindow* window = nullptr;
+	std::string renderer = std::string("CPU, ") + std::to_string(options.threads) + std::string(" threads");
+	if (!options.cpu) {
+		if (glfwInit() == 0) {
+			std::cerr << "Error: cannot initialize GLFW" << std::endl;
+
+			return EXIT_FAILURE;
+		}
+
+		// The hidden window only provides the OpenGL context
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+		window = glfwCreateWindow(64, 64, "Tachyon Benchmark", nullptr, nullptr);
+
+		if (!window) {
+			std::cerr << "Error: cannot create an OpenGL context" << std::endl;
+
+			return EXIT_FAILURE;
+		}
+
+		glfwMakeContextCurrent(window);
+
+		if ((gl3wInit()) || (!gl3wIsSupported(4, 5))) {
+			std::cerr << "Error: OpenGL 4.5 is required to run this benchmark" << std::endl;
+
+			return EXIT_FAILURE;
+		}
+
+		renderer =
+			std::string((const char*)glGetString(GL_RENDERER)) +
+			std::string(", OpenGL v") +
+			std::string((const char*)glGetString(GL_VERSION));
+	}
+
+	// Progress goes on the standard error, so that the report can be redirected
+	std::vector<BenchmarkResult> results;
+	for (size_t i = 0; i < scenes.size(); ++i) {
+		for (const auto& resolution : options.resolutions) {
+			std::cerr << "Measuring " << options.scenes[i] << " at " << resolution.x << "x" << resolution.y << std::endl;
+
+			results.push_back(runBenchmark(options.scenes[i], scenes[i], resolution, options));
+		}
+	}
+
+	if (options.output.empty()) {
+		writeReport(std::cout, renderer, options, results);
+	} else {
+		std::ofstream report(options.output, std::ios::out | std::ios::trunc);
+		writeReport(report, renderer, options, results);
+
+		if (!report.good()) {
+			std::cerr << "Error: cannot write " << options.output << std::endl;
+
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (window) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
+
+	return EXIT_SUCCESS;
+}
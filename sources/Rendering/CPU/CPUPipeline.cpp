@@ -0,0 +1,833 @@
+#include "Rendering/CPU/CPUPipeline.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::CPU;
+
+constexpr glm::uint32 CPUPipeline::tileWidth;
+constexpr glm::uint32 CPUPipeline::tileHeight;
+
+namespace {
+	const glm::float32 PI = glm::float32(3.14159265359);
+
+	/**
+	 * The maximum number of pending nodes during a traversal: each level of the tree pushes at most one pending node.
+	 */
+	const size_t traversalStackSize = 64;
+
+	/**
+	 * This is the light reaching surfaces in shadow, as in raytrace.comp.
+	 */
+	const glm::float32 ambientLight = glm::float32(0.1);
+
+	/**
+	 * The number of rays cast by each task of a ray query batch.
+	 */
+	const size_t rayQueriesOnTask = 256;
+
+	glm::uint32 leftNode(glm::uint32 i) noexcept {
+		return (2 * i + 1);
+	}
+
+	glm::uint32 rightNode(glm::uint32 i) noexcept {
+		return (2 * i + 2);
+	}
+
+	/**
+	 * Get the index of the first leaf of a linearized complete binary tree.
+	 *
+	 * @param expOfTwo_leaves the tree has (1 << expOfTwo_leaves) leaves
+	 * @return the index of the first leaf in the linearized tree
+	 */
+	glm::uint32 firstLeafNode(glm::uint32 expOfTwo_leaves) noexcept {
+		return (glm::uint32(1) << expOfTwo_leaves) - 1;
+	}
+}
+
+CPUPipeline::CPUPipeline(const SceneCapacity& capacity, size_t workersCount) noexcept
+	: RenderingPipeline(capacity),
+	mCapacity(capacity),
+	mThreadPool(workersCount),
+	mInstances(size_t(1) << capacity.expOfTwo_maxModels),
+	mTLAS((size_t(1) << (capacity.expOfTwo_maxModels + 1)) - 1, emptyAABB()),
+	mModelDirtyFlags(size_t(1) << capacity.expOfTwo_maxModels, false),
+	mTraversalStatisticsCollection(false),
+	mRaysCount(0),
+	mTotalNodeVisits(0),
+	mMaxNodeVisits(0),
+	mNextRayQueryBatch(0) {}
+
+CPUPipeline::~CPUPipeline() {}
+
+const std::vector<glm::vec4>& CPUPipeline::getOutput() const noexcept {
+	return mOutput;
+}
+
+void CPUPipeline::getDisplayPixels(std::vector<glm::uint8>& pixels) const noexcept {
+	pixels.resize(mOutput.size() * 3);
+
+	// Exposure tone mapping and gamma correction, as tonemapping.frag applies them
+	for (size_t i = 0; i < mOutput.size(); ++i) {
+		const glm::vec3 mapped = glm::vec3(1) - glm::exp(-glm::vec3(mOutput[i]) * toneMappingExposure);
+		const glm::vec3 corrected = glm::pow(mapped, glm::vec3(glm::float32(1) / toneMappingGamma));
+
+		for (size_t channel = 0; channel < 3; ++channel)
+			pixels[(i * 3) + channel] = glm::uint8(glm::clamp(corrected[channel], glm::float32(0), glm::float32(1)) * glm::float32(255) + glm::float32(0.5));
+	}
+}
+
+size_t CPUPipeline::getWorkersCount() const noexcept {
+	return mThreadPool.getWorkersCount();
+}
+
+void CPUPipeline::setTraversalStatisticsCollection(bool enabled) noexcept {
+	mTraversalStatisticsCollection = enabled;
+}
+
+TraversalStatistics CPUPipeline::getTraversalStatistics() const noexcept {
+	TraversalStatistics statistics;
+	statistics.raysCount = mRaysCount.load();
+	statistics.totalNodeVisits = mTotalNodeVisits.load();
+	statistics.maxNodeVisits = mMaxNodeVisits.load();
+	return statistics;
+}
+
+CPUPipeline::AABB CPUPipeline::emptyAABB() noexcept {
+	AABB aabb;
+	aabb.vMin = glm::vec3(std::numeric_limits<glm::float32>::infinity());
+	aabb.vMax = glm::vec3(-std::numeric_limits<glm::float32>::infinity());
+	return aabb;
+}
+
+bool CPUPipeline::isEmpty(const AABB& aabb) noexcept {
+	return (aabb.vMin.x > aabb.vMax.x) || (aabb.vMin.y > aabb.vMax.y) || (aabb.vMin.z > aabb.vMax.z);
+}
+
+CPUPipeline::AABB CPUPipeline::joinAABBs(const AABB& aabb1, const AABB& aabb2) noexcept {
+	AABB aabb;
+	aabb.vMin = glm::min(aabb1.vMin, aabb2.vMin);
+	aabb.vMax = glm::max(aabb1.vMax, aabb2.vMax);
+	return aabb;
+}
+
+CPUPipeline::AABB CPUPipeline::transformAABB(const AABB& aabb, const glm::mat4& transformMatrix) noexcept {
+	if (isEmpty(aabb)) return aabb;
+
+	AABB transformed = emptyAABB();
+
+	for (glm::uint32 i = 0; i < 8; ++i) {
+		const glm::vec3 vertex(
+			(i & 0x04) ? aabb.vMax.x : aabb.vMin.x,
+			(i & 0x02) ? aabb.vMax.y : aabb.vMin.y,
+			(i & 0x01) ? aabb.vMax.z : aabb.vMin.z
+		);
+
+		const glm::vec3 transformedVertex = glm::vec3(transformMatrix * glm::vec4(vertex, 1));
+
+		transformed.vMin = glm::min(transformed.vMin, transformedVertex);
+		transformed.vMax = glm::max(transformed.vMax, transformedVertex);
+	}
+
+	return transformed;
+}
+
+bool CPUPipeline::intersectAABB(const Ray& ray, const glm::vec3& invDirection, const AABB& aabb, glm::float32 minDistance, glm::float32 maxDistance, glm::float32& entryDistance) noexcept {
+	if (isEmpty(aabb)) return false;
+
+	const glm::vec3 t0 = (aabb.vMin - ray.origin) * invDirection;
+	const glm::vec3 t1 = (aabb.vMax - ray.origin) * invDirection;
+
+	const glm::vec3 tNear = glm::min(t0, t1);
+	const glm::vec3 tFar = glm::max(t0, t1);
+
+	const glm::float32 tEnter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, minDistance));
+	const glm::float32 tExit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+
+	entryDistance = tEnter;
+
+	return tEnter <= tExit;
+}
+
+CPUPipeline::RayGeometryIntersection CPUPipeline::missedIntersection() noexcept {
+	RayGeometryIntersection miss;
+	miss.dist = std::numeric_limits<glm::float32>::infinity();
+	miss.point = glm::vec3(0);
+	miss.normal = glm::vec3(0);
+	miss.location = noModelHit;
+
+	return miss;
+}
+
+CPUPipeline::RayGeometryIntersection CPUPipeline::intersectGeometry(const Ray& ray, const glm::vec4& geometry, glm::float32 minDistance, glm::float32 maxDistance) noexcept {
+	const RayGeometryIntersection miss = missedIntersection();
+
+	const glm::vec3 center = glm::vec3(geometry.x, geometry.y, geometry.z);
+	const glm::float32 radius = geometry.w;
+
+	if (radius == 0) return miss;
+
+	const glm::vec3 oc = ray.origin - center;
+
+	const glm::float32 a = glm::dot(ray.direction, ray.direction);
+	const glm::float32 b = glm::dot(oc, ray.direction);
+	const glm::float32 c = glm::dot(oc, oc) - radius * radius;
+	const glm::float32 discriminant = b * b - a * c;
+
+	// if delta > 0 then we have two intersections (one for each side of the sphere)
+	if (discriminant <= 0) return miss;
+
+	const glm::float32 squareRoot = std::sqrt(discriminant);
+
+	// Choose the closest intersection point within the valid range
+	glm::float32 dist = (-b - squareRoot) / a;
+	if ((dist <= minDistance) || (dist >= maxDistance)) {
+		dist = (-b + squareRoot) / a;
+
+		if ((dist <= minDistance) || (dist >= maxDistance)) return miss;
+	}
+
+	RayGeometryIntersection hit;
+	hit.location = noModelHit;
+	hit.dist = dist;
+	hit.point = ray.origin + dist * ray.direction;
+	hit.normal = (hit.point - center) / radius;
+	return hit;
+}
+
+CPUPipeline::Ray CPUPipeline::generateCameraRay(const glm::vec3& lookFrom, const glm::vec3& viewDirection, const glm::vec3& up, glm::float32 fieldOfView, glm::float32 aspect, glm::float32 s, glm::float32 t) noexcept {
+	const glm::float32 theta = fieldOfView * PI / 180;
+	const glm::float32 half_height = std::tan(theta / glm::float32(2));
+	const glm::float32 half_width = aspect * half_height;
+	const glm::vec3 w = -viewDirection;
+	const glm::vec3 u = glm::normalize(glm::cross(up, w));
+	const glm::vec3 v = glm::cross(w, u);
+	const glm::vec3 lowerLeftCorner = lookFrom - half_width * u - half_height * v - w;
+	const glm::vec3 horizontal = glm::float32(2) * (u * half_width);
+	const glm::vec3 vertical = glm::float32(2) * (v * half_height);
+
+	Ray ray;
+	ray.origin = lookFrom;
+	ray.direction = glm::normalize(lowerLeftCorner + s * horizontal + t * vertical - lookFrom);
+	return ray;
+}
+
+CPUPipeline::AABB CPUPipeline::collectionAABB_ByIndexes(const BLAS& blas, size_t collectionIndex) const noexcept {
+	AABB bounding = emptyAABB();
+
+	for (size_t i = 0; i < (size_t(1) << mCapacity.expOfTwo_maxGeometryOnCollection); ++i) {
+		const glm::vec4& geometry = blas.geometry[(collectionIndex << mCapacity.expOfTwo_maxGeometryOnCollection) + i];
+
+		if (geometry.w == 0) continue;
+
+		AABB geometryAABB;
+		geometryAABB.vMin = glm::vec3(geometry.x, geometry.y, geometry.z) - glm::vec3(geometry.w);
+		geometryAABB.vMax = glm::vec3(geometry.x, geometry.y, geometry.z) + glm::vec3(geometry.w);
+		bounding = joinAABBs(bounding, geometryAABB);
+	}
+
+	return bounding;
+}
+
+CPUPipeline::RayGeometryIntersection CPUPipeline::intersectCollection_ByIndexes(const Ray& ray, const BLAS& blas, glm::uint32 collectionIndex, glm::float32 minDistance, glm::float32 maxDistance) const noexcept {
+	RayGeometryIntersection bestHitSoFar = missedIntersection();
+
+	const size_t firstGeometry = size_t(collectionIndex) << mCapacity.expOfTwo_maxGeometryOnCollection;
+
+	for (size_t i = 0; i < (size_t(1) << mCapacity.expOfTwo_maxGeometryOnCollection); ++i) {
+		const RayGeometryIntersection currentIntersectionInfo = intersectGeometry(ray, blas.geometry[firstGeometry + i], minDistance, std::min(maxDistance, bestHitSoFar.dist));
+
+		if (currentIntersectionInfo.dist < bestHitSoFar.dist) bestHitSoFar = currentIntersectionInfo;
+	}
+
+	return bestHitSoFar;
+}
+
+CPUPipeline::RayGeometryIntersection CPUPipeline::intersectBLAS_ByIndex(const Ray& ray, glm::uint32 location, glm::float32 minDistance, glm::float32 maxDistance, glm::uint32& nodeVisits) const noexcept {
+	const Instance& instance = mInstances[location];
+	const BLAS& blas = *instance.blas;
+
+	// Move the ray in model space once, instead of moving every AABB in world space:
+	// the direction is not normalized so that distances along the ray are the same in both spaces
+	Ray modelSpaceRay;
+	modelSpaceRay.origin = glm::vec3(instance.inverseModelMatrix * glm::vec4(ray.origin, 1));
+	modelSpaceRay.direction = glm::vec3(instance.inverseModelMatrix * glm::vec4(ray.direction, 0));
+	const glm::vec3 invDirection = glm::float32(1) / modelSpaceRay.direction;
+
+	RayGeometryIntersection bestHitSoFar = missedIntersection();
+
+	const glm::uint32 firstLeaf = firstLeafNode(mCapacity.expOfTwo_maxCollectionsForModel);
+
+	// Nodes to be visited later and the distance at which the ray enters each one of them
+	std::array<std::pair<glm::uint32, glm::float32>, traversalStackSize> postponedNodes;
+	size_t postponedNodesCount = 0;
+
+	glm::float32 entryDistance, leftEntryDistance, rightEntryDistance;
+
+	++nodeVisits;
+	if (!intersectAABB(modelSpaceRay, invDirection, blas.nodes[0], minDistance, maxDistance, entryDistance)) return bestHitSoFar;
+
+	glm::uint32 currentNodeIndex = 0;
+
+	while (true) {
+		const glm::float32 closestDistance = std::min(maxDistance, bestHitSoFar.dist);
+
+		if (currentNodeIndex >= firstLeaf) {
+			const RayGeometryIntersection currentHit = intersectCollection_ByIndexes(modelSpaceRay, blas, currentNodeIndex - firstLeaf, minDistance, closestDistance);
+
+			if (currentHit.dist < bestHitSoFar.dist) bestHitSoFar = currentHit;
+		} else {
+			const glm::uint32 leftNodeIndex = leftNode(currentNodeIndex), rightNodeIndex = rightNode(currentNodeIndex);
+
+			nodeVisits += 2;
+			const bool leftHit = intersectAABB(modelSpaceRay, invDirection, blas.nodes[leftNodeIndex], minDistance, closestDistance, leftEntryDistance);
+			const bool rightHit = intersectAABB(modelSpaceRay, invDirection, blas.nodes[rightNodeIndex], minDistance, closestDistance, rightEntryDistance);
+
+			if ((leftHit) && (rightHit)) {
+				// Visit the nearest child first: the farthest one may be culled by a closer hit
+				const bool leftIsNearest = leftEntryDistance <= rightEntryDistance;
+
+				postponedNodes[postponedNodesCount++] = leftIsNearest ? std::make_pair(rightNodeIndex, rightEntryDistance) : std::make_pair(leftNodeIndex, leftEntryDistance);
+				currentNodeIndex = leftIsNearest ? leftNodeIndex : rightNodeIndex;
+				continue;
+			} else if (leftHit) {
+				currentNodeIndex = leftNodeIndex;
+				continue;
+			} else if (rightHit) {
+				currentNodeIndex = rightNodeIndex;
+				continue;
+			}
+		}
+
+		// Resume from the last postponed node that the ray enters before the closest hit found so far
+		while ((postponedNodesCount > 0) && (postponedNodes[postponedNodesCount - 1].second > std::min(maxDistance, bestHitSoFar.dist)))
+			--postponedNodesCount;
+
+		if (postponedNodesCount == 0) break;
+
+		currentNodeIndex = postponedNodes[--postponedNodesCount].first;
+	}
+
+	// Move the hit back in world space
+	if (!std::isinf(bestHitSoFar.dist)) {
+		bestHitSoFar.point = glm::vec3(instance.modelMatrix * glm::vec4(bestHitSoFar.point, 1));
+		bestHitSoFar.normal = glm::normalize(instance.normalMatrix * bestHitSoFar.normal);
+		bestHitSoFar.location = location;
+	}
+
+	return bestHitSoFar;
+}
+
+CPUPipeline::RayGeometryIntersection CPUPipeline::castRay(const Ray& ray, glm::float32 minDistance, glm::float32 maxDistance, glm::uint32& nodeVisits) const noexcept {
+	const glm::vec3 invDirection = glm::float32(1) / ray.direction;
+
+	RayGeometryIntersection bestHitSoFar = missedIntersection();
+
+	const glm::uint32 firstLeaf = firstLeafNode(mCapacity.expOfTwo_maxModels);
+
+	// Nodes to be visited later and the distance at which the ray enters each one of them
+	std::array<std::pair<glm::uint32, glm::float32>, traversalStackSize> postponedNodes;
+	size_t postponedNodesCount = 0;
+
+	glm::float32 entryDistance, leftEntryDistance, rightEntryDistance;
+
+	++nodeVisits;
+	if (!intersectAABB(ray, invDirection, mTLAS[0], minDistance, maxDistance, entryDistance)) return bestHitSoFar;
+
+	glm::uint32 currentNodeIndex = 0;
+
+	while (true) {
+		const glm::float32 closestDistance = std::min(maxDistance, bestHitSoFar.dist);
+
+		if (currentNodeIndex >= firstLeaf) {
+			const RayGeometryIntersection currentHit = intersectBLAS_ByIndex(ray, currentNodeIndex - firstLeaf, minDistance, closestDistance, nodeVisits);
+
+			if (currentHit.dist < bestHitSoFar.dist) bestHitSoFar = currentHit;
+		} else {
+			const glm::uint32 leftNodeIndex = leftNode(currentNodeIndex), rightNodeIndex = rightNode(currentNodeIndex);
+
+			nodeVisits += 2;
+			const bool leftHit = intersectAABB(ray, invDirection, mTLAS[leftNodeIndex], minDistance, closestDistance, leftEntryDistance);
+			const bool rightHit = intersectAABB(ray, invDirection, mTLAS[rightNodeIndex], minDistance, closestDistance, rightEntryDistance);
+
+			if ((leftHit) && (rightHit)) {
+				// Visit the nearest child first: the farthest one may be culled by a closer hit
+				const bool leftIsNearest = leftEntryDistance <= rightEntryDistance;
+
+				postponedNodes[postponedNodesCount++] = leftIsNearest ? std::make_pair(rightNodeIndex, rightEntryDistance) : std::make_pair(leftNodeIndex, leftEntryDistance);
+				currentNodeIndex = leftIsNearest ? leftNodeIndex : rightNodeIndex;
+				continue;
+			} else if (leftHit) {
+				currentNodeIndex = leftNodeIndex;
+				continue;
+			} else if (rightHit) {
+				currentNodeIndex = rightNodeIndex;
+				continue;
+			}
+		}
+
+		// Resume from the last postponed node that the ray enters before the closest hit found so far
+		while ((postponedNodesCount > 0) && (postponedNodes[postponedNodesCount - 1].second > std::min(maxDistance, bestHitSoFar.dist)))
+			--postponedNodesCount;
+
+		if (postponedNodesCount == 0) break;
+
+		currentNodeIndex = postponedNodes[--postponedNodesCount].first;
+	}
+
+	return bestHitSoFar;
+}
+
+glm::float32 CPUPipeline::anyHitBLAS_ByIndex(const Ray& ray, glm::uint32 location, glm::float32 minDistance, glm::float32 maxDistance, glm::uint32& nodeVisits) const noexcept {
+	const Instance& instance = mInstances[location];
+	const BLAS& blas = *instance.blas;
+
+	Ray modelSpaceRay;
+	modelSpaceRay.origin = glm::vec3(instance.inverseModelMatrix * glm::vec4(ray.origin, 1));
+	modelSpaceRay.direction = glm::vec3(instance.inverseModelMatrix * glm::vec4(ray.direction, 0));
+	const glm::vec3 invDirection = glm::float32(1) / modelSpaceRay.direction;
+
+	const glm::uint32 firstLeaf = firstLeafNode(mCapacity.expOfTwo_maxCollectionsForModel);
+
+	// Nodes to be visited later: their order does not matter when any hit will do
+	std::array<glm::uint32, traversalStackSize> postponedNodes;
+	size_t postponedNodesCount = 0;
+
+	glm::float32 entryDistance;
+
+	++nodeVisits;
+	if (!intersectAABB(modelSpaceRay, invDirection, blas.nodes[0], minDistance, maxDistance, entryDistance)) return std::numeric_limits<glm::float32>::infinity();
+
+	glm::uint32 currentNodeIndex = 0;
+
+	while (true) {
+		if (currentNodeIndex >= firstLeaf) {
+			const size_t firstGeometry = size_t(currentNodeIndex - firstLeaf) << mCapacity.expOfTwo_maxGeometryOnCollection;
+
+			for (size_t i = 0; i < (size_t(1) << mCapacity.expOfTwo_maxGeometryOnCollection); ++i) {
+				const RayGeometryIntersection isect = intersectGeometry(modelSpaceRay, blas.geometry[firstGeometry + i], minDistance, maxDistance);
+
+				if (!std::isinf(isect.dist)) return isect.dist;
+			}
+		} else {
+			const glm::uint32 leftNodeIndex = leftNode(currentNodeIndex), rightNodeIndex = rightNode(currentNodeIndex);
+
+			nodeVisits += 2;
+			const bool leftHit = intersectAABB(modelSpaceRay, invDirection, blas.nodes[leftNodeIndex], minDistance, maxDistance, entryDistance);
+			const bool rightHit = intersectAABB(modelSpaceRay, invDirection, blas.nodes[rightNodeIndex], minDistance, maxDistance, entryDistance);
+
+			if ((leftHit) && (rightHit)) {
+				postponedNodes[postponedNodesCount++] = rightNodeIndex;
+				currentNodeIndex = leftNodeIndex;
+				continue;
+			} else if (leftHit) {
+				currentNodeIndex = leftNodeIndex;
+				continue;
+			} else if (rightHit) {
+				currentNodeIndex = rightNodeIndex;
+				continue;
+			}
+		}
+
+		if (postponedNodesCount == 0) break;
+
+		currentNodeIndex = postponedNodes[--postponedNodesCount];
+	}
+
+	return std::numeric_limits<glm::float32>::infinity();
+}
+
+bool CPUPipeline::castOcclusionRay(const Ray& ray, glm::float32 minDistance, glm::float32 maxDistance, GLuint& occluder, glm::float32& occluderDistance, glm::uint32& nodeVisits) const noexcept {
+	const glm::vec3 invDirection = glm::float32(1) / ray.direction;
+
+	occluder = noModelHit;
+	occluderDistance = std::numeric_limits<glm::float32>::infinity();
+
+	const glm::uint32 firstLeaf = firstLeafNode(mCapacity.expOfTwo_maxModels);
+
+	std::array<glm::uint32, traversalStackSize> postponedNodes;
+	size_t postponedNodesCount = 0;
+
+	glm::float32 entryDistance;
+
+	++nodeVisits;
+	if (!intersectAABB(ray, invDirection, mTLAS[0], minDistance, maxDistance, entryDistance)) return false;
+
+	glm::uint32 currentNodeIndex = 0;
+
+	while (true) {
+		if (currentNodeIndex >= firstLeaf) {
+			const glm::uint32 location = currentNodeIndex - firstLeaf;
+
+			occluderDistance = anyHitBLAS_ByIndex(ray, location, minDistance, maxDistance, nodeVisits);
+
+			if (!std::isinf(occluderDistance)) {
+				occluder = location;
+				return true;
+			}
+		} else {
+			const glm::uint32 leftNodeIndex = leftNode(currentNodeIndex), rightNodeIndex = rightNode(currentNodeIndex);
+
+			nodeVisits += 2;
+			const bool leftHit = intersectAABB(ray, invDirection, mTLAS[leftNodeIndex], minDistance, maxDistance, entryDistance);
+			const bool rightHit = intersectAABB(ray, invDirection, mTLAS[rightNodeIndex], minDistance, maxDistance, entryDistance);
+
+			if ((leftHit) && (rightHit)) {
+				postponedNodes[postponedNodesCount++] = rightNodeIndex;
+				currentNodeIndex = leftNodeIndex;
+				continue;
+			} else if (leftHit) {
+				currentNodeIndex = leftNodeIndex;
+				continue;
+			} else if (rightHit) {
+				currentNodeIndex = rightNodeIndex;
+				continue;
+			}
+		}
+
+		if (postponedNodesCount == 0) break;
+
+		currentNodeIndex = postponedNodes[--postponedNodesCount];
+	}
+
+	return false;
+}
+
+void CPUPipeline::onReset() noexcept {
+	for (auto& instance : mInstances)
+		instance.blas.reset();
+
+	// The scene is empty: there is nothing left to move or refit
+	std::fill(mTLAS.begin(), mTLAS.end(), emptyAABB());
+
+	mPendingTransforms.clear();
+
+	for (const auto location : mDirtyModels)
+		mModelDirtyFlags[location] = false;
+	mDirtyModels.clear();
+
+	invalidateAccumulation();
+}
+
+void CPUPipeline::setModelTransform(GLuint location, const glm::mat4& transform) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mCapacity.expOfTwo_maxModels)) );
+
+	mPendingTransforms.push_back(ModelTransform{ location, transform });
+
+	markModelDirty(location);
+}
+
+void CPUPipeline::markModelDirty(GLuint location) noexcept {
+	// The scene is about to change
+	invalidateAccumulation();
+
+	if (mModelDirtyFlags[location]) return;
+
+	mModelDirtyFlags[location] = true;
+	mDirtyModels.push_back(location);
+}
+
+void CPUPipeline::enqueueModel(std::vector<GeometryPrimitive>&& primitivesCollection, GLuint targetBLAS) noexcept {
+	DBG_ASSERT( (targetBLAS < (GLuint(1) << mCapacity.expOfTwo_maxModels)) );
+
+	const size_t collectionsCount = size_t(1) << mCapacity.expOfTwo_maxCollectionsForModel;
+	const size_t geometryOnCollectionCount = size_t(1) << mCapacity.expOfTwo_maxGeometryOnCollection;
+
+	DBG_ASSERT( (primitivesCollection.size() <= (collectionsCount * geometryOnCollectionCount)) );
+
+	const glm::uint64 insertBegin = FrameProfiler::now();
+
+	// Instances of the model previously on the location keep its BLAS
+	std::shared_ptr<BLAS> blas(new BLAS());
+
+	// Geometry is placed in input order, as the BVH_INSERT program does: unused entries have radius 0
+	blas->geometry.assign(collectionsCount * geometryOnCollectionCount, glm::vec4(0));
+	for (size_t i = 0; i < std::min(primitivesCollection.size(), blas->geometry.size()); ++i)
+		blas->geometry[i] = glm::vec4(primitivesCollection[i].getCenter(), primitivesCollection[i].getRadius());
+	blas->primitivesCount = std::min(primitivesCollection.size(), blas->geometry.size());
+
+	blas->nodes.assign((collectionsCount * 2) - 1, emptyAABB());
+
+	const glm::uint32 firstLeaf = firstLeafNode(mCapacity.expOfTwo_maxCollectionsForModel);
+	for (size_t collection = 0; collection < collectionsCount; ++collection)
+		blas->nodes[firstLeaf + collection] = collectionAABB_ByIndexes(*blas, collection);
+
+	// Build the tree back to the root
+	for (glm::uint32 node = firstLeaf; node > 0; --node)
+		blas->nodes[node - 1] = joinAABBs(blas->nodes[leftNode(node - 1)], blas->nodes[rightNode(node - 1)]);
+
+	Instance& instance = mInstances[targetBLAS];
+	instance.modelMatrix = glm::mat4(1);
+	instance.inverseModelMatrix = glm::mat4(1);
+	instance.normalMatrix = glm::mat3(1);
+	instance.blas = std::move(blas);
+
+	markModelDirty(targetBLAS);
+
+	getProfiler().record("Insert", insertBegin, FrameProfiler::now());
+}
+
+void CPUPipeline::enqueueInstance(GLuint sourceLocation, GLuint location) noexcept {
+	DBG_ASSERT( (sourceLocation < (GLuint(1) << mCapacity.expOfTwo_maxModels)) );
+	DBG_ASSERT( (location < (GLuint(1) << mCapacity.expOfTwo_maxModels)) );
+	DBG_ASSERT( (mInstances[sourceLocation].blas) );
+	if (!mInstances[sourceLocation].blas) return;
+
+	Instance& instance = mInstances[location];
+	instance.modelMatrix = glm::mat4(1);
+	instance.inverseModelMatrix = glm::mat4(1);
+	instance.normalMatrix = glm::mat3(1);
+	instance.blas = mInstances[sourceLocation].blas;
+
+	markModelDirty(location);
+}
+
+void CPUPipeline::onRemoveModel(GLuint location) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mCapacity.expOfTwo_maxModels)) );
+
+	mInstances[location].blas.reset();
+
+	// A pending transformation must not move the next model placed on the same location
+	mPendingTransforms.erase(
+		std::remove_if(mPendingTransforms.begin(), mPendingTransforms.end(), [location](const ModelTransform& modelTransform) { return modelTransform.location == location; }),
+		mPendingTransforms.end());
+
+	markModelDirty(location);
+}
+
+void CPUPipeline::onUpdateModelPrimitives(GLuint location, size_t firstPrimitive, const std::vector<GeometryPrimitive>& primitives) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mCapacity.expOfTwo_maxModels)) );
+
+	BLAS* const blas = mInstances[location].blas.get();
+	DBG_ASSERT( ((blas != nullptr) && ((firstPrimitive + primitives.size()) <= blas->primitivesCount)) );
+	if ((!blas) || ((firstPrimitive + primitives.size()) > blas->primitivesCount)) return;
+
+	const glm::uint64 updateBegin = FrameProfiler::now();
+
+	for (size_t i = 0; i < primitives.size(); ++i)
+		blas->geometry[firstPrimitive + i] = glm::vec4(primitives[i].getCenter(), primitives[i].getRadius());
+
+	// Refit collections holding the new geometry, then their ancestors one level at a time
+	const glm::uint32 firstLeaf = firstLeafNode(mCapacity.expOfTwo_maxCollectionsForModel);
+	const size_t firstCollection = firstPrimitive >> mCapacity.expOfTwo_maxGeometryOnCollection;
+	const size_t lastCollection = (firstPrimitive + primitives.size() - 1) >> mCapacity.expOfTwo_maxGeometryOnCollection;
+
+	std::vector<glm::uint32> levelNodes;
+	levelNodes.reserve(lastCollection - firstCollection + 1);
+	for (size_t collection = firstCollection; collection <= lastCollection; ++collection) {
+		blas->nodes[firstLeaf + collection] = collectionAABB_ByIndexes(*blas, collection);
+		levelNodes.push_back(firstLeaf + glm::uint32(collection));
+	}
+
+	while (levelNodes.front() != 0) {
+		// Parents of sorted nodes are sorted too, so duplicates are adjacent
+		for (auto& node : levelNodes)
+			node = (node - 1) / 2;
+		levelNodes.erase(std::unique(levelNodes.begin(), levelNodes.end()), levelNodes.end());
+
+		for (const auto node : levelNodes)
+			blas->nodes[node] = joinAABBs(blas->nodes[leftNode(node)], blas->nodes[rightNode(node)]);
+	}
+
+	// TLAS leaves of every instance must follow the new BLAS root
+	if (mInstances[location].blas.use_count() > 1) {
+		for (GLuint instance = 0; instance < GLuint(mInstances.size()); ++instance)
+			if (mInstances[instance].blas.get() == blas) markModelDirty(instance);
+	} else {
+		markModelDirty(location);
+	}
+
+	getProfiler().record("Update Geometry", updateBegin, FrameProfiler::now());
+}
+
+void CPUPipeline::update() noexcept {
+	if (mDirtyModels.empty()) return;
+
+	// Move models, but never resurrect an empty one
+	for (const auto& modelTransform : mPendingTransforms) {
+		Instance& instance = mInstances[modelTransform.location];
+		if (!instance.blas) continue;
+
+		instance.modelMatrix = modelTransform.transform;
+		instance.inverseModelMatrix = glm::inverse(modelTransform.transform);
+		instance.normalMatrix = glm::transpose(glm::mat3(instance.inverseModelMatrix));
+	}
+	mPendingTransforms.clear();
+
+	// Refit dirty leaves, then their ancestors one level at a time
+	const glm::uint32 firstLeaf = firstLeafNode(mCapacity.expOfTwo_maxModels);
+
+	std::vector<glm::uint32> levelNodes;
+	levelNodes.reserve(mDirtyModels.size());
+	for (const auto location : mDirtyModels) {
+		const Instance& instance = mInstances[location];
+		mTLAS[firstLeaf + location] = (instance.blas) ? transformAABB(instance.blas->nodes[0], instance.modelMatrix) : emptyAABB();
+		levelNodes.push_back(firstLeaf + location);
+
+		mModelDirtyFlags[location] = false;
+	}
+	mDirtyModels.clear();
+
+	std::sort(levelNodes.begin(), levelNodes.end());
+
+	while (levelNodes.front() != 0) {
+		// Parents of sorted nodes are sorted too, so duplicates are adjacent
+		for (auto& node : levelNodes)
+			node = (node - 1) / 2;
+		levelNodes.erase(std::unique(levelNodes.begin(), levelNodes.end()), levelNodes.end());
+
+		for (const auto node : levelNodes)
+			mTLAS[node] = joinAABBs(mTLAS[leftNode(node)], mTLAS[rightNode(node)]);
+	}
+}
+
+RayQueryBatch CPUPipeline::castRays(const std::vector<RayQuery>& rays, RayQueryType type) noexcept {
+	// Rays see the scene as it would be rendered now
+	update();
+
+	std::vector<RayQueryResult> results(rays.size());
+
+	mThreadPool.parallelFor((rays.size() + rayQueriesOnTask - 1) / rayQueriesOnTask, [this, &rays, &results, type](size_t taskIndex) {
+		for (size_t i = taskIndex * rayQueriesOnTask; i < std::min((taskIndex + 1) * rayQueriesOnTask, rays.size()); ++i) {
+			Ray ray;
+			ray.origin = rays[i].origin;
+			ray.direction = rays[i].direction;
+
+			glm::uint32 nodeVisits = 0;
+			results[i].padding[0] = results[i].padding[1] = results[i].padding[2] = 0;
+
+			if (type == RayQueryType::Occlusion) {
+				results[i].normal = glm::vec3(0);
+				castOcclusionRay(ray, rays[i].minDistance, rays[i].maxDistance, results[i].location, results[i].distance, nodeVisits);
+				continue;
+			}
+
+			const RayGeometryIntersection isect = castRay(ray, rays[i].minDistance, rays[i].maxDistance, nodeVisits);
+
+			results[i].normal = (std::isinf(isect.dist)) ? glm::vec3(0) : isect.normal;
+			results[i].distance = isect.dist;
+			results[i].location = isect.location;
+		}
+	});
+
+	const RayQueryBatch batch = mNextRayQueryBatch++;
+	mRayQueryResults[batch] = std::move(results);
+
+	return batch;
+}
+
+bool CPUPipeline::pollRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept {
+	const auto batchIt = mRayQueryResults.find(batch);
+	DBG_ASSERT( (batchIt != mRayQueryResults.end()) );
+	if (batchIt == mRayQueryResults.end()) return false;
+
+	results = std::move(batchIt->second);
+	mRayQueryResults.erase(batchIt);
+
+	return true;
+}
+
+void CPUPipeline::waitRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept {
+	pollRayQueryResults(batch, results);
+}
+
+void CPUPipeline::onResize(glm::uint32 oldWidth, glm::uint32 oldHeight, glm::uint32 newWidth, glm::uint32 newHeight) noexcept {
+	mOutput.assign(size_t(newWidth) * size_t(newHeight), glm::vec4(0, 0, 0, 0));
+}
+
+void CPUPipeline::renderTile(glm::uint32 tileIndex) noexcept {
+	const glm::uint32 width = getWidth(), height = getHeight();
+	const glm::uint32 tilesOnX = (width + tileWidth - 1) / tileWidth;
+
+	const glm::uint32 firstX = (tileIndex % tilesOnX) * tileWidth;
+	const glm::uint32 firstY = (tileIndex / tilesOnX) * tileHeight;
+
+	const Camera& camera = getCamera();
+	const glm::vec3 cameraViewDir = glm::normalize(camera.viewDirection);
+	const glm::float32 cameraAspect = glm::float32(width) / glm::float32(height);
+
+	// Each frame samples a different point of every pixel, averaged with the previous ones
+	const glm::vec2 sampleJitter = getSampleJitter();
+	const glm::float32 sampleWeight = glm::float32(1) / glm::float32(getAccumulatedSamples() + 1);
+
+	glm::uint32 tileRaysCount = 0, tileTotalNodeVisits = 0, tileMaxNodeVisits = 0;
+
+	for (glm::uint32 y = firstY; y < std::min(firstY + tileHeight, height); ++y) {
+		for (glm::uint32 x = firstX; x < std::min(firstX + tileWidth, width); ++x) {
+			// Get UV cordinates of the output texture
+			const glm::float32 u = (glm::float32(x) + sampleJitter.x) / glm::float32(width);
+			const glm::float32 v = (glm::float32(y) + sampleJitter.y) / glm::float32(height);
+
+			const Ray cameraRay = generateCameraRay(camera.position, cameraViewDir, camera.up, camera.fieldOfView, cameraAspect, u, v);
+
+			glm::uint32 nodeVisits = 0;
+
+			const RayGeometryIntersection isect = castRay(cameraRay, glm::float32(0.001), glm::float32(1000.0), nodeVisits);
+			++tileRaysCount;
+
+			glm::float32 intensity = 0;
+			if (getShadingMode() == ShadingMode::DirectLighting) {
+				const glm::float32 lambert = std::max(glm::float32(0), glm::dot(isect.normal, getLightDirection()));
+
+				// Only lit points need a shadow ray, and any occluder will do
+				bool shadowed = true;
+				if ((!std::isinf(isect.dist)) && (lambert > 0)) {
+					Ray shadowRay;
+					shadowRay.origin = isect.point;
+					shadowRay.direction = getLightDirection();
+
+					GLuint occluder;
+					glm::float32 occluderDistance;
+					shadowed = castOcclusionRay(shadowRay, glm::float32(0.001), glm::float32(1000.0), occluder, occluderDistance, nodeVisits);
+					++tileRaysCount;
+				}
+
+				intensity = (std::isinf(isect.dist)) ? 0 : (ambientLight + ((shadowed) ? 0 : (1 - ambientLight) * lambert));
+			} else {
+				intensity = (std::isinf(isect.dist)) ? 0 : std::max(glm::float32(0), glm::dot(isect.normal, glm::normalize(camera.position - isect.point)));
+			}
+
+			tileTotalNodeVisits += nodeVisits;
+			tileMaxNodeVisits = std::max(tileMaxNodeVisits, nodeVisits);
+
+			glm::vec4& pixel = mOutput[size_t(y) * size_t(width) + size_t(x)];
+			pixel = glm::mix(pixel, glm::vec4(intensity, intensity, intensity, 1), sampleWeight);
+		}
+	}
+
+	if (mTraversalStatisticsCollection) {
+		mRaysCount += tileRaysCount;
+		mTotalNodeVisits += tileTotalNodeVisits;
+
+		glm::uint32 currentMaxNodeVisits = mMaxNodeVisits.load();
+		while ((currentMaxNodeVisits < tileMaxNodeVisits) && (!mMaxNodeVisits.compare_exchange_weak(currentMaxNodeVisits, tileMaxNodeVisits)));
+	}
+}
+
+void CPUPipeline::onRender() noexcept {
+	// Update the TLAS before rendering
+	const glm::uint64 updateBegin = FrameProfiler::now();
+	update();
+	const glm::uint64 updateEnd = FrameProfiler::now();
+	getProfiler().record("Update", updateBegin, updateEnd);
+
+	// A still image with every sample requested is kept as is
+	if (isAccumulationComplete()) return;
+
+	// Measure the traversal cost of this frame only
+	if (mTraversalStatisticsCollection) {
+		mRaysCount = 0;
+		mTotalNodeVisits = 0;
+		mMaxNodeVisits = 0;
+	}
+
+	const glm::uint32 tilesOnX = (getWidth() + tileWidth - 1) / tileWidth;
+	const glm::uint32 tilesOnY = (getHeight() + tileHeight - 1) / tileHeight;
+
+	mThreadPool.parallelFor(size_t(tilesOnX) * size_t(tilesOnY), [this](size_t tileIndex) {
+		renderTile(static_cast<glm::uint32>(tileIndex));
+	});
+
+	getProfiler().record("Render", updateEnd, FrameProfiler::now());
+
+	accountAccumulatedSample();
+}
@@ -0,0 +1,287 @@
+#pragma once
+
+#include "Rendering/RenderingPipeline.h"
+
+#include "Threading/ThreadPool.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace CPU {
+
+			/**
+			 * This is a headless raytracer that runs entirely on the CPU.
+			 *
+			 * The scene is organized exactly as in the OpenGL raytracer (raytrace.comp):
+			 * a TLAS with a leaf for each model, a BLAS for each model (shared by instances of the model) whose leaves are
+			 * geometry collections, and geometry collections of spheres;
+			 * so that rendered results can be compared with the GPU ones.
+			 *
+			 * The frame is split in tiles that are scheduled on a work-stealing thread pool.
+			 */
+			class CPUPipeline :
+				virtual public Rendering::RenderingPipeline {
+
+			public:
+				static constexpr glm::uint32 tileWidth = 16;
+				static constexpr glm::uint32 tileHeight = 16;
+
+				CPUPipeline(const CPUPipeline&) = delete;
+
+				CPUPipeline(CPUPipeline&&) = delete;
+
+				CPUPipeline& operator=(const CPUPipeline&) = delete;
+
+				~CPUPipeline() override;
+
+				/**
+				 * Create the CPU raytracer.
+				 *
+				 * @param capacity the maximum size of the scene
+				 * @param workersCount the number of rendering threads, 0 means one for each hardware thread
+				 */
+				CPUPipeline(const SceneCapacity& capacity = SceneCapacity(), size_t workersCount = 0) noexcept;
+
+				void enqueueModel(std::vector<GeometryPrimitive>&& primitive, GLuint location) noexcept override;
+
+				void enqueueInstance(GLuint sourceLocation, GLuint location) noexcept override;
+
+				void setModelTransform(GLuint location, const glm::mat4& transform) noexcept override;
+
+				void setTraversalStatisticsCollection(bool enabled) noexcept override;
+
+				TraversalStatistics getTraversalStatistics() const noexcept override;
+
+				/**
+				 * Cast rays on the thread pool: results are ready as soon as this function returns.
+				 *
+				 * @param rays the rays to be cast
+				 * @param type what is to be found for each ray
+				 * @return the batch to retrieve results of
+				 */
+				RayQueryBatch castRays(const std::vector<RayQuery>& rays, RayQueryType type = RayQueryType::ClosestHit) noexcept override;
+
+				bool pollRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept override;
+
+				void waitRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept override;
+
+				/**
+				 * Get the result of the last rendered frame: the average of every sample accumulated so far.
+				 *
+				 * This is the equivalent of the RGBA32F OpenGL raytracer output texture (OutputFormat::HDR32F):
+				 * pixels are stored row by row starting from the bottom one and are not tone mapped.
+				 *
+				 * @return the raw raytracing result
+				 */
+				const std::vector<glm::vec4>& getOutput() const noexcept;
+
+				/**
+				 * Get the last rendered frame as the OpenGL raytracer displays it:
+				 * pixels are tone mapped and stored as 8-bit RGB triples, row by row starting from the bottom one,
+				 * as glReadPixels reads them back.
+				 *
+				 * @param pixels the tone mapped pixels
+				 */
+				void getDisplayPixels(std::vector<glm::uint8>& pixels) const noexcept;
+
+				/**
+				 * Get the number of rendering threads.
+				 *
+				 * @return the number of threads tiles are rendered on
+				 */
+				size_t getWorkersCount() const noexcept;
+
+			protected:
+				void onResize(glm::uint32 oldWidth, glm::uint32 oldHeight, glm::uint32 newWidth, glm::uint32 newHeight) noexcept override;
+
+				void onRender() noexcept final;
+
+				void onRemoveModel(GLuint location) noexcept override;
+
+				void onUpdateModelPrimitives(GLuint location, size_t firstPrimitive, const std::vector<GeometryPrimitive>& primitives) noexcept override;
+
+				void onReset() noexcept override;
+
+			private:
+				struct Ray {
+					glm::vec3 origin;
+
+					glm::vec3 direction;
+				};
+
+				struct RayGeometryIntersection {
+					glm::float32 dist;
+
+					glm::vec3 point;
+
+					glm::vec3 normal;
+
+					/**
+					 * The model that has been hit, noModelHit on a miss.
+					 */
+					GLuint location;
+				};
+
+				/**
+				 * An Axis-Aligned Bounding Box stored as its min and max vertices, empty when vMin > vMax.
+				 */
+				struct AABB {
+					glm::vec3 vMin;
+
+					glm::vec3 vMax;
+				};
+
+				struct BLAS {
+					/**
+					 * This is the linearized complete binary tree: leaves are geometry collections.
+					 */
+					std::vector<AABB> nodes;
+
+					/**
+					 * Geometry as (center, radius): geometry i of collection c is stored at (c << expOfTwo_maxGeometryOnCollection) + i.
+					 */
+					std::vector<glm::vec4> geometry;
+
+					/**
+					 * The number of geometry primitives of the model, the rest of geometry is unused.
+					 */
+					size_t primitivesCount;
+				};
+
+				/**
+				 * This is what a TLAS leaf refers to: the placement of a model and the BLAS storing it, shared between instances.
+				 */
+				struct Instance {
+					glm::mat4 modelMatrix;
+
+					/**
+					 * Rays are transformed once in the model space of the BLAS using this matrix.
+					 */
+					glm::mat4 inverseModelMatrix;
+
+					/**
+					 * Transforms normals from the model space to the world space.
+					 */
+					glm::mat3 normalMatrix;
+
+					/**
+					 * The geometry of the model, nullptr when the location is empty.
+					 */
+					std::shared_ptr<BLAS> blas;
+				};
+
+				static AABB emptyAABB() noexcept;
+
+				static bool isEmpty(const AABB& aabb) noexcept;
+
+				static AABB joinAABBs(const AABB& aabb1, const AABB& aabb2) noexcept;
+
+				static AABB transformAABB(const AABB& aabb, const glm::mat4& transformMatrix) noexcept;
+
+				static bool intersectAABB(const Ray& ray, const glm::vec3& invDirection, const AABB& aabb, glm::float32 minDistance, glm::float32 maxDistance, glm::float32& entryDistance) noexcept;
+
+				/**
+				 * Get the result of a ray that has not hit anything: shading can read every field of it.
+				 */
+				static RayGeometryIntersection missedIntersection() noexcept;
+
+				static RayGeometryIntersection intersectGeometry(const Ray& ray, const glm::vec4& geometry, glm::float32 minDistance, glm::float32 maxDistance) noexcept;
+
+				static Ray generateCameraRay(const glm::vec3& lookFrom, const glm::vec3& viewDirection, const glm::vec3& up, glm::float32 fieldOfView, glm::float32 aspect, glm::float32 s, glm::float32 t) noexcept;
+
+				/**
+				 * Compute the AABB of a geometry collection: the BLAS leaf holding it.
+				 */
+				AABB collectionAABB_ByIndexes(const BLAS& blas, size_t collectionIndex) const noexcept;
+
+				RayGeometryIntersection intersectCollection_ByIndexes(const Ray& ray, const BLAS& blas, glm::uint32 collectionIndex, glm::float32 minDistance, glm::float32 maxDistance) const noexcept;
+
+				/**
+				 * Find the closest hit between the ray and the geometry of the model on the given location.
+				 *
+				 * @param nodeVisits incremented by the number of BVH nodes tested against the ray
+				 */
+				RayGeometryIntersection intersectBLAS_ByIndex(const Ray& ray, glm::uint32 location, glm::float32 minDistance, glm::float32 maxDistance, glm::uint32& nodeVisits) const noexcept;
+
+				/**
+				 * Find the closest hit between the ray and the scene.
+				 *
+				 * @param nodeVisits incremented by the number of BVH nodes tested against the ray
+				 */
+				RayGeometryIntersection castRay(const Ray& ray, glm::float32 minDistance, glm::float32 maxDistance, glm::uint32& nodeVisits) const noexcept;
+
+				/**
+				 * Find any hit between the ray and the geometry of the model on the given location, stopping at the first one.
+				 *
+				 * @param nodeVisits incremented by the number of BVH nodes tested against the ray
+				 * @return the distance of the hit, infinity if the ray has missed every geometry
+				 */
+				glm::float32 anyHitBLAS_ByIndex(const Ray& ray, glm::uint32 location, glm::float32 minDistance, glm::float32 maxDistance, glm::uint32& nodeVisits) const noexcept;
+
+				/**
+				 * Check if anything lies along the ray within the given range, stopping at the first hit.
+				 *
+				 * @param occluder the model that has been hit, noModelHit if the ray is not occluded
+				 * @param occluderDistance the distance of the hit (not necessarily the closest one), infinity if the ray is not occluded
+				 * @param nodeVisits incremented by the number of BVH nodes tested against the ray
+				 * @return TRUE if the ray is occluded
+				 */
+				bool castOcclusionRay(const Ray& ray, glm::float32 minDistance, glm::float32 maxDistance, GLuint& occluder, glm::float32& occluderDistance, glm::uint32& nodeVisits) const noexcept;
+
+				/**
+				 * Apply pending transformations and refit the TLAS where models have changed.
+				 */
+				void update() noexcept;
+
+				void markModelDirty(GLuint location) noexcept;
+
+				void renderTile(glm::uint32 tileIndex) noexcept;
+
+				const SceneCapacity mCapacity;
+
+				Threading::ThreadPool mThreadPool;
+
+				/**
+				 * Models indexed by their location.
+				 */
+				std::vector<Instance> mInstances;
+
+				/**
+				 * This is the linearized complete binary tree: leaf i refers to the model at location i.
+				 */
+				std::vector<AABB> mTLAS;
+
+				/**
+				 * Transformations to be applied on the next update, in the order they have been set.
+				 */
+				std::vector<ModelTransform> mPendingTransforms;
+
+				/**
+				 * Models whose TLAS leaf must be refitted on the next update.
+				 */
+				std::vector<glm::uint32> mDirtyModels;
+
+				/**
+				 * For each model TRUE iif it is listed on mDirtyModels.
+				 */
+				std::vector<bool> mModelDirtyFlags;
+
+				std::vector<glm::vec4> mOutput;
+
+				bool mTraversalStatisticsCollection;
+
+				std::atomic<glm::uint32> mRaysCount;
+
+				std::atomic<glm::uint32> mTotalNodeVisits;
+
+				std::atomic<glm::uint32> mMaxNodeVisits;
+
+				/**
+				 * Results of ray query batches not retrieved yet.
+				 */
+				std::unordered_map<RayQueryBatch, std::vector<RayQueryResult>> mRayQueryResults;
+
+				RayQueryBatch mNextRayQueryBatch;
+			};
+		}
+	}
+}
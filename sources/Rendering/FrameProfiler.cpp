@@ -0,0 +1,103 @@
+#include "Rendering/FrameProfiler.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+
+namespace {
+	/**
+	 * Captures are bounded, so that a forgotten capture does not exhaust memory.
+	 */
+	const size_t maxTraceEvents = size_t(1) << 20;
+}
+
+FrameProfiler::FrameProfiler(size_t windowSize) noexcept
+	: mWindowSize(std::max<size_t>(windowSize, 1)),
+	mTraceCapture(false) {}
+
+glm::uint64 FrameProfiler::now() noexcept {
+	return glm::uint64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void FrameProfiler::record(const char* stage, glm::uint64 beginNanoseconds, glm::uint64 endNanoseconds) noexcept {
+	// Stages are a handful, a linear search is faster than hashing names
+	auto stageIt = std::find_if(mStages.begin(), mStages.end(), [stage](const Stage& s) { return std::strcmp(s.name, stage) == 0; });
+	if (stageIt == mStages.end()) {
+		mStages.push_back(Stage{ stage, std::vector<glm::float64>(), 0 });
+		mStages.back().milliseconds.reserve(mWindowSize);
+		stageIt = mStages.end() - 1;
+	}
+
+	const glm::float64 milliseconds = glm::float64((endNanoseconds > beginNanoseconds) ? (endNanoseconds - beginNanoseconds) : 0) / glm::float64(1000000);
+
+	if (stageIt->milliseconds.size() < mWindowSize) {
+		stageIt->milliseconds.push_back(milliseconds);
+	} else {
+		stageIt->milliseconds[stageIt->nextSample] = milliseconds;
+	}
+	stageIt->nextSample = (stageIt->nextSample + 1) % mWindowSize;
+
+	if ((mTraceCapture) && (mTraceEvents.size() < maxTraceEvents))
+		mTraceEvents.push_back(TraceEvent{ stage, beginNanoseconds, endNanoseconds });
+}
+
+std::vector<StageStatistics> FrameProfiler::getStatistics() const noexcept {
+	std::vector<StageStatistics> statistics;
+	statistics.reserve(mStages.size());
+
+	for (const auto& stage : mStages) {
+		std::vector<glm::float64> samples(stage.milliseconds);
+
+		StageStatistics stageStatistics;
+		stageStatistics.name = stage.name;
+		stageStatistics.samplesCount = glm::uint32(samples.size());
+		stageStatistics.minMilliseconds = *std::min_element(samples.begin(), samples.end());
+
+		glm::float64 totalMilliseconds = 0;
+		for (const auto sample : samples)
+			totalMilliseconds += sample;
+		stageStatistics.averageMilliseconds = totalMilliseconds / glm::float64(samples.size());
+
+		// The nearest-rank percentile: the smallest sample not exceeded by 99% of samples
+		const size_t p99Rank = (samples.size() * 99 + 99) / 100 - 1;
+		std::nth_element(samples.begin(), samples.begin() + p99Rank, samples.end());
+		stageStatistics.p99Milliseconds = samples[p99Rank];
+
+		statistics.push_back(stageStatistics);
+	}
+
+	return statistics;
+}
+
+void FrameProfiler::clear() noexcept {
+	mStages.clear();
+}
+
+void FrameProfiler::setTraceCapture(bool enabled) noexcept {
+	if ((enabled) && (!mTraceCapture)) mTraceEvents.clear();
+
+	mTraceCapture = enabled;
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string& path) const noexcept {
+	std::ofstream trace(path, std::ios::out | std::ios::trunc);
+	if (!trace.is_open()) return false;
+
+	// Timestamps are relative to the first event: absolute GPU timestamps would lose precision as doubles
+	glm::uint64 origin = std::numeric_limits<glm::uint64>::max();
+	for (const auto& event : mTraceEvents)
+		origin = std::min(origin, event.beginNanoseconds);
+
+	trace << "{\"traceEvents\":[";
+	for (size_t i = 0; i < mTraceEvents.size(); ++i) {
+		const TraceEvent& event = mTraceEvents[i];
+		const glm::uint64 duration = (event.endNanoseconds > event.beginNanoseconds) ? (event.endNanoseconds - event.beginNanoseconds) : 0;
+
+		trace << ((i == 0) ? "" : ",") << std::endl
+			<< "{\"name\":\"" << event.stage << "\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+			<< ",\"ts\":" << (event.beginNanoseconds - origin) / 1000 << "." << (((event.beginNanoseconds - origin) % 1000) / 100)
+			<< ",\"dur\":" << duration / 1000 << "." << ((duration % 1000) / 100) << "}";
+	}
+	trace << std::endl << "],\"displayTimeUnit\":\"ms\"}" << std::endl;
+
+	return trace.good();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "Tachyon.h"
+
+namespace Tachyon {
+	namespace Rendering {
+
+		/**
+		 * This is the cost of a pipeline stage measured over the most recent frames.
+		 */
+		struct StageStatistics {
+			/**
+			 * The name of the stage (e.g. "Render").
+			 */
+			std::string name;
+
+			/**
+			 * The number of measurements the statistics are computed on.
+			 */
+			glm::uint32 samplesCount;
+
+			glm::float64 minMilliseconds;
+
+			glm::float64 averageMilliseconds;
+
+			/**
+			 * The duration not exceeded by 99% of measurements.
+			 */
+			glm::float64 p99Milliseconds;
+		};
+
+		/**
+		 * This is the collector of stage timings: it keeps a rolling window of durations for each stage
+		 * and, when trace capture is enabled, every timed interval to be dumped as a Chrome trace.
+		 *
+		 * Timings are given in nanoseconds on any monotonic clock (CPU or GPU), but the same clock
+		 * must be used for every timing recorded on the same profiler.
+		 */
+		class FrameProfiler {
+		public:
+			FrameProfiler(const FrameProfiler&) = delete;
+
+			FrameProfiler(FrameProfiler&&) = delete;
+
+			FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+			~FrameProfiler() = default;
+
+			/**
+			 * Create an empty profiler.
+			 *
+			 * @param windowSize the number of most recent measurements kept for each stage
+			 */
+			FrameProfiler(size_t windowSize = 240) noexcept;
+
+			/**
+			 * Account an execution of a stage.
+			 *
+			 * @param stage the name of the stage, it must be a string literal
+			 * @param beginNanoseconds the time the stage has started at
+			 * @param endNanoseconds the time the stage has finished at
+			 */
+			void record(const char* stage, glm::uint64 beginNanoseconds, glm::uint64 endNanoseconds) noexcept;
+
+			/**
+			 * Get statistics of every stage recorded so far, in order of first appearance.
+			 *
+			 * @return statistics of each stage
+			 */
+			std::vector<StageStatistics> getStatistics() const noexcept;
+
+			/**
+			 * Forget every measurement recorded so far: the trace capture is not affected.
+			 */
+			void clear() noexcept;
+
+			/**
+			 * Start or stop keeping every recorded interval: starting a capture discards the previous one.
+			 *
+			 * @param enabled TRUE to keep intervals recorded from now on
+			 */
+			void setTraceCapture(bool enabled) noexcept;
+
+			/**
+			 * Write the captured intervals in the Chrome trace event format (to be opened with chrome://tracing or Perfetto).
+			 *
+			 * @param path the file to be written
+			 * @return TRUE on success
+			 */
+			bool writeChromeTrace(const std::string& path) const noexcept;
+
+			/**
+			 * Get the current time on the CPU monotonic clock.
+			 *
+			 * @return the time in nanoseconds
+			 */
+			static glm::uint64 now() noexcept;
+
+		private:
+			struct Stage {
+				const char* name;
+
+				/**
+				 * The most recent durations, used as a ring of windowSize elements.
+				 */
+				std::vector<glm::float64> milliseconds;
+
+				size_t nextSample;
+			};
+
+			struct TraceEvent {
+				const char* stage;
+
+				glm::uint64 beginNanoseconds;
+
+				glm::uint64 endNanoseconds;
+			};
+
+			size_t mWindowSize;
+
+			std::vector<Stage> mStages;
+
+			bool mTraceCapture;
+
+			std::vector<TraceEvent> mTraceEvents;
+		};
+
+	}
+}
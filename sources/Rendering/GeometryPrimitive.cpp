@@ -4,4 +4,12 @@ using namespace Tachyon;
 using namespace Tachyon::Rendering;
 
 GeometryPrimitive::GeometryPrimitive(glm::vec3 position, glm::float32 radius) noexcept
-	: glslData(glm::vec4(position, radius)) {}
\ No newline at end of file
+	: glslData(glm::vec4(position, radius)) {}
+
+glm::vec3 GeometryPrimitive::getCenter() const noexcept {
+	return glm::vec3(glslData.x, glslData.y, glslData.z);
+}
+
+glm::float32 GeometryPrimitive::getRadius() const noexcept {
+	return glslData.w;
+}
\ No newline at end of file
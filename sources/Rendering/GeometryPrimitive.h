@@ -14,7 +14,21 @@ namespace Tachyon {
 			GeometryPrimitive(glm::vec3 position = glm::vec3(0, 0, 0), glm::float32 radius = 0.0) noexcept;
 
 			~GeometryPrimitive() = default;
-			
+
+			/**
+			 * Get the center of the sphere.
+			 *
+			 * @return the sphere center
+			 */
+			glm::vec3 getCenter() const noexcept;
+
+			/**
+			 * Get the radius of the sphere.
+			 *
+			 * @return the sphere radius (0 for an invalid geometry)
+			 */
+			glm::float32 getRadius() const noexcept;
+
 		private:
 			glm::vec4 glslData;
 		};
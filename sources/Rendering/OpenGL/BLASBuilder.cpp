@@ -0,0 +1,195 @@
+#include "Rendering/OpenGL/BLASBuilder.h"
+#include "Rendering/OpenGL/StorageLayout.h"
+
+#include "Rendering/OpenGL/Pipeline/ComputeShader.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::OpenGL;
+using namespace Tachyon::Rendering::OpenGL::Pipeline;
+
+#include "shaders/raytrace_insert.comp.spv.h" // raytrace_insert_compOGL, raytrace_insert_compOGL_size
+
+namespace {
+	/**
+	 * Stages of the BLAS builder: these MUST match BVH_BUILD_STAGE_* in raytrace.comp.
+	 */
+	enum class BVHBuildStage : glm::uint {
+		Morton = 0,
+		Sort = 1,
+		Emit = 2,
+		Refit = 3,
+		Collapse = 4,
+	};
+
+	/**
+	 * Uniforms of the BVH_INSERT variant of raytrace.comp: locations MUST match layout(location = N) there.
+	 */
+	const UniformLocation<glm::uint> batchGeometryCountUniform = { 0 };
+	const UniformLocation<glm::uint> buildStageUniform = { 1 };
+
+	/**
+	 * The length of morton codes leaves are sorted by: this MUST match morton3D in raytrace.comp.
+	 */
+	const glm::uint32 mortonCodeBits = 30;
+}
+
+std::vector<SpecializationConstant> OpenGL::raytracerSpecialization(const SceneCapacity& capacity) noexcept {
+	return std::vector<SpecializationConstant>{
+		{ 0, capacity.expOfTwo_maxModels },
+		{ 1, capacity.expOfTwo_maxGeometryOnCollection },
+		{ 2, capacity.expOfTwo_maxCollectionsForModel },
+		{ 3, maxBLASDepth },
+	};
+}
+
+BLASBuilder::BLASBuilder(const SceneCapacity& capacity) noexcept
+	: mCapacity(capacity),
+	mRaytracerInsert(new Pipeline::Program(
+		std::initializer_list<std::shared_ptr<const Shader>>{
+			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_insert_compOGL), raytrace_insert_compOGL_size, "main", raytracerSpecialization(capacity))
+		})
+	),
+	mScratch(0),
+	mScratchCapacity(0) {
+	// Each internal node splits on a longer prefix of the morton code followed by the leaf index: paths are bound by the key length
+	DBG_ASSERT( ((mortonCodeBits + mCapacity.expOfTwo_maxCollectionsForModel) <= maxBLASDepth) );
+
+	// The temporary memory grows with the largest batch built
+	const size_t maxGeometryOnBLAS = size_t(1) << (mCapacity.expOfTwo_maxCollectionsForModel + mCapacity.expOfTwo_maxGeometryOnCollection);
+	reserveScratch(sizeof(glm::uint32) * 5 * maxGeometryOnBLAS);
+}
+
+BLASBuilder::~BLASBuilder() {
+	glDeleteBuffers(1, &mScratch);
+}
+
+size_t BLASBuilder::getMaxModelUploadSize(size_t alignment) const noexcept {
+	const size_t maxGeometryOnBLAS = size_t(1) << (mCapacity.expOfTwo_maxCollectionsForModel + mCapacity.expOfTwo_maxGeometryOnCollection);
+
+	return (sizeof(glm::vec4) * maxGeometryOnBLAS) + sizeof(InsertionBatch) + (2 * alignment);
+}
+
+GLuint BLASBuilder::reserveScratch(size_t size) noexcept {
+	if (size <= mScratchCapacity) return mScratch;
+
+	glDeleteBuffers(1, &mScratch);
+
+	mScratchCapacity = size;
+	glCreateBuffers(1, &mScratch);
+	glNamedBufferStorage(mScratch, mScratchCapacity, NULL, 0);
+
+	return mScratch;
+}
+
+void BLASBuilder::build(StreamingBuffer& uploadBuffer, std::vector<Model>::const_iterator first, std::vector<Model>::const_iterator last, std::vector<GLuint>::const_iterator firstBLAS, GPUTimer* timer) noexcept {
+	// Each batch (geometry, descriptors and their alignment) must fit in half of the upload buffer
+	const size_t maxBatchUploadSize = (uploadBuffer.getSize() / 2) - (2 * uploadBuffer.getAlignment());
+	const auto modelUploadSize = [](const Model& model) -> size_t {
+		return (sizeof(glm::vec4) * model.primitives.size()) + sizeof(InsertionBatch);
+	};
+
+	while (first != last) {
+		auto batchLast = first;
+		size_t batchUploadSize = 0;
+
+		do {
+			batchUploadSize += modelUploadSize(*batchLast);
+			++batchLast;
+		} while ((batchLast != last) && ((batchUploadSize + modelUploadSize(*batchLast)) <= maxBatchUploadSize));
+
+		buildBatch(uploadBuffer, first, batchLast, firstBLAS, timer);
+
+		firstBLAS += batchLast - first;
+		first = batchLast;
+	}
+}
+
+void BLASBuilder::buildBatch(StreamingBuffer& uploadBuffer, std::vector<Model>::const_iterator first, std::vector<Model>::const_iterator last, std::vector<GLuint>::const_iterator firstBLAS, GPUTimer* timer) noexcept {
+	static_assert( (sizeof(GeometryPrimitive) == sizeof(glm::vec4) ), "Geometry type not matching input GLSL");
+
+	// Describe each model of the batch
+	std::vector<InsertionBatch> batches;
+	batches.reserve(size_t(last - first));
+
+	glm::uint32 batchGeometryCount = 0, maxGeometryCount = 0;
+
+	auto blas = firstBLAS;
+	for (auto model = first; model != last; ++model, ++blas) {
+		DBG_ASSERT( (model->location < (GLuint(1) << mCapacity.expOfTwo_maxModels)) );
+		DBG_ASSERT( (*blas < (GLuint(1) << mCapacity.expOfTwo_maxResidentModels)) );
+		DBG_ASSERT( (model->primitives.size() <= (size_t(1) << (mCapacity.expOfTwo_maxCollectionsForModel + mCapacity.expOfTwo_maxGeometryOnCollection))) );
+
+		const glm::uint32 geometryCount = glm::uint32(model->primitives.size());
+
+		// Morton codes are relative to the bounds of geometry centers
+		glm::vec3 centroidsMin(std::numeric_limits<glm::float32>::max()), centroidsMax(std::numeric_limits<glm::float32>::lowest());
+		for (const auto& primitive : model->primitives) {
+			centroidsMin = glm::min(centroidsMin, primitive.getCenter());
+			centroidsMax = glm::max(centroidsMax, primitive.getCenter());
+		}
+		const glm::vec3 centroidsExtent = centroidsMax - centroidsMin;
+		const glm::vec3 centroidsInvExtent(
+			(centroidsExtent.x > 0.0f) ? (1.0f / centroidsExtent.x) : 0.0f,
+			(centroidsExtent.y > 0.0f) ? (1.0f / centroidsExtent.y) : 0.0f,
+			(centroidsExtent.z > 0.0f) ? (1.0f / centroidsExtent.z) : 0.0f);
+
+		batches.push_back(InsertionBatch{ *blas, batchGeometryCount, geometryCount, model->location, glm::vec4(centroidsMin, 0), glm::vec4(centroidsInvExtent, 0) });
+
+		batchGeometryCount += geometryCount;
+		maxGeometryCount = std::max(maxGeometryCount, geometryCount);
+	}
+
+	// Write geometry and descriptors directly on the upload buffer: only the given geometry is uploaded
+	const StreamingBuffer::Allocation geometryUpload = uploadBuffer.allocate(sizeof(glm::vec4) * std::max<size_t>(batchGeometryCount, 1));
+	glm::uint8* geometryDestination = reinterpret_cast<glm::uint8*>(geometryUpload.data);
+	for (auto model = first; model != last; ++model) {
+		if (model->primitives.empty()) continue;
+
+		std::memcpy(geometryDestination, model->primitives.data(), sizeof(GeometryPrimitive) * model->primitives.size());
+		geometryDestination += sizeof(GeometryPrimitive) * model->primitives.size();
+	}
+
+	const StreamingBuffer::Allocation batchesUpload = uploadBuffer.allocate(sizeof(InsertionBatch) * batches.size());
+	std::memcpy(batchesUpload.data, batches.data(), sizeof(InsertionBatch) * batches.size());
+
+	// Make room for the builder memory of the whole batch
+	reserveScratch(sizeof(glm::uint32) * 5 * batchGeometryCount);
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, uploadBuffer.getBuffer(), geometryUpload.offset, geometryUpload.size);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mScratch);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 6, uploadBuffer.getBuffer(), batchesUpload.offset, batchesUpload.size);
+
+	Program::use(*mRaytracerInsert);
+
+	mRaytracerInsert->setUniform(batchGeometryCountUniform, batchGeometryCount);
+
+	const glm::uint32 modelsCount = glm::uint32(batches.size());
+	const glm::uint32 maxLeafsCount = (maxGeometryCount + (glm::uint32(1) << mCapacity.expOfTwo_maxGeometryOnCollection) - 1) >> mCapacity.expOfTwo_maxGeometryOnCollection;
+
+	// Each stage reads what the previous one has written
+	const std::array<std::pair<BVHBuildStage, glm::uint32>, 5> stages = {
+		std::make_pair(BVHBuildStage::Morton, maxGeometryCount),
+		std::make_pair(BVHBuildStage::Sort, glm::uint32(0)),
+		std::make_pair(BVHBuildStage::Emit, std::max(maxGeometryCount, glm::uint32(1))),
+		std::make_pair(BVHBuildStage::Refit, maxLeafsCount),
+		std::make_pair(BVHBuildStage::Collapse, std::max(maxLeafsCount, glm::uint32(2)) - 1),
+	};
+
+	const glm::uint32 insertTiming = (timer) ? timer->begin("Insert") : GPUTimer::invalidTiming;
+	for (const auto& stage : stages) {
+		mRaytracerInsert->setUniform(buildStageUniform, glm::uint(stage.first));
+
+		// The sort stage is executed by a single work group for each model
+		const glm::uvec3 workGroupsCount = (stage.first == BVHBuildStage::Sort) ?
+			glm::uvec3(1, 1, modelsCount) :
+			mRaytracerInsert->getComputeWorkGroupsCount(glm::uvec3(stage.second, 1, modelsCount));
+		glDispatchCompute(workGroupsCount.x, workGroupsCount.y, workGroupsCount.z);
+
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+	if (timer) timer->end(insertTiming);
+
+	// The uploaded data can be overwritten once these dispatches have completed
+	uploadBuffer.fence();
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "Rendering/RenderingPipeline.h"
+
+#include "Rendering/OpenGL/Pipeline/Program.h"
+#include "Rendering/OpenGL/Pipeline/Shader.h"
+#include "Rendering/OpenGL/StreamingBuffer.h"
+#include "Rendering/OpenGL/GPUTimer.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * Generate the specialization of raytrace.comp for the given scene capacity.
+			 *
+			 * @param capacity the scene capacity
+			 * @return values of the capacity specialization constants
+			 */
+			std::vector<Pipeline::SpecializationConstant> raytracerSpecialization(const SceneCapacity& capacity) noexcept;
+
+			/**
+			 * This is the GPU builder of BLASes: it owns the BVH_INSERT program and its temporary memory,
+			 * so that BLASes can be built on any context sharing the scene with the renderer.
+			 *
+			 * Every GL object is created on the context current at construction, the builder
+			 * MUST then only be used (and destroyed) while that same context is current.
+			 */
+			class BLASBuilder {
+			public:
+				BLASBuilder() = delete;
+
+				BLASBuilder(const BLASBuilder&) = delete;
+
+				BLASBuilder(BLASBuilder&&) = delete;
+
+				BLASBuilder& operator=(const BLASBuilder&) = delete;
+
+				~BLASBuilder();
+
+				/**
+				 * Create the builder program and its temporary memory.
+				 *
+				 * @param capacity the scene capacity, as given to the pipeline
+				 */
+				BLASBuilder(const SceneCapacity& capacity) noexcept;
+
+				/**
+				 * Get the largest upload a single model needs: the upload buffer given to build()
+				 * must be at least twice as large.
+				 *
+				 * @param alignment the alignment of upload buffer allocations
+				 * @return the size in bytes
+				 */
+				size_t getMaxModelUploadSize(size_t alignment) const noexcept;
+
+				/**
+				 * Build the BLAS of every given model: models are uploaded through the given ring buffer
+				 * and each batch of models that fits in it is built by the same dispatches.
+				 *
+				 * Only BLAS nodes, geometry and links of the given BLASes (and matrices of the given locations) are written:
+				 * scene buffers MUST be bound on the current context (see OpenGLPipeline::bindSceneBuffers).
+				 *
+				 * @param uploadBuffer the ring buffer models are uploaded through
+				 * @param first the first model to be built
+				 * @param last the model after the last one to be built
+				 * @param firstBLAS the BLAS each model is stored on, in the order of models
+				 * @param timer the timer build dispatches are accounted on, nullptr to not measure them
+				 */
+				void build(StreamingBuffer& uploadBuffer, std::vector<Model>::const_iterator first, std::vector<Model>::const_iterator last, std::vector<GLuint>::const_iterator firstBLAS, GPUTimer* timer) noexcept;
+
+				/**
+				 * Make sure the temporary memory is at least as large as requested: its content is lost when it grows.
+				 *
+				 * The same memory can be used by other programs between builds (e.g. by geometry updates).
+				 *
+				 * @param size the size in bytes
+				 * @return the buffer of the temporary memory
+				 */
+				GLuint reserveScratch(size_t size) noexcept;
+
+			private:
+				/**
+				 * Build the BLAS of every given model with a single dispatch for each build stage.
+				 *
+				 * @param uploadBuffer the ring buffer models are uploaded through
+				 * @param first the first model to be built
+				 * @param last the model after the last one to be built
+				 * @param firstBLAS the BLAS each model is stored on
+				 * @param timer the timer build dispatches are accounted on, or nullptr
+				 */
+				void buildBatch(StreamingBuffer& uploadBuffer, std::vector<Model>::const_iterator first, std::vector<Model>::const_iterator last, std::vector<GLuint>::const_iterator firstBLAS, GPUTimer* timer) noexcept;
+
+				const SceneCapacity mCapacity;
+
+				std::unique_ptr<Pipeline::Program> mRaytracerInsert;
+
+				/**
+				 * This is the SSBO used to sort geometry and to refit nodes (see bvhBuildScratch on raytrace.comp).
+				 */
+				GLuint mScratch;
+
+				/**
+				 * The size of the temporary memory in bytes.
+				 */
+				size_t mScratchCapacity;
+			};
+		}
+	}
+}
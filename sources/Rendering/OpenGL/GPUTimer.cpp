@@ -0,0 +1,67 @@
+#include "Rendering/OpenGL/GPUTimer.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::OpenGL;
+
+constexpr glm::uint32 GPUTimer::invalidTiming;
+
+GPUTimer::GPUTimer(FrameProfiler& profiler, size_t capacity) noexcept
+	: mProfiler(profiler),
+	mTimings(capacity) {
+	std::vector<GLuint> queries(capacity * 2);
+	glGenQueries(GLsizei(queries.size()), queries.data());
+
+	mFreeTimings.reserve(capacity);
+	for (size_t i = 0; i < capacity; ++i) {
+		mTimings[i] = Timing{ nullptr, queries[2 * i], queries[2 * i + 1] };
+		mFreeTimings.push_back(glm::uint32(capacity - 1 - i));
+	}
+}
+
+GPUTimer::~GPUTimer() {
+	for (const auto& timing : mTimings) {
+		glDeleteQueries(1, &timing.beginQuery);
+		glDeleteQueries(1, &timing.endQuery);
+	}
+}
+
+glm::uint32 GPUTimer::begin(const char* stage) noexcept {
+	if (mFreeTimings.empty()) return invalidTiming;
+
+	const glm::uint32 timing = mFreeTimings.back();
+	mFreeTimings.pop_back();
+
+	mTimings[timing].stage = stage;
+	glQueryCounter(mTimings[timing].beginQuery, GL_TIMESTAMP);
+
+	return timing;
+}
+
+void GPUTimer::end(glm::uint32 timing) noexcept {
+	if (timing == invalidTiming) return;
+
+	glQueryCounter(mTimings[timing].endQuery, GL_TIMESTAMP);
+
+	mIssuedTimings.push_back(timing);
+}
+
+void GPUTimer::collect() noexcept {
+	while (!mIssuedTimings.empty()) {
+		const Timing& timing = mTimings[mIssuedTimings.front()];
+
+		// The end timestamp is resolved last: if it is not available the stage is still running
+		GLint available = GL_FALSE;
+		glGetQueryObjectiv(timing.endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+		if (available == GL_FALSE) break;
+
+		GLuint64 beginNanoseconds = 0, endNanoseconds = 0;
+		glGetQueryObjectui64v(timing.beginQuery, GL_QUERY_RESULT, &beginNanoseconds);
+		glGetQueryObjectui64v(timing.endQuery, GL_QUERY_RESULT, &endNanoseconds);
+
+		mProfiler.record(timing.stage, beginNanoseconds, endNanoseconds);
+
+		mFreeTimings.push_back(mIssuedTimings.front());
+		mIssuedTimings.pop_front();
+	}
+}
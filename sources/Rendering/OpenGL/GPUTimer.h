@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Rendering/FrameProfiler.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * This is a pool of GL_TIMESTAMP queries used to measure GPU stages without stalling the CPU.
+			 *
+			 * Each stage is enclosed by two timestamps; results are never waited for: collect() only reads
+			 * queries the GPU has already resolved (usually issued some frames before) and feeds the profiler.
+			 * Timestamps are used instead of GL_TIME_ELAPSED because elapsed queries cannot be nested or overlapped.
+			 *
+			 * When every query is in flight the stage is not measured, rather than waiting for a result.
+			 */
+			class GPUTimer {
+			public:
+				/**
+				 * This is returned by begin() when the stage is not being measured.
+				 */
+				static constexpr glm::uint32 invalidTiming = 0xFFFFFFFF;
+
+				GPUTimer() = delete;
+
+				GPUTimer(const GPUTimer&) = delete;
+
+				GPUTimer(GPUTimer&&) = delete;
+
+				GPUTimer& operator=(const GPUTimer&) = delete;
+
+				~GPUTimer();
+
+				/**
+				 * Create the query pool.
+				 *
+				 * @param profiler the profiler resolved timings are recorded on
+				 * @param capacity the maximum number of stages waiting for their timings to be resolved
+				 */
+				GPUTimer(FrameProfiler& profiler, size_t capacity = 64) noexcept;
+
+				/**
+				 * Mark the beginning of a stage after every previously issued GL command.
+				 *
+				 * @param stage the name of the stage, it must be a string literal
+				 * @return the timing to be passed to end()
+				 */
+				glm::uint32 begin(const char* stage) noexcept;
+
+				/**
+				 * Mark the end of a stage after every previously issued GL command.
+				 *
+				 * @param timing the value returned by begin()
+				 */
+				void end(glm::uint32 timing) noexcept;
+
+				/**
+				 * Record on the profiler every timing already resolved by the GPU, without waiting.
+				 */
+				void collect() noexcept;
+
+			private:
+				struct Timing {
+					const char* stage;
+
+					GLuint beginQuery;
+
+					GLuint endQuery;
+				};
+
+				FrameProfiler& mProfiler;
+
+				std::vector<Timing> mTimings;
+
+				std::vector<glm::uint32> mFreeTimings;
+
+				/**
+				 * Timings waiting for results, in issue order: the GPU resolves them in the same order.
+				 */
+				std::deque<glm::uint32> mIssuedTimings;
+			};
+
+		}
+	}
+}
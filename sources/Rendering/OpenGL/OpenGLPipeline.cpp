@@ -11,40 +11,112 @@ using namespace Tachyon::Rendering::OpenGL::Pipeline;
 
 #include "shaders/tonemapping.vert.spv.h" // SHADER_TONEMAPPING_VERT, SHADER_TONEMAPPING_VERT_size
 #include "shaders/tonemapping.frag.spv.h" // SHADER_TONEMAPPING_FRAG, SHADER_TONEMAPPING_FRAG_size
-#include "shaders/raytrace_insert.comp.spv.h" // raytrace_insert_compOGL, raytrace_insert_compOGL_size
 #include "shaders/raytrace_flush.comp.spv.h" // raytrace_flush_compOGL, raytrace_flush_compOGL_size
 #include "shaders/raytrace_render.comp.spv.h" // raytrace_render_compOGL, raytrace_render_compOGL_size
 #include "shaders/raytrace_update.comp.spv.h" // raytrace_update_compOGL, raytrace_update_compOGL_size
+#include "shaders/raytrace_geometry_update.comp.spv.h" // raytrace_geometry_update_compOGL, raytrace_geometry_update_compOGL_size
+#include "shaders/raytrace_ray_query.comp.spv.h" // raytrace_ray_query_compOGL, raytrace_ray_query_compOGL_size
 #include "shaders/raytrace_query_info.comp.spv.h" // raytrace_query_info_compOGL raytrace_query_info_compOGL_size
 
-OpenGLPipeline::OpenGLPipeline() noexcept
-    : RenderingPipeline(),
+namespace {
+	/**
+	 * The minimum size of the ring buffer used to upload models.
+	 */
+	constexpr size_t uploadBufferMinSize = size_t(16) << 20;
+
+	/**
+	 * The size of the ring buffer ray query results are read back from.
+	 */
+	constexpr size_t rayQueryResultsBufferSize = size_t(4) << 20;
+
+	/**
+	 * Uniforms of raytrace.comp and tonemapping.frag: locations MUST match layout(location = N) there.
+	 */
+	const UniformLocation<glm::uint> transformUpdatesCountUniform = { 0 };
+	const UniformLocation<glm::uint> rayQueriesCountUniform = { 0 };
+	const UniformLocation<glm::uint> rayQueryTypeUniform = { 1 };
+	const UniformLocation<glm::float32> gammaUniform = { 0 };
+	const UniformLocation<glm::float32> exposureUniform = { 1 };
+
+	/**
+	 * The binding of renderConstants in raytrace.comp.
+	 */
+	const GLuint renderConstantsBinding = 0;
+
+	/**
+	 * The number of frames whose constants can be read by the GPU while the next ones are written.
+	 */
+	const size_t renderConstantsFrames = 3;
+
+	/**
+	 * Marks a model without a pending transformation.
+	 */
+	constexpr glm::uint32 noPendingTransform = std::numeric_limits<glm::uint32>::max();
+
+	/**
+	 * Scene files are copied from and to GPU buffers in chunks of this size, so that the driver
+	 * moves a chunk while the next one is being read from (or written to) the file.
+	 */
+	constexpr size_t sceneFileChunkSize = size_t(64) << 20;
+
+	/**
+	 * The binding of blasLinksStorage in raytrace.comp.
+	 */
+	const GLuint blasLinksBinding = 8;
+
+	/**
+	 * Bindings of modelResidencyStorage and residencyFeedbackStorage in raytrace.comp.
+	 */
+	const GLuint modelResidencyBinding = 9;
+	const GLuint residencyFeedbackBinding = 10;
+
+	/**
+	 * Get the number of elements of the scratch memory of a geometry update: this MUST match GEOMETRY_UPDATE_SCRATCH_SIZE in raytrace.comp.
+	 *
+	 * @param expOfTwo_numberOfGeometryCollectionOnBLAS the number of leaves of each BLAS, as an exponent of two
+	 * @return a refit counter and a bit for each BLAS node
+	 */
+	size_t geometryUpdateScratchSize(glm::uint32 expOfTwo_numberOfGeometryCollectionOnBLAS) noexcept {
+		const size_t blasNodesCount = (size_t(1) << (expOfTwo_numberOfGeometryCollectionOnBLAS + 1)) - 1;
+
+		return blasNodesCount + ((blasNodesCount + 31) / 32);
+	}
+}
+
+OpenGLPipeline::OpenGLPipeline(const SceneCapacity& capacity) noexcept
+    : RenderingPipeline(capacity),
 	mRaytracerQueryInfo(
 		new Pipeline::Program(
 		std::initializer_list<std::shared_ptr<const Shader>>{
-			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_query_info_compOGL), raytrace_query_info_compOGL_size)
+			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_query_info_compOGL), raytrace_query_info_compOGL_size, "main", raytracerSpecialization(capacity))
 		})
 	),
 	mRaytracerFlush(
 		new Pipeline::Program(
 		std::initializer_list<std::shared_ptr<const Shader>>{
-			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_flush_compOGL), raytrace_flush_compOGL_size)
+			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_flush_compOGL), raytrace_flush_compOGL_size, "main", raytracerSpecialization(capacity))
 		})
 	),
 	mRaytracerUpdate(
 		new Pipeline::Program(
 		std::initializer_list<std::shared_ptr<const Shader>>{
-			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_update_compOGL), raytrace_update_compOGL_size)
+			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_update_compOGL), raytrace_update_compOGL_size, "main", raytracerSpecialization(capacity))
 		})
 	),
-	mRaytracerInsert(new Pipeline::Program(
+	mBLASBuilder(new BLASBuilder(capacity)),
+	mRaytracerGeometryUpdate(new Pipeline::Program(
 		std::initializer_list<std::shared_ptr<const Shader>>{
-			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_insert_compOGL), raytrace_insert_compOGL_size)
+			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_geometry_update_compOGL), raytrace_geometry_update_compOGL_size, "main", raytracerSpecialization(capacity))
 		})
 	),
 	mRaytracerRender(new Pipeline::Program(
         std::initializer_list<std::shared_ptr<const Shader>>{
-			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char *>(raytrace_render_compOGL), raytrace_render_compOGL_size)
+			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char *>(raytrace_render_compOGL), raytrace_render_compOGL_size, "main", raytracerSpecialization(capacity))
+		})
+	),
+	mRaytracerRayQuery(new Pipeline::Program(
+		std::initializer_list<std::shared_ptr<const Shader>>{
+			std::make_shared<const ComputeShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(raytrace_ray_query_compOGL), raytrace_ray_query_compOGL_size, "main", raytracerSpecialization(capacity))
 		})
 	),
 	mDisplayWriter(new Pipeline::Program(
@@ -53,8 +125,28 @@ OpenGLPipeline::OpenGLPipeline() noexcept
 			std::make_shared<const FragmentShader>(Shader::SourceType::SPIRV, reinterpret_cast<const char*>(tonemapping_fragOGL), tonemapping_fragOGL_size)
 		})
     ),
+	mOutputFormat(OutputFormat::RGBA8),
 	mRaytracerOutputTexture(0),
-	mRaytracingTLAS(0) {
+	mDisplayTexture(0),
+	mDisplayFramebuffer(0),
+	mRaytracingTLAS(0),
+	mRaytracingBLASCollection(0),
+	mRaytracingWideBLASCollection(0),
+	mRaytracingGeometryCollection(0),
+	mRaytracingModelMatrix(0),
+	mRaytracingBLASLinks(0),
+	mRaytracingModelResidency(0),
+	mExpOfTwo_numberOfResidentModels(capacity.expOfTwo_maxResidentModels),
+	mResidencyFeedback(0),
+	mResidencyFeedbackReadback(0),
+	mResidencyFeedbackMapping(nullptr),
+	mResidencyFeedbackFence(0),
+	mResidencyFeedbackCollection(false),
+	mPersistentThreadsWorkGroups(0),
+	mTraversalStatisticsCollection(false) {
+
+	// Measure GPU stages without ever waiting for their results
+	mGPUTimer.reset(new GPUTimer(getProfiler()));
 
 	// Query raytracer capabilities
 	GLuint mRaytracerInfoSSBO;
@@ -62,12 +154,19 @@ OpenGLPipeline::OpenGLPipeline() noexcept
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, mRaytracerInfoSSBO);
 	glNamedBufferStorage(mRaytracerInfoSSBO, sizeof(RaytracerInfo), NULL, GL_MAP_READ_BIT); // when done I want to read back results
 	Program::use(*mRaytracerQueryInfo); // This is the program that I use to query raytracer capabilities
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mRaytracerInfoSSBO); // Bind the buffer to be used to retrieve info about the raytracer
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mRaytracerInfoSSBO); // Bind the buffer to be used to retrieve info about the raytracer
 	glDispatchCompute(1, 1, 1); // Only one work is needed
 	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT); // Wit for the GPU to write out results
 	const RaytracerInfo* infoPtr = reinterpret_cast<const RaytracerInfo*>(glMapNamedBufferRange(mRaytracerInfoSSBO, 0, sizeof(RaytracerInfo), GL_MAP_READ_BIT)); // map the memory so I can read the capabilities of the raytracer
 	DBG_ASSERT( (infoPtr != nullptr) );
 	mRaytracerInfo = *infoPtr; // Copy info retrieved from the GPU to a more conventional type of memory
+	DBG_ASSERT( (mRaytracerInfo.expOfTwo_numberOfModels == capacity.expOfTwo_maxModels) ); // Make sure the raytracer has been specialized as requested
+	DBG_ASSERT( (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS == capacity.expOfTwo_maxCollectionsForModel) );
+	DBG_ASSERT( (mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection == capacity.expOfTwo_maxGeometryOnCollection) );
+	DBG_ASSERT( (mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection <= 8) ); // Wide nodes store the size of leaves on a byte
+	GLint maxStorageBufferBindings = 0;
+	glGetIntegerv(GL_MAX_SHADER_STORAGE_BUFFER_BINDINGS, &maxStorageBufferBindings);
+	DBG_ASSERT( (GLuint(maxStorageBufferBindings) > residencyFeedbackBinding) );
 	glUnmapNamedBuffer(mRaytracerInfoSSBO); // Done, unmap the memory
 	glDeleteBuffers(1, &mRaytracerInfoSSBO); // Done, delete the GPU memory
 
@@ -95,75 +194,129 @@ OpenGLPipeline::OpenGLPipeline() noexcept
 	glEnableVertexArrayAttrib(mQuadVAO, 0);
 
 	// Activate needed texture units
-	glActiveTexture(GL_TEXTURE0);
-	glActiveTexture(GL_TEXTURE1);
-	glActiveTexture(GL_TEXTURE2);
-	glActiveTexture(GL_TEXTURE3);
-	glActiveTexture(GL_TEXTURE4);
 	glActiveTexture(GL_TEXTURE5);
 
-	// TLAS TEXTURE CREATION
-	glCreateTextures(GL_TEXTURE_1D, 1, &mRaytracingTLAS);
-	glBindTexture(GL_TEXTURE_1D, mRaytracingTLAS);
-	glTextureStorage1D(mRaytracingTLAS, 1, GL_RGBA32F, (size_t(1) << (mRaytracerInfo.expOfTwo_numberOfModels + 1)) * 2);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
-	glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_BASE_LEVEL, 0);
-	// END OF TLAS TEXTURE CREATION
-
-	// BLAS COLLECTION TEXTURE CREATION
-	glCreateTextures(GL_TEXTURE_2D, 1, &mRaytracingBLASCollection);
-	glBindTexture(GL_TEXTURE_2D, mRaytracingBLASCollection);
-	glTextureStorage2D(mRaytracingBLASCollection, 1, GL_RGBA32F, (size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS + 1)) * 2, size_t(1) << mRaytracerInfo.expOfTwo_numberOfModels);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-	// END OF BLAS COLLECTION TEXTURE CREATION
+	const size_t modelsCount = size_t(1) << mRaytracerInfo.expOfTwo_numberOfModels;
 
-	// MODELMATRIX TEXTURE CREATION
-	glCreateTextures(GL_TEXTURE_2D, 1, &mRaytracingModelMatrix);
-	glBindTexture(GL_TEXTURE_2D, mRaytracingModelMatrix);
-	glTextureStorage2D(mRaytracingModelMatrix, 1, GL_RGBA32F, 4, size_t(1) << mRaytracerInfo.expOfTwo_numberOfModels);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-	// END OF MODELMATRIX TEXTURE CREATION
-
-	// GEOMETRY COLLECTION TEXTURE CREATION
-	size_t geometryX = size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection + mRaytracerInfo.oxpOfTwo_numberOfTesselsForGeometryTexturazation);
-	size_t geometryY = size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS;
-	size_t geometryZ = size_t(1) << mRaytracerInfo.expOfTwo_numberOfModels;
-	glCreateTextures(GL_TEXTURE_3D, 1, &mRaytracingGeometryCollection);
-	glBindTexture(GL_TEXTURE_3D, mRaytracingGeometryCollection);
-	glTextureStorage3D(
-		mRaytracingGeometryCollection,
-		1, GL_RGBA32F,
-		size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection + mRaytracerInfo.oxpOfTwo_numberOfTesselsForGeometryTexturazation),
-		size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS,
-		size_t(1) << mRaytracerInfo.expOfTwo_numberOfModels);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
-	// END OF GEOMETRY COLLECTION TEXTURE CREATION
+	// Locations (TLAS leaves) are cheap, BLASes are not: storage of models is only allocated for those that can be resident at once
+	const size_t residentModelsCount = size_t(1) << mExpOfTwo_numberOfResidentModels;
+
+	// TLAS SSBO CREATION
+	glCreateBuffers(1, &mRaytracingTLAS);
+	glNamedBufferStorage(mRaytracingTLAS, sizeof(BVHNode) * ((size_t(1) << (mRaytracerInfo.expOfTwo_numberOfModels + 1)) - 1), NULL, GL_DYNAMIC_STORAGE_BIT);
+	glClearNamedBufferData(mRaytracingTLAS, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	// END OF TLAS SSBO CREATION
+
+	// BLAS COLLECTION SSBO CREATION
+	glCreateBuffers(1, &mRaytracingBLASCollection);
+	glNamedBufferStorage(mRaytracingBLASCollection, sizeof(BVHNode) * ((size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS + 1)) - 1) * residentModelsCount, NULL, GL_DYNAMIC_STORAGE_BIT);
+	glClearNamedBufferData(mRaytracingBLASCollection, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	// END OF BLAS COLLECTION SSBO CREATION
+
+	// WIDE BLAS COLLECTION SSBO CREATION: a wide node is stored at the index of an internal node, or at the root
+	glCreateBuffers(1, &mRaytracingWideBLASCollection);
+	glNamedBufferStorage(mRaytracingWideBLASCollection, sizeof(WideBVHNode) * (size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS) * residentModelsCount, NULL, GL_DYNAMIC_STORAGE_BIT);
+	glClearNamedBufferData(mRaytracingWideBLASCollection, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	// END OF WIDE BLAS COLLECTION SSBO CREATION
+
+	// MODELMATRIX SSBO CREATION
+	glCreateBuffers(1, &mRaytracingModelMatrix);
+	glNamedBufferStorage(mRaytracingModelMatrix, sizeof(ModelMatrices) * modelsCount, NULL, GL_DYNAMIC_STORAGE_BIT);
+	glClearNamedBufferData(mRaytracingModelMatrix, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	// END OF MODELMATRIX SSBO CREATION
+
+	// GEOMETRY COLLECTION SSBO CREATION
+	glCreateBuffers(1, &mRaytracingGeometryCollection);
+	glNamedBufferStorage(mRaytracingGeometryCollection, sizeof(glm::vec4) * (size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS + mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection)) * residentModelsCount, NULL, GL_DYNAMIC_STORAGE_BIT);
+	glClearNamedBufferData(mRaytracingGeometryCollection, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+	// END OF GEOMETRY COLLECTION SSBO CREATION
+
+	// BLAS LINKS SSBO CREATION (see blasLinksStorage on raytrace.comp)
+	const size_t maxGeometryOnBLAS = size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS + mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection);
+	glCreateBuffers(1, &mRaytracingBLASLinks);
+	glNamedBufferStorage(mRaytracingBLASLinks, sizeof(glm::uint32) * (maxGeometryOnBLAS + ((size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS + 1)) - 1)) * residentModelsCount, NULL, GL_DYNAMIC_STORAGE_BIT);
+	// END OF BLAS LINKS SSBO CREATION
+
+	// MODEL RESIDENCY SSBO CREATION (written by resetResidency)
+	glCreateBuffers(1, &mRaytracingModelResidency);
+	glNamedBufferStorage(mRaytracingModelResidency, sizeof(ModelResidency) * modelsCount, NULL, GL_DYNAMIC_STORAGE_BIT);
+	// END OF MODEL RESIDENCY SSBO CREATION
+
+	// Create the residency feedback and the buffer it is read back from
+	glCreateBuffers(1, &mResidencyFeedback);
+	glNamedBufferStorage(mResidencyFeedback, sizeof(glm::uint32) * modelsCount, NULL, GL_DYNAMIC_STORAGE_BIT);
+	glClearNamedBufferData(mResidencyFeedback, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+	const GLbitfield residencyFeedbackReadbackFlags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	glCreateBuffers(1, &mResidencyFeedbackReadback);
+	glNamedBufferStorage(mResidencyFeedbackReadback, sizeof(glm::uint32) * modelsCount, NULL, residencyFeedbackReadbackFlags | GL_CLIENT_STORAGE_BIT);
+	mResidencyFeedbackMapping = reinterpret_cast<const glm::uint32*>(glMapNamedBufferRange(mResidencyFeedbackReadback, 0, sizeof(glm::uint32) * modelsCount, residencyFeedbackReadbackFlags));
+	DBG_ASSERT( (mResidencyFeedbackMapping != nullptr) );
+
+	// Create the ring buffer used to upload models: the largest model must fit in half of it
+	GLint storageBufferOffsetAlignment = 0;
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageBufferOffsetAlignment);
+	const size_t maxModelUploadSize = mBLASBuilder->getMaxModelUploadSize(size_t(storageBufferOffsetAlignment));
+	const size_t maxTLASUpdateUploadSize = ((sizeof(TransformUpdate) + (2 * sizeof(glm::uint32))) * modelsCount) + (sizeof(glm::uint32) * (mRaytracerInfo.expOfTwo_numberOfModels + 2)) + (2 * size_t(storageBufferOffsetAlignment));
+	mUploadBuffer.reset(new StreamingBuffer(std::max(uploadBufferMinSize, 2 * std::max(maxModelUploadSize, maxTLASUpdateUploadSize)), size_t(storageBufferOffsetAlignment)));
+
+	// Create the ring buffer frame constants are uploaded through
+	GLint uniformBufferOffsetAlignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformBufferOffsetAlignment);
+	const size_t alignedRenderConstantsSize = ((sizeof(RenderConstants) + size_t(uniformBufferOffsetAlignment) - 1) / size_t(uniformBufferOffsetAlignment)) * size_t(uniformBufferOffsetAlignment);
+	mRenderConstants.reset(new StreamingBuffer(renderConstantsFrames * alignedRenderConstantsSize, size_t(uniformBufferOffsetAlignment)));
+
+	// Create the ring buffer ray query results are read back from
+	mRayQueries.reset(new RayQueryQueue(rayQueryResultsBufferSize, size_t(storageBufferOffsetAlignment)));
+
+	// Nothing to update on an empty scene
+	mPendingTransformIndex.assign(modelsCount, noPendingTransform);
+	mModelDirtyFlags.assign(modelsCount, false);
+	mModelGeometryCount.assign(modelsCount, 0);
+
+	// Every BLAS is free
+	resetResidency();
+
+	// The scene is used by every raytracing program, so it is bound only once
+	bindSceneBuffers();
+
+	// Create the screen tiles counter used by the persistent threads rendering mode
+	glCreateBuffers(1, &mRenderTilesCounter);
+	glNamedBufferStorage(mRenderTilesCounter, sizeof(glm::uint32), NULL, GL_DYNAMIC_STORAGE_BIT);
+
+	// Create the buffer used to measure the traversal cost
+	const TraversalStatistics emptyStatistics = { 0, 0, 0 };
+	glCreateBuffers(1, &mTraversalStatistics);
+	glNamedBufferStorage(mTraversalStatistics, sizeof(TraversalStatistics), &emptyStatistics, GL_DYNAMIC_STORAGE_BIT);
 	
 	// The VAO with the screen quad needs to be binded only once as the raytracing never uses any other VAOs
 	glBindVertexArray(mQuadVAO);
 }
 
 OpenGLPipeline::~OpenGLPipeline() {
-	// Delete textures used to store the scene
-	glDeleteTextures(1, &mRaytracingTLAS);
-	glDeleteTextures(1, &mRaytracingBLASCollection);
-	glDeleteTextures(1, &mRaytracingGeometryCollection);
-	glDeleteTextures(1, &mRaytracingModelMatrix);
+	// Delete SSBOs used to store the scene
+	glDeleteBuffers(1, &mRaytracingTLAS);
+	glDeleteBuffers(1, &mRaytracingBLASCollection);
+	glDeleteBuffers(1, &mRaytracingWideBLASCollection);
+	glDeleteBuffers(1, &mRaytracingGeometryCollection);
+	glDeleteBuffers(1, &mRaytracingModelMatrix);
+	glDeleteBuffers(1, &mRaytracingBLASLinks);
+	glDeleteBuffers(1, &mRaytracingModelResidency);
+
+	// Delete the residency feedback
+	if (mResidencyFeedbackFence) glDeleteSync(mResidencyFeedbackFence);
+	glUnmapNamedBuffer(mResidencyFeedbackReadback);
+	glDeleteBuffers(1, &mResidencyFeedbackReadback);
+	glDeleteBuffers(1, &mResidencyFeedback);
+
+	// Delete the screen tiles counter
+	glDeleteBuffers(1, &mRenderTilesCounter);
+
+	// Delete the traversal cost buffer
+	glDeleteBuffers(1, &mTraversalStatistics);
+
+	// Delete the raytracing output
+	destroyOutputTextures();
 
 	// Avoid removing a VAO while it is currently bound
 	glBindVertexArray(0);
@@ -175,134 +328,874 @@ OpenGLPipeline::~OpenGLPipeline() {
 	glDeleteBuffers(1, &mQuadVBO);
 }
 
-void OpenGLPipeline::reset() noexcept {
+void OpenGLPipeline::onReset() noexcept {
 	flush();
+
+	invalidateAccumulation();
+}
+
+void OpenGLPipeline::onRemoveModel(GLuint location) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+
+	// An empty transform flags the location as empty: the next update empties its TLAS leaf (see TLAS_UPDATE on raytrace.comp)
+	const ModelMatrices emptyMatrices = { glm::mat4(0), glm::mat4(0) };
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glNamedBufferSubData(mRaytracingModelMatrix, sizeof(ModelMatrices) * location, sizeof(ModelMatrices), &emptyMatrices);
+
+	// A pending transformation must not move the next model placed on the same location
+	const glm::uint32 pendingIndex = mPendingTransformIndex[location];
+	if (pendingIndex != noPendingTransform) {
+		mPendingTransformIndex[location] = noPendingTransform;
+
+		if (pendingIndex != (mPendingTransforms.size() - 1)) {
+			mPendingTransforms[pendingIndex] = mPendingTransforms.back();
+			mPendingTransformIndex[mPendingTransforms[pendingIndex].location] = pendingIndex;
+		}
+		mPendingTransforms.pop_back();
+	}
+
+	mModelGeometryCount[location] = 0;
+
+	// The BLAS can take another model right away (unless instances still refer to it), and the location has no proxy left
+	releaseBLAS(location);
+
+	const ModelResidency emptyResidency = { glm::vec3(0), nonResidentBLAS, glm::vec3(0), 0 };
+	glNamedBufferSubData(mRaytracingModelResidency, sizeof(ModelResidency) * location, sizeof(ModelResidency), &emptyResidency);
+
+	markModelDirty(location);
+}
+
+void OpenGLPipeline::onUpdateModelPrimitives(GLuint location, size_t firstPrimitive, const std::vector<GeometryPrimitive>& primitives) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+	DBG_ASSERT( ((firstPrimitive + primitives.size()) <= mModelGeometryCount[location]) );
+	if ((firstPrimitive + primitives.size()) > mModelGeometryCount[location]) return;
+
+	// Only a resident model has geometry to be updated
+	const GLuint blas = mModelBLAS[location];
+	DBG_ASSERT( (blas != nonResidentBLAS) );
+	if (blas == nonResidentBLAS) return;
+
+	// Write the new geometry and the update descriptor directly on the upload buffer
+	const StreamingBuffer::Allocation geometryUpload = mUploadBuffer->allocate(sizeof(GeometryPrimitive) * primitives.size());
+	std::memcpy(geometryUpload.data, primitives.data(), sizeof(GeometryPrimitive) * primitives.size());
+
+	const GeometryUpdate update = { blas, glm::uint32(firstPrimitive), 0, glm::uint32(primitives.size()), mModelGeometryCount[location], { 0, 0, 0 } };
+	const StreamingBuffer::Allocation updateUpload = mUploadBuffer->allocate(sizeof(GeometryUpdate));
+	std::memcpy(updateUpload.data, &update, sizeof(GeometryUpdate));
+
+	// The update program expects zeroed scratch memory
+	const size_t scratchSize = sizeof(glm::uint32) * geometryUpdateScratchSize(mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS);
+	const GLuint scratch = mBLASBuilder->reserveScratch(scratchSize);
+	glClearNamedBufferSubData(scratch, GL_R32UI, 0, scratchSize, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, mUploadBuffer->getBuffer(), geometryUpload.offset, geometryUpload.size);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, scratch);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 6, mUploadBuffer->getBuffer(), updateUpload.offset, updateUpload.size);
+
+	Program::use(*mRaytracerGeometryUpdate);
+
+	const glm::uint32 updateTiming = mGPUTimer->begin("Update Geometry");
+	glDispatchCompute(1, 1, 1);
+	mGPUTimer->end(updateTiming);
+
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// The uploaded data can be overwritten once the dispatch has completed
+	mUploadBuffer->fence();
+
+	// TLAS leaves of every instance must follow the new BLAS root
+	if (mBLASReferences[blas] > 1) {
+		for (GLuint instance = 0; instance < GLuint(mModelBLAS.size()); ++instance)
+			if (mModelBLAS[instance] == blas) markModelDirty(instance);
+	} else {
+		markModelDirty(location);
+	}
+}
+
+bool OpenGLPipeline::exportScene(const std::string& path) noexcept {
+	// The TLAS must hold the current placement of every model
+	update();
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	SceneFileWriter writer(path, getCapacity());
+
+	std::vector<glm::uint8> chunk;
+	for (const auto& section : getSceneFileBuffers()) {
+		GLint64 bufferSize = 0;
+		glGetNamedBufferParameteri64v(section.second, GL_BUFFER_SIZE, &bufferSize);
+
+		chunk.resize(std::min(size_t(bufferSize), sceneFileChunkSize));
+
+		writer.beginSection(section.first);
+		for (size_t offset = 0; offset < size_t(bufferSize); offset += chunk.size()) {
+			const size_t size = std::min(chunk.size(), size_t(bufferSize) - offset);
+
+			glGetNamedBufferSubData(section.second, GLintptr(offset), GLsizeiptr(size), chunk.data());
+			writer.write(chunk.data(), size);
+		}
+	}
+
+	writer.beginSection(SceneFileSection::ModelGeometryCount);
+	writer.write(mModelGeometryCount.data(), sizeof(glm::uint32) * mModelGeometryCount.size());
+
+	return writer.finish();
+}
+
+bool OpenGLPipeline::importScene(const SceneFile& scene) noexcept {
+	if (!scene.isValid()) return false;
+
+	// Programs are specialized for the capacity, and so is the layout of every buffer
+	const SceneCapacity capacity = scene.getCapacity();
+	if ((capacity.expOfTwo_maxModels != mRaytracerInfo.expOfTwo_numberOfModels) ||
+		(capacity.expOfTwo_maxCollectionsForModel != mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS) ||
+		(capacity.expOfTwo_maxGeometryOnCollection != mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection) ||
+		(capacity.expOfTwo_maxResidentModels != mExpOfTwo_numberOfResidentModels)) return false;
+
+	// Every section must fill its buffer exactly: check them all before touching the scene
+	const std::array<std::pair<SceneFileSection, GLuint>, 7> buffers = getSceneFileBuffers();
+	for (const auto& section : buffers) {
+		GLint64 bufferSize = 0;
+		glGetNamedBufferParameteri64v(section.second, GL_BUFFER_SIZE, &bufferSize);
+
+		size_t sectionSize = 0;
+		scene.getSection(section.first, sectionSize);
+		if (sectionSize != size_t(bufferSize)) return false;
+	}
+
+	size_t geometryCountSize = 0;
+	const void* geometryCount = scene.getSection(SceneFileSection::ModelGeometryCount, geometryCountSize);
+	if (geometryCountSize != (sizeof(glm::uint32) * mModelGeometryCount.size())) return false;
+
+	// BLASes are shared by instances: count the locations referring to each one
+	size_t residencySize = 0;
+	const ModelResidency* residency = reinterpret_cast<const ModelResidency*>(scene.getSection(SceneFileSection::ModelResidency, residencySize));
+	std::vector<glm::uint32> blasReferences(size_t(1) << mExpOfTwo_numberOfResidentModels, 0);
+	for (size_t location = 0; location < mModelBLAS.size(); ++location) {
+		const GLuint blas = residency[location].blas;
+		if (blas == nonResidentBLAS) continue;
+
+		if (blas >= blasReferences.size()) return false;
+		blasReferences[blas] += 1;
+	}
+
+	// Pending changes refer to the replaced scene
+	clearPendingUpdates();
+
+	// Shaders may still be writing the scene
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	for (const auto& section : buffers) {
+		size_t sectionSize = 0;
+		const glm::uint8* data = reinterpret_cast<const glm::uint8*>(scene.getSection(section.first, sectionSize));
+
+		for (size_t offset = 0; offset < sectionSize; offset += sceneFileChunkSize)
+			glNamedBufferSubData(section.second, GLintptr(offset), GLsizeiptr(std::min(sceneFileChunkSize, sectionSize - offset)), data + offset);
+	}
+
+	std::memcpy(mModelGeometryCount.data(), geometryCount, geometryCountSize);
+
+	mFreeBLASes.clear();
+	for (size_t blas = blasReferences.size(); blas > 0; --blas)
+		if (blasReferences[blas - 1] == 0) mFreeBLASes.push_back(GLuint(blas - 1));
+
+	mBLASReferences.swap(blasReferences);
+
+	for (size_t location = 0; location < mModelBLAS.size(); ++location)
+		mModelBLAS[location] = residency[location].blas;
+
+	invalidateAccumulation();
+
+	return true;
+}
+
+SceneCapacity OpenGLPipeline::getCapacity() const noexcept {
+	return SceneCapacity(mRaytracerInfo.expOfTwo_numberOfModels, mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS, mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection, mExpOfTwo_numberOfResidentModels);
+}
+
+std::array<std::pair<SceneFileSection, GLuint>, 7> OpenGLPipeline::getSceneFileBuffers() const noexcept {
+	return std::array<std::pair<SceneFileSection, GLuint>, 7>{ {
+		{ SceneFileSection::TLAS, mRaytracingTLAS },
+		{ SceneFileSection::BLASNodes, mRaytracingBLASCollection },
+		{ SceneFileSection::WideBLASNodes, mRaytracingWideBLASCollection },
+		{ SceneFileSection::Geometry, mRaytracingGeometryCollection },
+		{ SceneFileSection::ModelMatrices, mRaytracingModelMatrix },
+		{ SceneFileSection::BLASLinks, mRaytracingBLASLinks },
+		{ SceneFileSection::ModelResidency, mRaytracingModelResidency },
+	} };
+}
+
+size_t OpenGLPipeline::getFreeBLASCount() const noexcept {
+	return mFreeBLASes.size();
+}
+
+bool OpenGLPipeline::isModelResident(GLuint location) const noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+
+	return mModelBLAS[location] != nonResidentBLAS;
+}
+
+void OpenGLPipeline::placeModelProxy(GLuint location, const glm::vec3& boundsMin, const glm::vec3& boundsMax) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+	DBG_ASSERT( (mModelBLAS[location] == nonResidentBLAS) );
+
+	// Flags of the location are kept
+	const ModelResidency proxy = { boundsMin, nonResidentBLAS, boundsMax, 0 };
+	glNamedBufferSubData(mRaytracingModelResidency, sizeof(ModelResidency) * location, offsetof(ModelResidency, flags), &proxy);
+
+	// Flag the location as used/occupied, as the insertion of a model would (see BVH_INSERT on raytrace.comp)
+	const ModelMatrices identityMatrices = { glm::mat4(1), glm::mat4(1) };
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glNamedBufferSubData(mRaytracingModelMatrix, sizeof(ModelMatrices) * location, sizeof(ModelMatrices), &identityMatrices);
+
+	markModelDirty(location);
+}
+
+void OpenGLPipeline::evictModel(GLuint location) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+	DBG_ASSERT( (mModelBLAS[location] != nonResidentBLAS) );
+	if (mModelBLAS[location] == nonResidentBLAS) return;
+
+	// The proxy is the root of the BLAS: ModelResidency shares the layout of BVHNode, only the BLAS is replaced and flags are kept
+	const size_t blasNodesCount = (size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS + 1)) - 1;
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glCopyNamedBufferSubData(mRaytracingBLASCollection, mRaytracingModelResidency, GLintptr(sizeof(BVHNode) * blasNodesCount * mModelBLAS[location]), GLintptr(sizeof(ModelResidency) * location), offsetof(ModelResidency, flags));
+
+	releaseBLAS(location);
+	writeModelBLAS(location);
+
+	mModelGeometryCount[location] = 0;
+
+	markModelDirty(location);
+}
+
+void OpenGLPipeline::setResidencyFeedbackCollection(bool enabled) noexcept {
+	mResidencyFeedbackCollection = enabled;
+}
+
+bool OpenGLPipeline::pollResidencyFeedback(std::vector<glm::uint32>& modelHits) noexcept {
+	if (!mResidencyFeedbackFence) return false;
+
+	if (glClientWaitSync(mResidencyFeedbackFence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) return false;
+
+	glDeleteSync(mResidencyFeedbackFence);
+	mResidencyFeedbackFence = 0;
+
+	// The mapping is coherent: once the fence is signaled the copy is visible
+	modelHits.assign(mResidencyFeedbackMapping, mResidencyFeedbackMapping + mModelBLAS.size());
+
+	return true;
+}
+
+void OpenGLPipeline::acquireModelBLASes(std::vector<Model>& models, std::vector<GLuint>& blases) noexcept {
+	// Models that find no free BLAS are dropped: their location is left as it is
+	blases.clear();
+	blases.reserve(models.size());
+
+	auto residentEnd = models.begin();
+	for (auto& model : models) {
+		const GLuint blas = acquireBLAS(model.location);
+		DBG_ASSERT( (blas != nonResidentBLAS) );
+		if (blas == nonResidentBLAS) continue;
+
+		blases.push_back(blas);
+		if (&(*residentEnd) != &model) *residentEnd = std::move(model);
+		++residentEnd;
+	}
+	models.erase(residentEnd, models.end());
+}
+
+GLuint OpenGLPipeline::acquireBLAS(GLuint location) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+
+	// The model is about to be built on its BLAS: instances must keep the geometry they share
+	const GLuint blas = mModelBLAS[location];
+	if ((blas != nonResidentBLAS) && (mBLASReferences[blas] == 1)) return blas;
+
+	if (mFreeBLASes.empty()) return nonResidentBLAS;
+
+	releaseBLAS(location);
+
+	mModelBLAS[location] = mFreeBLASes.back();
+	mFreeBLASes.pop_back();
+	mBLASReferences[mModelBLAS[location]] = 1;
+
+	return mModelBLAS[location];
+}
+
+void OpenGLPipeline::releaseBLAS(GLuint location) noexcept {
+	const GLuint blas = mModelBLAS[location];
+	if (blas == nonResidentBLAS) return;
+
+	mModelBLAS[location] = nonResidentBLAS;
+
+	mBLASReferences[blas] -= 1;
+	if (mBLASReferences[blas] == 0) mFreeBLASes.push_back(blas);
+}
+
+void OpenGLPipeline::writeModelBLAS(GLuint location) noexcept {
+	glNamedBufferSubData(mRaytracingModelResidency, GLintptr((sizeof(ModelResidency) * location) + offsetof(ModelResidency, blas)), sizeof(GLuint), &mModelBLAS[location]);
+}
+
+void OpenGLPipeline::resetResidency() noexcept {
+	const size_t modelsCount = size_t(1) << mRaytracerInfo.expOfTwo_numberOfModels;
+	const size_t residentModelsCount = size_t(1) << mExpOfTwo_numberOfResidentModels;
+
+	mModelBLAS.assign(modelsCount, nonResidentBLAS);
+	mBLASReferences.assign(residentModelsCount, 0);
+
+	// BLASes are taken from the back: the first one goes first
+	mFreeBLASes.resize(residentModelsCount);
+	for (size_t blas = 0; blas < residentModelsCount; ++blas)
+		mFreeBLASes[blas] = GLuint(residentModelsCount - 1 - blas);
+
+	const std::vector<ModelResidency> emptyResidency(modelsCount, ModelResidency{ glm::vec3(0), nonResidentBLAS, glm::vec3(0), 0 });
+	glNamedBufferSubData(mRaytracingModelResidency, 0, sizeof(ModelResidency) * modelsCount, emptyResidency.data());
+}
+
+void OpenGLPipeline::readBackResidencyFeedback() noexcept {
+	if (mResidencyFeedbackFence) return;
+
+	// Hits keep being accounted from zero while the copy is read back
+	const GLsizeiptr feedbackSize = GLsizeiptr(sizeof(glm::uint32) * mModelBLAS.size());
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glCopyNamedBufferSubData(mResidencyFeedback, mResidencyFeedbackReadback, 0, 0, feedbackSize);
+	glClearNamedBufferData(mResidencyFeedback, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+	mResidencyFeedbackFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void OpenGLPipeline::setPersistentThreads(glm::uint32 workGroupsCount) noexcept {
+	mPersistentThreadsWorkGroups = workGroupsCount;
+}
+
+void OpenGLPipeline::setOutputFormat(OutputFormat format) noexcept {
+	if (format == mOutputFormat) return;
+
+	mOutputFormat = format;
+
+	// Images of the previous format cannot be reused, nor the samples they hold
+	if ((getWidth() != 0) && (getHeight() != 0)) createOutputTextures(getWidth(), getHeight());
+	invalidateAccumulation();
+}
+
+OutputFormat OpenGLPipeline::getOutputFormat() const noexcept {
+	return mOutputFormat;
+}
+
+void OpenGLPipeline::setTraversalStatisticsCollection(bool enabled) noexcept {
+	mTraversalStatisticsCollection = enabled;
+}
+
+TraversalStatistics OpenGLPipeline::getTraversalStatistics() const noexcept {
+	static_assert( (sizeof(TraversalStatistics) == (3 * sizeof(glm::uint32))), "TraversalStatistics not matching input GLSL");
+
+	// Make sure the render program has finished writing statistics
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	TraversalStatistics statistics;
+	glGetNamedBufferSubData(mTraversalStatistics, 0, sizeof(TraversalStatistics), &statistics);
+	return statistics;
+}
+
+RayQueryBatch OpenGLPipeline::castRays(const std::vector<RayQuery>& rays, RayQueryType type) noexcept {
+	static_assert( (sizeof(RayQuery) == 32), "RayQuery not matching input GLSL");
+	static_assert( (sizeof(RayQueryResult) == 32), "RayQueryResult not matching input GLSL");
+
+	// Rays see the scene as it would be rendered now
+	update();
+
+	const RayQueryBatch batch = mRayQueries->beginBatch(rays.size());
+
+	Program::use(*mRaytracerRayQuery);
+
+	mRaytracerRayQuery->setUniform(rayQueryTypeUniform, glm::uint(type));
+
+	// Each dispatch must fit in half of both ring buffers
+	const size_t maxDispatchRays = std::min(mRayQueries->getMaxAllocationRays(), ((mUploadBuffer->getSize() / 2) - mUploadBuffer->getAlignment()) / sizeof(RayQuery));
+
+	const glm::uint32 rayQueryTiming = mGPUTimer->begin("RayQuery");
+	for (size_t firstRay = 0; firstRay < rays.size(); firstRay += maxDispatchRays) {
+		const size_t raysCount = std::min(maxDispatchRays, rays.size() - firstRay);
+
+		const StreamingBuffer::Allocation raysUpload = mUploadBuffer->allocate(sizeof(RayQuery) * raysCount);
+		std::memcpy(raysUpload.data, rays.data() + firstRay, sizeof(RayQuery) * raysCount);
+
+		const RayQueryQueue::Allocation resultsRange = mRayQueries->allocate(batch, firstRay, raysCount);
+
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, mUploadBuffer->getBuffer(), raysUpload.offset, raysUpload.size);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 6, mRayQueries->getBuffer(), resultsRange.offset, resultsRange.size);
+
+		mRaytracerRayQuery->setUniform(rayQueriesCountUniform, glm::uint(raysCount));
+
+		const glm::uvec3 workGroupsCount = mRaytracerRayQuery->getComputeWorkGroupsCount(glm::uvec3(glm::uint32(raysCount), 1, 1));
+		glDispatchCompute(workGroupsCount.x, workGroupsCount.y, workGroupsCount.z);
+
+		// Results are read through the persistent mapping once the fence is signaled
+		glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+
+		mUploadBuffer->fence();
+		mRayQueries->fence();
+	}
+	mGPUTimer->end(rayQueryTiming);
+
+	return batch;
+}
+
+bool OpenGLPipeline::pollRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept {
+	return mRayQueries->poll(batch, results);
+}
+
+void OpenGLPipeline::waitRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept {
+	mRayQueries->wait(batch, results);
 }
 
 void OpenGLPipeline::onRender() noexcept {
-	// Clear the previously rendered scene
-	glClear(GL_COLOR_BUFFER_BIT);
+	// Account stages of previous frames the GPU has completed meanwhile
+	mGPUTimer->collect();
 
 	// Update the TLAS before rendering
 	update();
 
-	// Set the raytracer program as the active one
-	Program::use(*mRaytracerRender);
+	// A still image with every sample requested is presented as is
+	if (!isAccumulationComplete()) trace();
 
-	// Bind the raytracer render context as read-only!
-	glBindImageTexture(0, mRaytracingTLAS, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(1, mRaytracingBLASCollection, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(2, mRaytracingGeometryCollection, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(3, mRaytracingModelMatrix, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
+	present();
+}
 
-	// Bind the texture to be written by the raytracer
-	glBindImageTexture(5, mRaytracerOutputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+void OpenGLPipeline::present() noexcept {
+	if ((mOutputFormat == OutputFormat::RGBA8) || (mOutputFormat == OutputFormat::RGB10A2)) {
+		// The image is already tone mapped: copy it on the framebuffer the pipeline is rendering to
+		GLint drawFramebuffer = 0;
+		glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFramebuffer);
 
-	// Set rendering information
-	mRaytracerRender->setUniform("width", getWidth());
-	mRaytracerRender->setUniform("height", getHeight());
+		const glm::uint32 presentTiming = mGPUTimer->begin("Present");
+		glBlitNamedFramebuffer(mDisplayFramebuffer, GLuint(drawFramebuffer), 0, 0, GLint(getWidth()), GLint(getHeight()), 0, 0, GLint(getWidth()), GLint(getHeight()), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		mGPUTimer->end(presentTiming);
 
-	// Set camera parameters
-	mRaytracerRender->setUniform("cameraPosition", glm::vec3(0, 0, 0));
-	mRaytracerRender->setUniform("cameraViewDir", glm::vec3(0, 0, -1));
-	mRaytracerRender->setUniform("cameraUpVector", glm::vec3(0, 1, 0));
-	mRaytracerRender->setUniform("cameraFoV", glm::float32(60));
-	mRaytracerRender->setUniform("cameraAspect", glm::float32(getWidth()) / glm::float32(getHeight()));
+		return;
+	}
 
-	// Dispatch the compute work!
-	glDispatchCompute((GLuint)(getWidth()), (GLuint)(getHeight()), 1);
+	// Clear the previously rendered scene
+	glClear(GL_COLOR_BUFFER_BIT);
 
-	// make sure writing to image has finished before read
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
-	
 	// Switch to the tone mapper program
 	Program::use(*mDisplayWriter);
 
 	// Set parameters to obtain hdr
-	mDisplayWriter->setUniform("gamma", glm::float32(2.2));
-	mDisplayWriter->setUniform("exposure", glm::float32(0.1));
+	mDisplayWriter->setUniform(gammaUniform, toneMappingGamma);
+	mDisplayWriter->setUniform(exposureUniform, toneMappingExposure);
 
 	// Bind the texture generated by raytracing
 	glBindTextureUnit(5, mRaytracerOutputTexture);
 
 	// Draw the generated image while gamma-correcting it
+	const glm::uint32 tonemapTiming = mGPUTimer->begin("Tonemap");
 	glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+	mGPUTimer->end(tonemapTiming);
+}
+
+void OpenGLPipeline::trace() noexcept {
+	// Set the raytracer program as the active one
+	Program::use(*mRaytracerRender);
+
+	// Bind textures to be written by the raytracer: previous samples are read back to be averaged
+	switch (mOutputFormat) {
+	case OutputFormat::HDR32F:
+		glBindImageTexture(5, mRaytracerOutputTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+		break;
+	case OutputFormat::HDR16F:
+		glBindImageTexture(6, mRaytracerOutputTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+		break;
+	case OutputFormat::RGBA8:
+		glBindImageTexture(6, mRaytracerOutputTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+		glBindImageTexture(7, mDisplayTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+		break;
+	case OutputFormat::RGB10A2:
+		glBindImageTexture(6, mRaytracerOutputTexture, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA16F);
+		glBindImageTexture(4, mDisplayTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGB10_A2);
+		break;
+	}
+
+	RenderConstants constants;
+
+	// Set camera parameters
+	const Camera& camera = getCamera();
+	constants.cameraPosition = camera.position;
+	constants.cameraFoV = camera.fieldOfView;
+	constants.cameraViewDir = camera.viewDirection;
+	constants.cameraAspect = glm::float32(getWidth()) / glm::float32(getHeight());
+	constants.cameraUpVector = camera.up;
+
+	// Set rendering information
+	constants.width = getWidth();
+	constants.height = getHeight();
+	constants.persistentThreads = glm::uint32(mPersistentThreadsWorkGroups != 0);
+
+	// Set lighting parameters
+	constants.lightDirection = getLightDirection();
+	constants.shadingMode = glm::uint32(getShadingMode());
+
+	// Set accumulation parameters: a single sample for each image needs no memory of previous ones
+	constants.sampleJitter = getSampleJitter();
+	constants.accumulatedSamples = getAccumulatedSamples();
+	constants.keepAccumulation = glm::uint32(getMaxAccumulatedSamples() > 1);
+
+	// Set output parameters
+	constants.outputFormat = glm::uint32(mOutputFormat);
+	constants.gamma = toneMappingGamma;
+	constants.exposure = toneMappingExposure;
+
+	// Measure the traversal cost of this frame only
+	constants.collectTraversalStatistics = glm::uint32(mTraversalStatisticsCollection);
+
+	// Account models reached by camera rays, for the residency manager to page them
+	constants.collectResidencyFeedback = glm::uint32(mResidencyFeedbackCollection);
+
+	constants.padding = 0;
+
+	// Upload the constants of this frame at once: the ring keeps those of frames the GPU may still be rendering
+	const StreamingBuffer::Allocation constantsUpload = mRenderConstants->allocate(sizeof(RenderConstants));
+	std::memcpy(constantsUpload.data, &constants, sizeof(RenderConstants));
+	glBindBufferRange(GL_UNIFORM_BUFFER, renderConstantsBinding, mRenderConstants->getBuffer(), constantsUpload.offset, constantsUpload.size);
+
+	// Each work group renders a screen tile as large as the work group itself
+	const glm::uvec3 tilesCount = mRaytracerRender->getComputeWorkGroupsCount(glm::uvec3(getWidth(), getHeight(), 1));
+
+	if (mTraversalStatisticsCollection) {
+		const TraversalStatistics emptyStatistics = { 0, 0, 0 };
+		glNamedBufferSubData(mTraversalStatistics, 0, sizeof(TraversalStatistics), &emptyStatistics);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, mTraversalStatistics);
+	}
+
+	// Dispatch the compute work!
+	const glm::uint32 renderTiming = mGPUTimer->begin("Render");
+	if (mPersistentThreadsWorkGroups == 0) {
+		glDispatchCompute(tilesCount.x, tilesCount.y, 1);
+	} else {
+		// Restart tiles fetching from the very first one
+		const glm::uint32 firstTile = 0;
+		glNamedBufferSubData(mRenderTilesCounter, 0, sizeof(glm::uint32), &firstTile);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, mRenderTilesCounter);
+
+		glDispatchCompute(std::min(mPersistentThreadsWorkGroups, tilesCount.x * tilesCount.y), 1, 1);
+	}
+
+	mGPUTimer->end(renderTiming);
+
+	// The constants of this frame can be overwritten once it has been rendered
+	mRenderConstants->fence();
+
+	// make sure writing to image has finished before read (by the tone mapper or the blit, and by the next sample)
+	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+	if (mResidencyFeedbackCollection) readBackResidencyFeedback();
+
+	accountAccumulatedSample();
 }
 
 void OpenGLPipeline::onResize(glm::uint32 oldWidth, glm::uint32 oldHeight, glm::uint32 newWidth, glm::uint32 newHeight) noexcept {
 	glViewport(0, 0, newWidth, newHeight);
 
-	// Remove the previous texture to avoid GPU memory leak(s)
+	createOutputTextures(newWidth, newHeight);
+}
+
+void OpenGLPipeline::destroyOutputTextures() noexcept {
+	// Remove previous textures to avoid GPU memory leak(s)
 	if (mRaytracerOutputTexture)
 		glDeleteTextures(1, &mRaytracerOutputTexture);
 
+	if (mDisplayFramebuffer)
+		glDeleteFramebuffers(1, &mDisplayFramebuffer);
+
+	if (mDisplayTexture)
+		glDeleteTextures(1, &mDisplayTexture);
+
+	mRaytracerOutputTexture = mDisplayTexture = mDisplayFramebuffer = 0;
+}
+
+void OpenGLPipeline::createOutputTextures(glm::uint32 width, glm::uint32 height) noexcept {
+	destroyOutputTextures();
+
 	// Create a new 2D texture used to store the raw raytrace result (without gamma correction)
 	glCreateTextures(GL_TEXTURE_2D, 1, &mRaytracerOutputTexture);
 	glBindTexture(GL_TEXTURE_2D, mRaytracerOutputTexture);
-	glTextureStorage2D(mRaytracerOutputTexture, 1, GL_RGBA32F, newWidth, newHeight);
+	glTextureStorage2D(mRaytracerOutputTexture, 1, (mOutputFormat == OutputFormat::HDR32F) ? GL_RGBA32F : GL_RGBA16F, width, height);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_RED);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_GREEN);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_BLUE);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_A, GL_ALPHA);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+
+	if ((mOutputFormat != OutputFormat::RGBA8) && (mOutputFormat != OutputFormat::RGB10A2)) return;
+
+	// Create the tone mapped image and the framebuffer it is presented from
+	glCreateTextures(GL_TEXTURE_2D, 1, &mDisplayTexture);
+	glTextureStorage2D(mDisplayTexture, 1, (mOutputFormat == OutputFormat::RGBA8) ? GL_RGBA8 : GL_RGB10_A2, width, height);
+
+	glCreateFramebuffers(1, &mDisplayFramebuffer);
+	glNamedFramebufferTexture(mDisplayFramebuffer, GL_COLOR_ATTACHMENT0, mDisplayTexture, 0);
+	glNamedFramebufferReadBuffer(mDisplayFramebuffer, GL_COLOR_ATTACHMENT0);
+
+	DBG_ASSERT( (glCheckNamedFramebufferStatus(mDisplayFramebuffer, GL_READ_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE) );
 }
 
 void OpenGLPipeline::flush() noexcept {
 	Program::use(*mRaytracerFlush);
 
-	// Bind the raytracer ModelMatrix as write-only as the shader will only nuke it
-	glBindImageTexture(3, mRaytracingModelMatrix, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
-
-	// The TLAS may get updated to the root after a leaf deletion
-	glBindImageTexture(0, mRaytracingTLAS, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-
-	glDispatchCompute(size_t(1) << mRaytracerInfo.expOfTwo_numberOfModels, 1, 1);
+	const glm::uvec3 workGroupsCount = mRaytracerFlush->getComputeWorkGroupsCount(glm::uvec3(glm::uint32(1) << mRaytracerInfo.expOfTwo_numberOfModels, 1, 1));
+	const glm::uint32 flushTiming = mGPUTimer->begin("Flush");
+	glDispatchCompute(workGroupsCount.x, workGroupsCount.y, workGroupsCount.z);
+	mGPUTimer->end(flushTiming);
 
 	// synchronize with the GPU
 	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	// The flush has emptied the whole TLAS: there is nothing left to move or refit
+	clearPendingUpdates();
+
+	std::fill(mModelGeometryCount.begin(), mModelGeometryCount.end(), 0);
+
+	resetResidency();
 }
 
 void OpenGLPipeline::enqueueModel(std::vector<GeometryPrimitive>&& primitivesCollection, GLuint targetBLAS) noexcept {
-	DBG_ASSERT( (targetBLAS < (1 << mRaytracerInfo.expOfTwo_numberOfModels)) );
+	std::vector<Model> models;
+	models.push_back(Model{ std::move(primitivesCollection), targetBLAS });
 
-	static_assert( (sizeof(GeometryPrimitive) == sizeof(glm::vec4) ), "Geometry type not matching input GLSL");
-	
-	// When creating the SSBO used to write geometry on the GPU the primitivesCollection vector will be read sequentially for the entire SSBO length, so make sure that won't generate a SEGFAULT!
-	primitivesCollection.reserve((size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection) * (size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS));
+	enqueueModels(std::move(models));
+}
 
-	// Prepare the tomporary input geometry SSBO
-	GLuint temporaryInputGeometry;
-	glCreateBuffers(1, &temporaryInputGeometry);
-	glNamedBufferStorage(temporaryInputGeometry, sizeof(glm::vec4) * (size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS) * size_t(size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection), primitivesCollection.data(), 0);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, temporaryInputGeometry);
+void OpenGLPipeline::enqueueModels(std::vector<Model>&& models) noexcept {
+	std::vector<GLuint> blases;
+	acquireModelBLASes(models, blases);
 
-	Program::use(*mRaytracerInsert);
+	mBLASBuilder->build(*mUploadBuffer, models.cbegin(), models.cend(), blases.cbegin(), mGPUTimer.get());
 
-	mRaytracerInsert->setUniform("targetBLAS", targetBLAS);
+	for (const auto& model : models) {
+		// The TLAS leaf must follow the new BLAS
+		writeModelBLAS(model.location);
+		markModelDirty(model.location);
+		mModelGeometryCount[model.location] = glm::uint32(model.primitives.size());
+	}
+}
 
-	glBindImageTexture(0, mRaytracingTLAS, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(1, mRaytracingBLASCollection, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(2, mRaytracingGeometryCollection, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(3, mRaytracingModelMatrix, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-	
-	glDispatchCompute(size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection, size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS, 1);
+void OpenGLPipeline::enqueueStaticModels(std::vector<Model>&& models) noexcept {
+	std::vector<GLuint> blases;
+	acquireModelBLASes(models, blases);
+
+	if (!mSAHBuilder) mSAHBuilder.reset(new SAHBuilder(getCapacity()));
+
+	const glm::uint64 buildBegin = FrameProfiler::now();
+
+	std::vector<BuiltBLAS> builtBLASes;
+	mSAHBuilder->build(models.cbegin(), models.cend(), builtBLASes);
+
+	// Other stages are GL_TIMESTAMP intervals: the build is moved on the GPU clock, so that traces keep a single timeline
+	const glm::uint64 buildNanoseconds = FrameProfiler::now() - buildBegin;
+	GLint64 gpuBuildEnd = 0;
+	glGetInteger64v(GL_TIMESTAMP, &gpuBuildEnd);
+	getProfiler().record("SAH Build", glm::uint64(gpuBuildEnd) - buildNanoseconds, glm::uint64(gpuBuildEnd));
+
+	const size_t nodesOnBLAS = (size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS + 1)) - 1;
+	const size_t wideNodesOnBLAS = size_t(1) << mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS;
+	const size_t geometryOnBLAS = size_t(1) << (mRaytracerInfo.expOfTwo_numberOfGeometryCollectionOnBLAS + mRaytracerInfo.expOfTwo_numberOfGeometryOnCollection);
+	const ModelMatrices identityMatrices = { glm::mat4(1), glm::mat4(1) };
+
+	// Shaders may still be reading BLASes being replaced
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	for (size_t i = 0; i < models.size(); ++i) {
+		const BuiltBLAS& built = builtBLASes[i];
+		const GLuint location = models[i].location;
+		const size_t blas = blases[i];
+
+		// Buffers are written with the layout BVH_INSERT leaves behind (see raytrace.comp): links are positions first, then parents
+		glNamedBufferSubData(mRaytracingBLASCollection, GLintptr(sizeof(BVHNode) * nodesOnBLAS * blas), GLsizeiptr(sizeof(BVHNode) * built.nodes.size()), built.nodes.data());
+		glNamedBufferSubData(mRaytracingWideBLASCollection, GLintptr(sizeof(WideBVHNode) * wideNodesOnBLAS * blas), GLsizeiptr(sizeof(WideBVHNode) * built.wideNodes.size()), built.wideNodes.data());
+
+		const size_t linksOffset = (geometryOnBLAS + nodesOnBLAS) * blas;
+		if (!built.geometry.empty()) {
+			glNamedBufferSubData(mRaytracingGeometryCollection, GLintptr(sizeof(glm::vec4) * geometryOnBLAS * blas), GLsizeiptr(sizeof(glm::vec4) * built.geometry.size()), built.geometry.data());
+			glNamedBufferSubData(mRaytracingBLASLinks, GLintptr(sizeof(glm::uint32) * linksOffset), GLsizeiptr(sizeof(glm::uint32) * built.positions.size()), built.positions.data());
+		}
+		glNamedBufferSubData(mRaytracingBLASLinks, GLintptr(sizeof(glm::uint32) * (linksOffset + geometryOnBLAS)), GLsizeiptr(sizeof(glm::uint32) * built.parents.size()), built.parents.data());
+
+		// Flag the location as used/occupied, as the insertion of a model would
+		glNamedBufferSubData(mRaytracingModelMatrix, sizeof(ModelMatrices) * location, sizeof(ModelMatrices), &identityMatrices);
+
+		// The TLAS leaf must follow the new BLAS
+		writeModelBLAS(location);
+		markModelDirty(location);
+		mModelGeometryCount[location] = glm::uint32(built.geometry.size());
+	}
+}
+
+void OpenGLPipeline::enqueueInstance(GLuint sourceLocation, GLuint location) noexcept {
+	enqueueInstances(std::vector<ModelInstance>{ ModelInstance{ sourceLocation, location } });
+}
+
+void OpenGLPipeline::enqueueInstances(const std::vector<ModelInstance>& instances) noexcept {
+	const ModelMatrices identityMatrices = { glm::mat4(1), glm::mat4(1) };
+
+	// Shaders may still be reading matrices
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+
+	for (const auto& instance : instances) {
+		DBG_ASSERT( (instance.source < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+		DBG_ASSERT( (instance.location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
 
-	// synchronize with the GPU: the insert procedure writes to texture (BLAS) and to the ModelMatrix SSBO.
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		// Only a resident model has a BLAS to be shared
+		const GLuint blas = mModelBLAS[instance.source];
+		DBG_ASSERT( (blas != nonResidentBLAS) );
+		if (blas == nonResidentBLAS) continue;
 
-	glDeleteBuffers(1, &temporaryInputGeometry);
+		if (mModelBLAS[instance.location] != blas) {
+			releaseBLAS(instance.location);
+
+			mModelBLAS[instance.location] = blas;
+			mBLASReferences[blas] += 1;
+		}
+		writeModelBLAS(instance.location);
+
+		// Flag the location as used/occupied, as the insertion of a model would (see BVH_INSERT on raytrace.comp)
+		glNamedBufferSubData(mRaytracingModelMatrix, sizeof(ModelMatrices) * instance.location, sizeof(ModelMatrices), &identityMatrices);
+
+		mModelGeometryCount[instance.location] = mModelGeometryCount[instance.source];
+
+		markModelDirty(instance.location);
+	}
+}
+
+void OpenGLPipeline::setModelFlags(GLuint location, glm::uint32 flags) noexcept {
+	DBG_ASSERT( (location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+	DBG_ASSERT( ((flags & (~(instanceFlagHidden | instanceFlagNoShadows))) == 0) );
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glNamedBufferSubData(mRaytracingModelResidency, GLintptr((sizeof(ModelResidency) * location) + offsetof(ModelResidency, flags)), sizeof(glm::uint32), &flags);
+
+	// The TLAS leaf holds flags for traversal
+	markModelDirty(location);
+}
+
+void OpenGLPipeline::setModelTransform(GLuint location, const glm::mat4& transform) noexcept {
+	setModelTransforms(std::vector<ModelTransform>{ ModelTransform{ location, transform } });
+}
+
+void OpenGLPipeline::setModelTransforms(const std::vector<ModelTransform>& transforms) noexcept {
+	for (const auto& modelTransform : transforms) {
+		DBG_ASSERT( (modelTransform.location < (GLuint(1) << mRaytracerInfo.expOfTwo_numberOfModels)) );
+
+		TransformUpdate update;
+		update.matrices.model = modelTransform.transform;
+		update.matrices.inverseModel = glm::inverse(modelTransform.transform);
+		update.location = modelTransform.location;
+		update.padding[0] = update.padding[1] = update.padding[2] = 0;
+
+		// The last transformation of a model replaces the pending one
+		glm::uint32& pendingIndex = mPendingTransformIndex[modelTransform.location];
+		if (pendingIndex == noPendingTransform) {
+			pendingIndex = glm::uint32(mPendingTransforms.size());
+			mPendingTransforms.push_back(update);
+		} else {
+			mPendingTransforms[pendingIndex] = update;
+		}
+
+		markModelDirty(modelTransform.location);
+	}
+}
+
+void OpenGLPipeline::bindSceneBuffers() const noexcept {
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mRaytracingTLAS);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mRaytracingBLASCollection);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, mRaytracingGeometryCollection);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, mRaytracingModelMatrix);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, mRaytracingWideBLASCollection);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, blasLinksBinding, mRaytracingBLASLinks);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, modelResidencyBinding, mRaytracingModelResidency);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, residencyFeedbackBinding, mResidencyFeedback);
+}
+
+void OpenGLPipeline::commitStreamedModels(const std::vector<std::pair<GLuint, glm::uint32>>& models) noexcept {
+	// BLASes written by another context are only guaranteed to be seen once buffers are bound again
+	bindSceneBuffers();
+
+	for (const auto& model : models) {
+		// The BLAS has been acquired when the model has been enqueued
+		writeModelBLAS(model.first);
+		markModelDirty(model.first);
+		mModelGeometryCount[model.first] = model.second;
+	}
+}
+
+void OpenGLPipeline::markModelDirty(GLuint location) noexcept {
+	// The scene is about to change
+	invalidateAccumulation();
+
+	if (mModelDirtyFlags[location]) return;
+
+	mModelDirtyFlags[location] = true;
+	mDirtyModels.push_back(location);
+}
+
+void OpenGLPipeline::clearPendingUpdates() noexcept {
+	for (const auto& pendingTransform : mPendingTransforms)
+		mPendingTransformIndex[pendingTransform.location] = noPendingTransform;
+	mPendingTransforms.clear();
+
+	for (const auto location : mDirtyModels)
+		mModelDirtyFlags[location] = false;
+	mDirtyModels.clear();
 }
 
 void OpenGLPipeline::update() noexcept {
+	if (mDirtyModels.empty()) return;
+
+	// Schedule dirty leaves and their ancestors one level at a time, from the leaves to the root (see tlasRefitSchedule on raytrace.comp)
+	const glm::uint32 levelsCount = mRaytracerInfo.expOfTwo_numberOfModels + 1;
+	std::vector<glm::uint32> refitSchedule(levelsCount + 1, 0);
+
+	std::vector<glm::uint32> levelNodes;
+	levelNodes.reserve(mDirtyModels.size());
+	for (const auto location : mDirtyModels)
+		levelNodes.push_back(((glm::uint32(1) << mRaytracerInfo.expOfTwo_numberOfModels) - 1) + location);
+	std::sort(levelNodes.begin(), levelNodes.end());
+
+	for (glm::uint32 level = 0; level < levelsCount; ++level) {
+		refitSchedule[level] = glm::uint32(refitSchedule.size() - (levelsCount + 1));
+		refitSchedule.insert(refitSchedule.end(), levelNodes.cbegin(), levelNodes.cend());
+
+		// Parents of sorted nodes are sorted too, so duplicates are adjacent
+		for (auto& node : levelNodes)
+			node = (node - 1) / 2;
+		levelNodes.erase(std::unique(levelNodes.begin(), levelNodes.end()), levelNodes.end());
+	}
+	refitSchedule[levelsCount] = glm::uint32(refitSchedule.size() - (levelsCount + 1));
+
+	// Upload the schedule and the new transformations
+	const StreamingBuffer::Allocation scheduleUpload = mUploadBuffer->allocate(sizeof(glm::uint32) * refitSchedule.size());
+	std::memcpy(scheduleUpload.data, refitSchedule.data(), sizeof(glm::uint32) * refitSchedule.size());
+
+	const StreamingBuffer::Allocation transformsUpload = mUploadBuffer->allocate(sizeof(TransformUpdate) * std::max<size_t>(mPendingTransforms.size(), 1));
+	if (!mPendingTransforms.empty())
+		std::memcpy(transformsUpload.data, mPendingTransforms.data(), sizeof(TransformUpdate) * mPendingTransforms.size());
+
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 4, mUploadBuffer->getBuffer(), scheduleUpload.offset, scheduleUpload.size);
+	glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 6, mUploadBuffer->getBuffer(), transformsUpload.offset, transformsUpload.size);
+
 	Program::use(*mRaytracerUpdate);
 
-	glBindImageTexture(0, mRaytracingTLAS, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
-	glBindImageTexture(1, mRaytracingBLASCollection, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(2, mRaytracingGeometryCollection, 0, GL_FALSE, 0, GL_READ_ONLY, GL_RGBA32F);
-	glBindImageTexture(3, mRaytracingModelMatrix, 0, GL_FALSE, 0, GL_READ_WRITE, GL_RGBA32F);
+	mRaytracerUpdate->setUniform(transformUpdatesCountUniform, glm::uint(mPendingTransforms.size()));
+
+	// The whole schedule is consumed by a single work group
+	const glm::uint32 updateTiming = mGPUTimer->begin("Update");
+	glDispatchCompute(1, 1, 1);
+	mGPUTimer->end(updateTiming);
+
+	// synchronize with the GPU: the update procedure writes to the TLAS and ModelMatrix SSBOs
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-	glDispatchCompute(size_t(1) << mRaytracerInfo.expOfTwo_numberOfModels, 1, 1);
+	mUploadBuffer->fence();
 
-	// synchronize with the GPU: the update procedure only write to texture (TLAS)
-	glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+	// Everything is up to date
+	clearPendingUpdates();
 }
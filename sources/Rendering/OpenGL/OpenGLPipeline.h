@@ -3,14 +3,49 @@
 #include "Rendering/RenderingPipeline.h"
 
 #include "Rendering/OpenGL/Pipeline/Program.h"
+#include "Rendering/OpenGL/StreamingBuffer.h"
+#include "Rendering/OpenGL/GPUTimer.h"
+#include "Rendering/OpenGL/RayQueryQueue.h"
+#include "Rendering/OpenGL/StorageLayout.h"
+#include "Rendering/OpenGL/SceneFile.h"
+#include "Rendering/OpenGL/BLASBuilder.h"
+#include "Rendering/OpenGL/SAHBuilder.h"
 
 namespace Tachyon {
 	namespace Rendering {
 		namespace OpenGL {
 
+			/**
+			 * This is the image the raytracer writes: values MUST match OUTPUT_* in raytrace.comp.
+			 */
+			enum class OutputFormat : glm::uint32 {
+				/**
+				 * The linear image is stored as RGBA32F and tone mapped by a full-screen draw.
+				 */
+				HDR32F = 0,
+
+				/**
+				 * The linear image is stored as RGBA16F and tone mapped by a full-screen draw:
+				 * this is for HDR output to be kept at half the memory traffic.
+				 */
+				HDR16F = 1,
+
+				/**
+				 * The render program tone maps each pixel and writes it as RGBA8, the image is then blitted on the framebuffer.
+				 */
+				RGBA8 = 2,
+
+				/**
+				 * As RGBA8, with 10 bits for each color channel.
+				 */
+				RGB10A2 = 3,
+			};
+
 			class OpenGLPipeline :
 				virtual public Rendering::RenderingPipeline {
 
+				friend class SceneStreamer;
+
 			public:
 				OpenGLPipeline(const OpenGLPipeline&) = delete;
 
@@ -20,61 +55,489 @@ namespace Tachyon {
 
 				~OpenGLPipeline() override;
 
-				OpenGLPipeline() noexcept;
+				/**
+				 * Create the OpenGL raytracer.
+				 *
+				 * GPU memory used to store the scene is allocated upfront, accordingly to the given capacity.
+				 *
+				 * @param capacity the maximum size of the scene
+				 */
+				OpenGLPipeline(const SceneCapacity& capacity = SceneCapacity()) noexcept;
 
 				void enqueueModel(std::vector<GeometryPrimitive>&& primitive, GLuint location) noexcept override;
-				
-				void reset() noexcept override;
+
+				/**
+				 * Place many models on the scene: models are uploaded through a persistently mapped ring buffer
+				 * and each batch of models that fits in it is built by the same dispatches.
+				 *
+				 * @param models the models to be placed
+				 */
+				void enqueueModels(std::vector<Model>&& models) noexcept override;
+
+				/**
+				 * Place many static models on the scene: BLASes are built on the CPU with a surface area heuristic
+				 * (see SAHBuilder) and uploaded as they are, which takes longer than enqueueModels but gives BLASes
+				 * that do not depend on the order geometry is given in.
+				 *
+				 * Models placed this way can be removed, updated, moved and instanced as any other model.
+				 *
+				 * @param models the models to be placed
+				 */
+				void enqueueStaticModels(std::vector<Model>&& models) noexcept;
+
+				void enqueueInstance(GLuint sourceLocation, GLuint location) noexcept override;
+
+				/**
+				 * Place many instances on the scene: nothing is built, each location is only pointed at the BLAS of its source.
+				 *
+				 * @param instances the instances to be placed
+				 */
+				void enqueueInstances(const std::vector<ModelInstance>& instances) noexcept override;
+
+				/**
+				 * Set the flags of a location (see instanceFlagHidden and instanceFlagNoShadows): flags are applied on the next update
+				 * and kept until the location is emptied, whatever model is placed on it meanwhile.
+				 *
+				 * @param location the location of the model
+				 * @param flags the instanceFlag* flags of the location, 0 to clear them
+				 */
+				void setModelFlags(GLuint location, glm::uint32 flags) noexcept;
+
+				void setModelTransform(GLuint location, const glm::mat4& transform) noexcept override;
+
+				void setModelTransforms(const std::vector<ModelTransform>& transforms) noexcept override;
+
+				/**
+				 * Enable or disable the persistent threads rendering mode.
+				 *
+				 * When enabled a fixed number of work groups is dispatched and each one keeps fetching
+				 * screen tiles from a global counter until the whole frame has been rendered:
+				 * expensive tiles are balanced across work groups instead of leaving the GPU idle.
+				 *
+				 * @param workGroupsCount the number of work groups to be dispatched, 0 disables the persistent threads mode
+				 */
+				void setPersistentThreads(glm::uint32 workGroupsCount) noexcept;
+
+				void setTraversalStatisticsCollection(bool enabled) noexcept override;
+
+				TraversalStatistics getTraversalStatistics() const noexcept override;
+
+				/**
+				 * Choose the image written by the raytracer, the default is OutputFormat::RGBA8.
+				 *
+				 * Tone mapped formats avoid writing and reading back a full resolution floating point image each frame:
+				 * a half float image is only kept while samples are being accumulated.
+				 *
+				 * @param format the output format
+				 */
+				void setOutputFormat(OutputFormat format) noexcept;
+
+				OutputFormat getOutputFormat() const noexcept;
+
+				/**
+				 * Cast rays with a dedicated dispatch: results are written on a persistently mapped buffer
+				 * and copied back as soon as the GPU signals they are ready, without ever stalling the caller.
+				 *
+				 * @param rays the rays to be cast
+				 * @param type what is to be found for each ray
+				 * @return the batch to retrieve results of
+				 */
+				RayQueryBatch castRays(const std::vector<RayQuery>& rays, RayQueryType type = RayQueryType::ClosestHit) noexcept override;
+
+				bool pollRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept override;
+
+				void waitRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept override;
+
+				/**
+				 * Write the scene as it would be rendered now (pending transformations are applied first) to a scene file:
+				 * GPU buffers holding the scene are read back and stored as they are, BVHs included.
+				 *
+				 * @param path the scene file to be written
+				 * @return TRUE on success
+				 */
+				bool exportScene(const std::string& path) noexcept;
+
+				/**
+				 * Replace the whole scene with the one of a scene file: sections are uploaded straight from
+				 * the file mapping, without parsing or building anything.
+				 *
+				 * Note: models of the loaded scene are addressed by location, as if placed with enqueueModel.
+				 *
+				 * @param scene the scene file, exported from a pipeline with the same capacity
+				 * @return FALSE if the file is not valid or it does not match the pipeline capacity (the scene is left untouched)
+				 */
+				bool importScene(const SceneFile& scene) noexcept;
+
+				/**
+				 * Get the capacity the pipeline has been created with.
+				 *
+				 * @return the scene capacity
+				 */
+				SceneCapacity getCapacity() const noexcept;
+
+				/**
+				 * Get the number of BLASes not storing any model: a model can only be enqueued while there is one
+				 * (or on a location whose model is resident and not instanced, as its BLAS is reused).
+				 *
+				 * @return the number of free BLASes
+				 */
+				size_t getFreeBLASCount() const noexcept;
+
+				/**
+				 * Check if the model on the given location is resident: its BLAS is in memory and rays can hit it.
+				 *
+				 * @param location the location of the model
+				 * @return TRUE iif a BLAS stores the model
+				 */
+				bool isModelResident(GLuint location) const noexcept;
+
+				/**
+				 * Place the proxy of a model that is not resident on an empty location: the proxy is never hit,
+				 * rays crossing it only account its model on the residency feedback, so that it can be enqueued once it is needed.
+				 *
+				 * The proxy is placed with the identity (as an enqueued model) and it can be moved from then on.
+				 *
+				 * @param location the empty location of the model
+				 * @param boundsMin the minimum vertex of the AABB of the model, in model space
+				 * @param boundsMax the maximum vertex of the AABB of the model, in model space
+				 */
+				void placeModelProxy(GLuint location, const glm::vec3& boundsMin, const glm::vec3& boundsMax) noexcept;
+
+				/**
+				 * Free the BLAS of a resident model for another one: the model keeps its location and its transformation
+				 * and, until it is enqueued again, it is a proxy as large as the root of the freed BLAS (see placeModelProxy).
+				 *
+				 * Note: the BLAS of an instanced model is only freed once every instance has been evicted (or removed).
+				 *
+				 * @param location the location of the resident model
+				 */
+				void evictModel(GLuint location) noexcept;
+
+				/**
+				 * Enable or disable the residency feedback: when enabled every rendered frame accounts, for each location,
+				 * closest hits on its model if it is resident or camera rays crossing its proxy if it is not.
+				 *
+				 * @param enabled TRUE to collect the feedback
+				 */
+				void setResidencyFeedbackCollection(bool enabled) noexcept;
+
+				/**
+				 * Get the residency feedback accounted by frames the GPU has completed, without ever waiting:
+				 * frames rendered meanwhile keep accounting on the next feedback, so no frame is ever missed.
+				 *
+				 * @param modelHits for each location the number of rays that have reached its model since the previous feedback
+				 * @return FALSE if no new feedback is available (modelHits is left untouched)
+				 */
+				bool pollResidencyFeedback(std::vector<glm::uint32>& modelHits) noexcept;
 
 			protected:
 				void onResize(glm::uint32 oldWidth, glm::uint32 oldHeight, glm::uint32 newWidth, glm::uint32 newHeight) noexcept;
 
 				void onRender() noexcept final;
 
-			private:
-				void insert(GLuint targetBLAS) noexcept;
+				void onRemoveModel(GLuint location) noexcept override;
 
+				/**
+				 * Upload the new geometry and refit the BLAS with a single dispatch of the geometry update program.
+				 *
+				 * @param location the location of the model
+				 * @param firstPrimitive the index of the first primitive to be replaced
+				 * @param primitives the new primitives
+				 */
+				void onUpdateModelPrimitives(GLuint location, size_t firstPrimitive, const std::vector<GeometryPrimitive>& primitives) noexcept override;
+
+				void onReset() noexcept override;
+
+			private:
 				void flush() noexcept;
 
+				/**
+				 * Get the GPU buffer stored on each section of a scene file (but SceneFileSection::ModelGeometryCount).
+				 *
+				 * @return sections and their buffers, in the order they are written
+				 */
+				std::array<std::pair<SceneFileSection, GLuint>, 7> getSceneFileBuffers() const noexcept;
+
+				/**
+				 * Get the BLAS a model is built on: the one already storing the model of the location, unless instances share it, or a free one.
+				 *
+				 * Note: the TLAS only picks up the BLAS of a location once it has been written with writeModelBLAS.
+				 *
+				 * @param location the location of the model
+				 * @return the BLAS of the model, nonResidentBLAS if every BLAS is taken (the location is left as it is)
+				 */
+				GLuint acquireBLAS(GLuint location) noexcept;
+
+				/**
+				 * Acquire the BLAS of each given model (see acquireBLAS), dropping models that find none.
+				 *
+				 * @param models the models to be built: those left are in the order they have been given
+				 * @param blases the BLAS of each model left, in the order of models
+				 */
+				void acquireModelBLASes(std::vector<Model>& models, std::vector<GLuint>& blases) noexcept;
+
+				/**
+				 * Let the BLAS of a location, if any, go: it is given back to the free ones once no location refers to it.
+				 *
+				 * @param location the location of the model
+				 */
+				void releaseBLAS(GLuint location) noexcept;
+
+				/**
+				 * Write the BLAS of a location on its residency, for the TLAS update to pick it up.
+				 *
+				 * @param location the location of the model
+				 */
+				void writeModelBLAS(GLuint location) noexcept;
+
+				/**
+				 * Free every BLAS and empty the residency of every location.
+				 */
+				void resetResidency() noexcept;
+
+				/**
+				 * Copy the residency feedback accounted so far on the readback buffer and start accounting from zero,
+				 * unless the previous copy has not been polled yet.
+				 */
+				void readBackResidencyFeedback() noexcept;
+
+				/**
+				 * Bind buffers holding the scene on the current context, as every raytracing program expects them.
+				 */
+				void bindSceneBuffers() const noexcept;
+
+				/**
+				 * Let the TLAS pick up models whose BLAS has been built on another context (see SceneStreamer):
+				 * builds MUST have completed on the GPU.
+				 *
+				 * @param models the location and the number of geometry primitives of each model
+				 */
+				void commitStreamedModels(const std::vector<std::pair<GLuint, glm::uint32>>& models) noexcept;
+
+				/**
+				 * Apply pending transformations and refit the TLAS where models have changed.
+				 *
+				 * Nothing is dispatched when no model has changed since the last update.
+				 */
 				void update() noexcept;
 
+				/**
+				 * Raytrace a new sample of every pixel and average it with those accumulated on the output texture.
+				 */
+				void trace() noexcept;
+
+				/**
+				 * Draw the traced image on the bound framebuffer, tone mapping it if needed.
+				 */
+				void present() noexcept;
+
+				/**
+				 * Create the images written by the render program, as required by the output format.
+				 *
+				 * @param width the width of the frame
+				 * @param height the height of the frame
+				 */
+				void createOutputTextures(glm::uint32 width, glm::uint32 height) noexcept;
+
+				void destroyOutputTextures() noexcept;
+
+				/**
+				 * Schedule the refit of the TLAS leaf of the given model (and of its ancestors) on the next update.
+				 *
+				 * @param location the model that has changed
+				 */
+				void markModelDirty(GLuint location) noexcept;
+
+				/**
+				 * Forget every pending transformation and dirty model.
+				 */
+				void clearPendingUpdates() noexcept;
+
 			private:
 				std::unique_ptr<Pipeline::Program> mRaytracerQueryInfo;
 
 				std::unique_ptr<Pipeline::Program> mRaytracerFlush;
 
-				std::unique_ptr<Pipeline::Program> mRaytracerInsert;
+				std::unique_ptr<BLASBuilder> mBLASBuilder;
+
+				/**
+				 * This is only created by the first call to enqueueStaticModels, as it spawns its own workers.
+				 */
+				std::unique_ptr<SAHBuilder> mSAHBuilder;
+
+				std::unique_ptr<Pipeline::Program> mRaytracerGeometryUpdate;
 
 				std::unique_ptr<Pipeline::Program> mRaytracerUpdate;
 
 				std::unique_ptr<Pipeline::Program> mRaytracerRender;
 
+				std::unique_ptr<Pipeline::Program> mRaytracerRayQuery;
+
 				std::unique_ptr<Pipeline::Program> mDisplayWriter;
 
 				struct RaytracerInfo {
 					glm::uint32 expOfTwo_numberOfModels;
 					glm::uint32 expOfTwo_numberOfGeometryCollectionOnBLAS;
 					glm::uint32 expOfTwo_numberOfGeometryOnCollection;
-
-					// Geometry is stored as consecutive vec4 in a texture, on the x axis.
-					glm::uint32 oxpOfTwo_numberOfTesselsForGeometryTexturazation; // This number is the number of texture texels used to store the texture
 				} mRaytracerInfo ;
 
+				/**
+				 * The number of BLASes, as an exponent of two: shaders never need it, as BLASes are found from the TLAS.
+				 */
+				glm::uint32 mExpOfTwo_numberOfResidentModels;
+
+				/**
+				 * This is the SSBO holding the TLAS nodes (as BVHNode).
+				 */
 				GLuint mRaytracingTLAS;
 
+				/**
+				 * This is the SSBO holding nodes (as BVHNode) of every BLAS, one fixed-size tree after the other.
+				 */
 				GLuint mRaytracingBLASCollection;
 
+				/**
+				 * This is the SSBO holding wide nodes (as WideBVHNode) every BLAS is collapsed to, one fixed-size tree after the other:
+				 * rays traverse these instead of the binary ones.
+				 */
+				GLuint mRaytracingWideBLASCollection;
+
+				/**
+				 * This is the SSBO holding spheres (as vec4) of every BLAS, one fixed-size collection after the other.
+				 */
 				GLuint mRaytracingGeometryCollection;
 
+				/**
+				 * This is the SSBO holding the transformation of the model on every location (as ModelMatrices).
+				 */
 				GLuint mRaytracingModelMatrix;
 
+				/**
+				 * This is the SSBO holding where the model on every location is stored (as ModelResidency).
+				 */
+				GLuint mRaytracingModelResidency;
+
+				/**
+				 * This is the SSBO holding, for every BLAS, where each geometry has been moved by the builder and the parent of each node:
+				 * what the geometry update program needs to refit a BLAS after it has been built.
+				 */
+				GLuint mRaytracingBLASLinks;
+
+				/**
+				 * The number of geometry primitives of the model on each location, 0 on empty locations.
+				 */
+				std::vector<glm::uint32> mModelGeometryCount;
+
+				/**
+				 * The BLAS storing the model on each location, nonResidentBLAS on empty locations and for models that are not resident.
+				 */
+				std::vector<GLuint> mModelBLAS;
+
+				/**
+				 * BLASes not storing any model.
+				 */
+				std::vector<GLuint> mFreeBLASes;
+
+				/**
+				 * The number of locations referring to each BLAS: a model and its instances.
+				 */
+				std::vector<glm::uint32> mBLASReferences;
+
+				/**
+				 * This is the SSBO where the render program accounts rays reaching each location (see modelHits on raytrace.comp).
+				 */
+				GLuint mResidencyFeedback;
+
+				/**
+				 * This is the persistently mapped buffer the residency feedback is copied on to be read back.
+				 */
+				GLuint mResidencyFeedbackReadback;
+
+				const glm::uint32* mResidencyFeedbackMapping;
+
+				/**
+				 * This is signaled once the residency feedback has been copied on the readback buffer, 0 if no copy is pending.
+				 */
+				GLsync mResidencyFeedbackFence;
+
+				bool mResidencyFeedbackCollection;
+
+				/**
+				 * This is the ring buffer used to upload geometry to be inserted.
+				 */
+				std::unique_ptr<StreamingBuffer> mUploadBuffer;
+
+				/**
+				 * This is the ring buffer frame constants (as RenderConstants) are uploaded through.
+				 */
+				std::unique_ptr<StreamingBuffer> mRenderConstants;
+
+				/**
+				 * This is the ring buffer ray query results are read back from.
+				 */
+				std::unique_ptr<RayQueryQueue> mRayQueries;
+
+				/**
+				 * Transformations to be applied on the next update, at most one for each model.
+				 */
+				std::vector<TransformUpdate> mPendingTransforms;
+
+				/**
+				 * For each model the index of its transformation on mPendingTransforms, or noPendingTransform.
+				 */
+				std::vector<glm::uint32> mPendingTransformIndex;
+
+				/**
+				 * Models whose TLAS leaf must be refitted on the next update.
+				 */
+				std::vector<GLuint> mDirtyModels;
+
+				/**
+				 * For each model TRUE iif it is listed on mDirtyModels.
+				 */
+				std::vector<bool> mModelDirtyFlags;
+
+				/**
+				 * This is the SSBO holding the index of the next screen tile to be rendered in persistent threads mode.
+				 */
+				GLuint mRenderTilesCounter;
+
+				/**
+				 * The number of work groups dispatched in persistent threads mode, 0 when the mode is disabled.
+				 */
+				glm::uint32 mPersistentThreadsWorkGroups;
+
+				/**
+				 * This is the SSBO where the render program accounts the traversal cost (as a TraversalStatistics).
+				 */
+				GLuint mTraversalStatistics;
+
+				bool mTraversalStatisticsCollection;
+
+				OutputFormat mOutputFormat;
+
 				/**
 				 * This is the output texture of the raytraing.
-				 * This texture is not ready to be rendered as it is in RGBA32F format and pixels solors can exceed 1.0,
-				 * so it has to be tone mapped.
+				 * This texture is not ready to be rendered as it is in RGBA32F (or RGBA16F) format and pixels solors can exceed 1.0,
+				 * so it has to be tone mapped. With a tone mapped output format this only holds the accumulated samples, as RGBA16F.
 				 */
 				GLuint mRaytracerOutputTexture;
 
+				/**
+				 * This is the tone mapped image of the raytracing (tone mapped output formats only).
+				 */
+				GLuint mDisplayTexture;
+
+				/**
+				 * This is the framebuffer mDisplayTexture is blitted from.
+				 */
+				GLuint mDisplayFramebuffer;
+
+				/**
+				 * This is the timer of GPU stages: flush, insert, update, render and tonemap (or present).
+				 */
+				std::unique_ptr<GPUTimer> mGPUTimer;
+
 				/**
 				 * This VAO is used for the final result rendering process (the one involving tonemapping).
 				 */
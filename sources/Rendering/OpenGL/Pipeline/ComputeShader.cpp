@@ -5,8 +5,8 @@ using namespace Tachyon::Rendering;
 using namespace Tachyon::Rendering::OpenGL;
 using namespace Tachyon::Rendering::OpenGL::Pipeline;
 
-ComputeShader::ComputeShader(SourceType srcType, const std::string& src, const std::string& entry) noexcept
-        : Shader(glCreateShader(GL_COMPUTE_SHADER), srcType, src, entry) {}
+ComputeShader::ComputeShader(SourceType srcType, const std::string& src, const std::string& entry, const std::vector<SpecializationConstant>& specialization) noexcept
+        : Shader(glCreateShader(GL_COMPUTE_SHADER), srcType, src, entry, specialization) {}
 
-ComputeShader::ComputeShader(SourceType srcType, const char* src, size_t srcSize, const std::string& entry) noexcept
-        : Shader(glCreateShader(GL_COMPUTE_SHADER), srcType, src, srcSize, entry) {}
\ No newline at end of file
+ComputeShader::ComputeShader(SourceType srcType, const char* src, size_t srcSize, const std::string& entry, const std::vector<SpecializationConstant>& specialization) noexcept
+        : Shader(glCreateShader(GL_COMPUTE_SHADER), srcType, src, srcSize, entry, specialization) {}
\ No newline at end of file
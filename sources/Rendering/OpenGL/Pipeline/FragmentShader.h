@@ -14,9 +14,9 @@ namespace Tachyon {
 					FragmentShader& operator=(const FragmentShader&) = delete;
 					~FragmentShader() final = default;
 
-					FragmentShader(SourceType srcType, const char* src, size_t srcSize, const std::string& entry = "main") noexcept;
+					FragmentShader(SourceType srcType, const char* src, size_t srcSize, const std::string& entry = "main", const std::vector<SpecializationConstant>& specialization = {}) noexcept;
 
-					FragmentShader(SourceType srcType, const std::string& src, const std::string& entry = "main") noexcept;
+					FragmentShader(SourceType srcType, const std::string& src, const std::string& entry = "main", const std::vector<SpecializationConstant>& specialization = {}) noexcept;
 				};
 			}
 		}
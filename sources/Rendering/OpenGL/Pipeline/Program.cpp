@@ -5,17 +5,140 @@ using namespace Tachyon::Rendering;
 using namespace Tachyon::Rendering::OpenGL;
 using namespace Tachyon::Rendering::OpenGL::Pipeline;
 
+namespace {
+	/**
+	 * The directory linked programs are cached on, empty if the cache is disabled.
+	 */
+	std::string binaryCacheDirectory;
+
+	const glm::uint64 fnvOffsetBasis = 14695981039346656037ULL;
+	const glm::uint64 fnvPrime = 1099511628211ULL;
+
+	/**
+	 * Accumulate bytes on a 64-bit FNV-1a hash.
+	 *
+	 * @param data bytes to be hashed
+	 * @param size the number of bytes
+	 * @param hash the hash of previous bytes
+	 * @return the hash including the given bytes
+	 */
+	glm::uint64 fnv1a(const void* data, size_t size, glm::uint64 hash) noexcept {
+		const glm::uint8* bytes = reinterpret_cast<const glm::uint8*>(data);
+		for (size_t i = 0; i < size; ++i)
+			hash = (hash ^ glm::uint64(bytes[i])) * fnvPrime;
+
+		return hash;
+	}
+
+	glm::uint64 fnv1a(const std::string& text, glm::uint64 hash) noexcept {
+		// The terminator keeps consecutive strings apart
+		return fnv1a(text.c_str(), text.size() + 1, hash);
+	}
+
+	std::string getString(GLenum name) noexcept {
+		const GLubyte* value = glGetString(name);
+
+		return (value != nullptr) ? std::string(reinterpret_cast<const char*>(value)) : std::string();
+	}
+
+	/**
+	 * Let the driver compile and link on its own threads, once for the whole process, if it supports it.
+	 */
+	void enableParallelCompile() noexcept {
+		static bool checked = false;
+		if (checked) return;
+		checked = true;
+
+		GLint extensionsCount = 0;
+		glGetIntegerv(GL_NUM_EXTENSIONS, &extensionsCount);
+
+		for (GLint i = 0; i < extensionsCount; ++i) {
+			const std::string extension(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, GLuint(i))));
+
+			const char* entryPoint = nullptr;
+			if (extension == "GL_KHR_parallel_shader_compile") {
+				entryPoint = "glMaxShaderCompilerThreadsKHR";
+			} else if (extension == "GL_ARB_parallel_shader_compile") {
+				entryPoint = "glMaxShaderCompilerThreadsARB";
+			} else {
+				continue;
+			}
+
+			// gl3w does not load extensions
+			const auto maxShaderCompilerThreads = reinterpret_cast<PFNGLMAXSHADERCOMPILERTHREADSKHRPROC>(gl3wGetProcAddress(entryPoint));
+			if (maxShaderCompilerThreads == nullptr) continue;
+
+			// Let the driver choose the number of threads
+			maxShaderCompilerThreads(0xFFFFFFFF);
+			return;
+		}
+	}
+}
+
 Program::Program(const std::initializer_list<std::shared_ptr<const Shader>>& shaders) noexcept :
-    program(glCreateProgram()) {
+    linkingShaders(shaders), binaryKey(0), computeWorkGroupSize(0, 0, 0), program(glCreateProgram()) {
+	enableParallelCompile();
+
+	if (!binaryCacheDirectory.empty()) {
+		// Binaries are only valid for the driver that has produced them
+		glm::uint64 key = fnvOffsetBasis;
+		key = fnv1a(getString(GL_VENDOR), key);
+		key = fnv1a(getString(GL_RENDERER), key);
+		key = fnv1a(getString(GL_VERSION), key);
+
+		for (const auto& shader : shaders) {
+			GLint shaderType = 0;
+			glGetShaderiv(shader->shader, GL_SHADER_TYPE, &shaderType);
+
+			key = fnv1a(&shaderType, sizeof(shaderType), key);
+			key = fnv1a(&shader->sourceType, sizeof(shader->sourceType), key);
+			key = fnv1a(shader->source, key);
+			key = fnv1a(shader->entry, key);
+			for (const auto& constant : shader->specialization)
+				key = fnv1a(&constant, sizeof(constant), key);
+		}
+
+		// 0 marks a disabled cache
+		binaryKey = std::max<glm::uint64>(key, 1);
+
+		std::ifstream binary(getBinaryCachePath(), std::ios::in | std::ios::binary);
+		GLenum binaryFormat = 0;
+		if ((binary.is_open()) && (binary.read(reinterpret_cast<char*>(&binaryFormat), sizeof(binaryFormat)))) {
+			const std::vector<char> binaryData((std::istreambuf_iterator<char>(binary)), std::istreambuf_iterator<char>());
+
+			glProgramBinary(program, binaryFormat, binaryData.data(), GLsizei(binaryData.size()));
+
+			// A binary is rejected (e.g. after a driver update) by failing the link
+			GLint isLinked = GL_FALSE;
+			glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+			if (isLinked == GL_TRUE) {
+				linkingShaders.clear();
+
+				return;
+			}
+		}
+
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
 	// Attach each shader one after the other
 	for (auto& shader : shaders) {
 		//importErrors(std::string("Error in imported shader: "), *shader);
 
+		shader->compile();
 		glAttachShader(program, shader->shader);
 	}
 
-	// Link our program
+	// Link our program: the result is checked on first use
 	glLinkProgram(program);
+}
+
+void Program::waitForLink() const noexcept {
+	if (linkingShaders.empty()) return;
+
+	bool areCompiled = true;
+	for (const auto& shader : linkingShaders)
+		areCompiled = (shader->checkCompileStatus()) && (areCompiled);
 
 	// Note the different functions here: glGetProgram* instead of glGetShader*.
 	GLint isLinked = 0;
@@ -39,13 +162,58 @@ Program::Program(const std::initializer_list<std::shared_ptr<const Shader>>& sha
 	}
 
 	// Detach each shader one after the other
-	for (auto& shader : shaders)
+	for (auto& shader : linkingShaders)
 		glDetachShader(program, shader->shader);
+	linkingShaders.clear();
+
+	DBG_ASSERT( (areCompiled) );
+	DBG_ASSERT( (isLinked == GL_TRUE) );
+
+	if ((isLinked == GL_FALSE) || (binaryKey == 0)) return;
+
+	// Store the binary for the next processes
+	GLint binaryLength = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	if (binaryLength <= 0) return;
+
+	std::vector<char> binaryData(size_t(binaryLength), 0);
+	GLenum binaryFormat = 0;
+	glGetProgramBinary(program, binaryLength, &binaryLength, &binaryFormat, binaryData.data());
+
+	// Processes started together may write the same binary: each one writes its own file and then replaces the cached one
+	const std::string path = getBinaryCachePath();
+	std::ostringstream temporaryPath;
+	temporaryPath << path << "." << std::hex << std::chrono::steady_clock::now().time_since_epoch().count() << ".tmp";
+
+	std::ofstream binary(temporaryPath.str(), std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!binary.is_open()) return;
+
+	binary.write(reinterpret_cast<const char*>(&binaryFormat), sizeof(binaryFormat));
+	binary.write(binaryData.data(), std::streamsize(binaryLength));
+	binary.close();
+
+	// A binary that cannot be stored is simply linked again by the next process
+	if ((binary.fail()) || (std::rename(temporaryPath.str().c_str(), path.c_str()) != 0))
+		std::remove(temporaryPath.str().c_str());
+}
+
+std::string Program::getBinaryCachePath() const noexcept {
+	if (binaryKey == 0) return std::string();
+
+	std::ostringstream path;
+	path << binaryCacheDirectory << "/" << std::hex << std::setw(16) << std::setfill('0') << binaryKey << ".glbin";
 
-    DBG_ASSERT( (isLinked == GL_TRUE) );
+	return path.str();
+}
+
+void Program::setBinaryCacheDirectory(const std::string& directory) noexcept {
+	binaryCacheDirectory = directory;
 }
 
 Program::~Program() {
+	// Make sure shaders are detached before being released
+	waitForLink();
+
     if (program != 0) {
         // Get the currently active program
         GLint64 activeProgram;
@@ -59,6 +227,8 @@ Program::~Program() {
 }
 
 void Program::use(const Program& program) noexcept {
+	program.waitForLink();
+
     GLint64 activeProgram;
     glGetInteger64v(GL_CURRENT_PROGRAM, &activeProgram);
 
@@ -66,6 +236,29 @@ void Program::use(const Program& program) noexcept {
         glUseProgram(program.program);
 }
 
+glm::uvec3 Program::getComputeWorkGroupSize() const noexcept {
+	if (computeWorkGroupSize.x == 0) {
+		waitForLink();
+
+		GLint workGroupSize[3];
+		glGetProgramiv(program, GL_COMPUTE_WORK_GROUP_SIZE, workGroupSize);
+
+		computeWorkGroupSize = glm::uvec3(workGroupSize[0], workGroupSize[1], workGroupSize[2]);
+	}
+
+	return computeWorkGroupSize;
+}
+
+glm::uvec3 Program::getComputeWorkGroupsCount(const glm::uvec3& invocations) const noexcept {
+	const glm::uvec3 workGroupSize = getComputeWorkGroupSize();
+
+	return glm::uvec3(
+		(invocations.x + workGroupSize.x - 1) / workGroupSize.x,
+		(invocations.y + workGroupSize.y - 1) / workGroupSize.y,
+		(invocations.z + workGroupSize.z - 1) / workGroupSize.z
+	);
+}
+
 GLint Program::getUniformLocation(const std::string& name) const noexcept {
     //Program::use(*this);
 
@@ -192,3 +385,27 @@ void Program::setUniform(const std::string& name, const glm::mat2x4* data, glm::
 	if (location >= 0)
 		glUniformMatrix2x4fv(location, count, GL_FALSE, glm::value_ptr(*data));
 }
+
+void Program::setUniform(UniformLocation<glm::uint> uniform, const glm::uint& data) const noexcept {
+	glProgramUniform1ui(program, uniform.location, data);
+}
+
+void Program::setUniform(UniformLocation<glm::float32> uniform, const glm::float32& data) const noexcept {
+	glProgramUniform1f(program, uniform.location, data);
+}
+
+void Program::setUniform(UniformLocation<glm::vec2> uniform, const glm::vec2& data) const noexcept {
+	glProgramUniform2f(program, uniform.location, data[0], data[1]);
+}
+
+void Program::setUniform(UniformLocation<glm::vec3> uniform, const glm::vec3& data) const noexcept {
+	glProgramUniform3f(program, uniform.location, data[0], data[1], data[2]);
+}
+
+void Program::setUniform(UniformLocation<glm::vec4> uniform, const glm::vec4& data) const noexcept {
+	glProgramUniform4f(program, uniform.location, data[0], data[1], data[2], data[3]);
+}
+
+void Program::setUniform(UniformLocation<glm::mat4> uniform, const glm::mat4& data) const noexcept {
+	glProgramUniformMatrix4fv(program, uniform.location, 1, GL_FALSE, glm::value_ptr(data));
+}
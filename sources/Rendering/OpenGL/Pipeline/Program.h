@@ -6,6 +6,16 @@ namespace Tachyon {
 	namespace Rendering {
 		namespace OpenGL {
 			namespace Pipeline {
+
+				/**
+				 * This is a uniform declared with an explicit layout(location = N):
+				 * the type of the value it holds selects the setter at compile time, and no name is ever looked up.
+				 */
+				template <typename T>
+				struct UniformLocation {
+					GLint location;
+				};
+
 				class Program {
 
 					// TODO: think about this...
@@ -20,10 +30,43 @@ namespace Tachyon {
 
 					~Program();
 
+					/**
+					 * Create a program from the given shaders, or from its binary when found on the binary cache.
+					 *
+					 * Linking is not waited for here: programs created one after the other are linked in parallel
+					 * when the driver supports GL_KHR_parallel_shader_compile, and the first use waits for the result.
+					 *
+					 * @param shaders shaders of the program
+					 */
 					Program(const std::initializer_list<std::shared_ptr<const Shader>>& shaders) noexcept;
 
 					static void use(const Program& program) noexcept;
 
+					/**
+					 * Keep linked programs on disk, so that later processes can load them instead of compiling and linking shaders.
+					 *
+					 * Binaries are identified by the GL vendor, renderer and version, and by shader sources and specialization:
+					 * a binary rejected by the driver is replaced by a freshly linked one.
+					 *
+					 * @param directory an existing directory binaries are stored in, empty to disable the cache (the default)
+					 */
+					static void setBinaryCacheDirectory(const std::string& directory) noexcept;
+
+					/**
+					 * Get the local work group size declared by the compute shader of this program.
+					 *
+					 * @return the work group size on the X, Y and Z dimensions
+					 */
+					glm::uvec3 getComputeWorkGroupSize() const noexcept;
+
+					/**
+					 * Get the number of work groups needed to spawn at least the given number of invocations.
+					 *
+					 * @param invocations the minimum number of invocations along each dimension
+					 * @return the number of work groups to be dispatched along each dimension
+					 */
+					glm::uvec3 getComputeWorkGroupsCount(const glm::uvec3& invocations) const noexcept;
+
 					void setUniform(const std::string& name, const glm::float32& value) const noexcept;
 
 					void setUniform(const std::string& name, const glm::float32& data1,
@@ -65,10 +108,53 @@ namespace Tachyon {
 
 					void setUniform(const std::string& name, const std::vector<glm::uint>& data) const noexcept;
 
+					/*
+					 * Setters of uniforms by location: they write the uniform of this program, even when it is not the active one.
+					 */
+
+					void setUniform(UniformLocation<glm::uint> uniform, const glm::uint& data) const noexcept;
+
+					void setUniform(UniformLocation<glm::float32> uniform, const glm::float32& data) const noexcept;
+
+					void setUniform(UniformLocation<glm::vec2> uniform, const glm::vec2& data) const noexcept;
+
+					void setUniform(UniformLocation<glm::vec3> uniform, const glm::vec3& data) const noexcept;
+
+					void setUniform(UniformLocation<glm::vec4> uniform, const glm::vec4& data) const noexcept;
+
+					void setUniform(UniformLocation<glm::mat4> uniform, const glm::mat4& data) const noexcept;
+
 				private:
 					GLint getUniformLocation(const std::string& name) const noexcept;
 
+					/**
+					 * Wait for the link issued by the constructor to complete, report errors and store the binary on the cache.
+					 */
+					void waitForLink() const noexcept;
+
+					/**
+					 * Get the file the binary of this program is cached on.
+					 *
+					 * @return the path of the binary, empty if the cache is disabled
+					 */
+					std::string getBinaryCachePath() const noexcept;
+
+					/**
+					 * Shaders being linked: they are released once the link has completed.
+					 */
+					mutable std::vector<std::shared_ptr<const Shader>> linkingShaders;
+
+					/**
+					 * Identifies the program on the binary cache, 0 if the cache is disabled.
+					 */
+					glm::uint64 binaryKey;
+
 					mutable std::unordered_map<std::string, GLint> uniformLocations;
+
+					/**
+					 * This is lazily initialized as querying it is only valid for compute programs.
+					 */
+					mutable glm::uvec3 computeWorkGroupSize;
 					
 					GLuint program;
 				};
@@ -5,29 +5,51 @@ using namespace Tachyon::Rendering;
 using namespace Tachyon::Rendering::OpenGL;
 using namespace Tachyon::Rendering::OpenGL::Pipeline;
 
-Shader::Shader(GLuint shader, SourceType srcType, const std::string& src, const std::string& entry) noexcept
-    : Shader(shader, srcType, src.c_str(), src.size(), entry) {}
+Shader::Shader(GLuint shader, SourceType srcType, const std::string& src, const std::string& entry, const std::vector<SpecializationConstant>& specialization) noexcept
+    : Shader(shader, srcType, src.c_str(), src.size(), entry, specialization) {}
 
-Shader::Shader(GLuint shader, SourceType srcType, const char* src, size_t srcSize, const std::string& entry) noexcept
-    : shader(shader) {
-	const auto size = static_cast<GLint>(srcSize);
+Shader::Shader(GLuint shader, SourceType srcType, const char* src, size_t srcSize, const std::string& entry, const std::vector<SpecializationConstant>& specialization) noexcept
+    : shader(shader),
+	sourceType(srcType),
+	source(src, srcSize),
+	entry(entry),
+	specialization(specialization),
+	compiled(false) {
+	// Specialization constants only exist in SPIR-V
+	DBG_ASSERT( ((srcType == SourceType::SPIRV) || (specialization.empty())) );
+}
+
+void Shader::compile() const noexcept {
+	if (compiled) return;
+	compiled = true;
+
+	const char* src = source.c_str();
+	const auto size = static_cast<GLint>(source.size());
 
-	if (srcType == SourceType::GLSL) {
+	if (sourceType == SourceType::GLSL) {
 		// Set the shader source code
 		glShaderSource(shader, 1, &src, &size);
 
 		// Compile the vertex shader
 		glCompileShader(shader);
-	} else if (srcType == SourceType::SPIRV) {
+	} else if (sourceType == SourceType::SPIRV) {
 		// Apply the vertex shader SPIR-V to the shader object.
 		glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V, src, size);
 
 		// Specialize the shader
-		glSpecializeShader(shader, (const GLchar*)entry.c_str(), 0, nullptr, nullptr);
+		std::vector<GLuint> constantsIndex, constantsValue;
+		for (const auto& constant : specialization) {
+			constantsIndex.push_back(constant.index);
+			constantsValue.push_back(constant.value);
+		}
+
+		glSpecializeShader(shader, (const GLchar*)entry.c_str(), static_cast<GLuint>(specialization.size()), constantsIndex.data(), constantsValue.data());
 	} else {
 		DBG_ASSERT(false);
 	}
+}
 
+bool Shader::checkCompileStatus() const noexcept {
 	GLint isCompiled = 0;
 	glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
 	if (isCompiled == GL_FALSE)
@@ -47,7 +69,7 @@ Shader::Shader(GLuint shader, SourceType srcType, const char* src, size_t srcSiz
 		})
 	}
 
-	DBG_ASSERT( (isCompiled == GL_TRUE) );
+	return isCompiled == GL_TRUE;
 }
 
 Shader::~Shader() {
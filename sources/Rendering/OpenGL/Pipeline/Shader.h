@@ -8,6 +8,19 @@ namespace Tachyon {
 				namespace Pipeline {
 				class Program;
 
+				/**
+				 * This is the value given to a SPIR-V specialization constant (the one declared with layout(constant_id = index)).
+				 */
+				struct SpecializationConstant {
+					GLuint index;
+
+					GLuint value;
+				};
+
+				/**
+				 * This is a shader stage: the source is kept and only compiled when a program has to be linked from it,
+				 * so that programs found on the binary cache never compile anything.
+				 */
 				class Shader {
 					friend class Program;
 
@@ -25,12 +38,37 @@ namespace Tachyon {
 					virtual ~Shader();
 
 				protected:
-					Shader(GLuint shader, SourceType srcType, const char* src, size_t srcSize, const std::string& entry = "main") noexcept;
+					Shader(GLuint shader, SourceType srcType, const char* src, size_t srcSize, const std::string& entry = "main", const std::vector<SpecializationConstant>& specialization = {}) noexcept;
 
-					Shader(GLuint shader, SourceType srcType, const std::string& src, const std::string& entry = "main") noexcept;
+					Shader(GLuint shader, SourceType srcType, const std::string& src, const std::string& entry = "main", const std::vector<SpecializationConstant>& specialization = {}) noexcept;
 
 				private:
+					/**
+					 * Issue the compilation of the shader, if not done already: the result is not waited for.
+					 */
+					void compile() const noexcept;
+
+					/**
+					 * Wait for the compilation to complete and report errors.
+					 *
+					 * @return TRUE if the shader has been compiled successfully
+					 */
+					bool checkCompileStatus() const noexcept;
+
 					GLuint shader;
+
+					SourceType sourceType;
+
+					/**
+					 * The GLSL source or the SPIR-V module: it also identifies the shader on the binary cache.
+					 */
+					std::string source;
+
+					std::string entry;
+
+					std::vector<SpecializationConstant> specialization;
+
+					mutable bool compiled;
 				};
 			}
 		}
@@ -0,0 +1,136 @@
+#include "Rendering/OpenGL/RayQueryQueue.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::OpenGL;
+
+RayQueryQueue::RayQueryQueue(size_t size, size_t alignment) noexcept
+	: mBuffer(0),
+	mSize(size),
+	mAlignment(std::max<size_t>(alignment, 1)),
+	mMapping(nullptr),
+	mHead(0),
+	mNextBatch(0) {
+	const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	// Results are only read by the CPU: prefer memory on its side
+	glCreateBuffers(1, &mBuffer);
+	glNamedBufferStorage(mBuffer, mSize, NULL, flags | GL_CLIENT_STORAGE_BIT);
+	mMapping = reinterpret_cast<const glm::uint8*>(glMapNamedBufferRange(mBuffer, 0, mSize, flags));
+
+	DBG_ASSERT( (mMapping != nullptr) );
+}
+
+RayQueryQueue::~RayQueryQueue() {
+	for (const auto& region : mPendingRegions)
+		if (region.fence) glDeleteSync(region.fence);
+
+	glUnmapNamedBuffer(mBuffer);
+	glDeleteBuffers(1, &mBuffer);
+}
+
+GLuint RayQueryQueue::getBuffer() const noexcept {
+	return mBuffer;
+}
+
+size_t RayQueryQueue::getMaxAllocationRays() const noexcept {
+	return ((mSize / 2) - mAlignment) / sizeof(RayQueryResult);
+}
+
+RayQueryBatch RayQueryQueue::beginBatch(size_t raysCount) noexcept {
+	const RayQueryBatch batch = mNextBatch++;
+
+	Batch& batchResults = mBatches[batch];
+	batchResults.results.resize(raysCount);
+	batchResults.pendingRegions = 0;
+
+	return batch;
+}
+
+RayQueryQueue::Allocation RayQueryQueue::allocate(RayQueryBatch batch, size_t firstRay, size_t raysCount) noexcept {
+	DBG_ASSERT( (raysCount <= getMaxAllocationRays()) );
+	DBG_ASSERT( (mBatches.count(batch) == 1) );
+
+	const size_t size = sizeof(RayQueryResult) * std::max<size_t>(raysCount, 1);
+
+	size_t begin = ((mHead + mAlignment - 1) / mAlignment) * mAlignment;
+
+	// Restart from the beginning of the buffer: what has been allocated so far must be fenced before being reused
+	if ((begin + size) > mSize) {
+		fence();
+
+		begin = 0;
+	}
+
+	// Regions are written in order: release the oldest ones until none overlaps the new region
+	const auto overlaps = [begin, size](const PendingRegion& region) { return (region.begin < (begin + size)) && (begin < region.end); };
+	while (std::any_of(mPendingRegions.cbegin(), mPendingRegions.cend(), overlaps))
+		resolveOldestRegion(true);
+
+	mHead = begin + size;
+
+	mPendingRegions.push_back(PendingRegion{ begin, begin + sizeof(RayQueryResult) * raysCount, batch, firstRay, 0 });
+	mBatches[batch].pendingRegions += 1;
+
+	return Allocation{ GLintptr(begin), GLsizeiptr(size) };
+}
+
+void RayQueryQueue::fence() noexcept {
+	for (auto region = mPendingRegions.rbegin(); (region != mPendingRegions.rend()) && (region->fence == 0); ++region)
+		region->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+bool RayQueryQueue::resolveOldestRegion(bool wait) noexcept {
+	if (mPendingRegions.empty()) return false;
+
+	const PendingRegion& region = mPendingRegions.front();
+	DBG_ASSERT( ((!wait) || (region.fence != 0)) );
+	if (region.fence == 0) return false;
+
+	GLenum status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+	while ((wait) && (status == GL_TIMEOUT_EXPIRED))
+		status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+
+	if (status == GL_TIMEOUT_EXPIRED) return false;
+
+	// The mapping is coherent: once the fence is signaled results are visible
+	Batch& batch = mBatches[region.batch];
+	if (region.end > region.begin)
+		std::memcpy(batch.results.data() + region.firstRay, mMapping + region.begin, region.end - region.begin);
+	batch.pendingRegions -= 1;
+
+	glDeleteSync(region.fence);
+	mPendingRegions.pop_front();
+
+	return true;
+}
+
+bool RayQueryQueue::poll(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept {
+	const auto batchIt = mBatches.find(batch);
+	DBG_ASSERT( (batchIt != mBatches.end()) );
+	if (batchIt == mBatches.end()) return false;
+
+	while ((batchIt->second.pendingRegions > 0) && (resolveOldestRegion(false))) {}
+
+	if (batchIt->second.pendingRegions > 0) return false;
+
+	results = std::move(batchIt->second.results);
+	mBatches.erase(batchIt);
+
+	return true;
+}
+
+void RayQueryQueue::wait(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept {
+	const auto batchIt = mBatches.find(batch);
+	DBG_ASSERT( (batchIt != mBatches.end()) );
+	if (batchIt == mBatches.end()) return;
+
+	// Every region of the batch must be fenced before being waited for
+	fence();
+
+	while (batchIt->second.pendingRegions > 0)
+		resolveOldestRegion(true);
+
+	results = std::move(batchIt->second.results);
+	mBatches.erase(batchIt);
+}
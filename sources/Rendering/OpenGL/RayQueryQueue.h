@@ -0,0 +1,167 @@
+#pragma once
+
+#include "Rendering/RenderingPipeline.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * This is the ring buffer ray query results are written to by the GPU and read back from.
+			 *
+			 * The whole buffer is persistently and coherently mapped for reading: results of a region are copied
+			 * to the CPU memory of their batch as soon as its fence is signaled, so the ring is never held by
+			 * batches the client has not retrieved yet.
+			 *
+			 * Usage: begin a batch, allocate a region for each dispatch, issue the dispatch writing it
+			 *        (followed by GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT) and then call fence().
+			 *        A region MUST NOT exceed getMaxAllocationRays() results.
+			 */
+			class RayQueryQueue {
+			public:
+				/**
+				 * This is a region of the ring buffer to be written by the GPU.
+				 */
+				struct Allocation {
+					/**
+					 * The offset of this region on the buffer.
+					 */
+					GLintptr offset;
+
+					/**
+					 * The size of this region in bytes.
+					 */
+					GLsizeiptr size;
+				};
+
+				RayQueryQueue() = delete;
+
+				RayQueryQueue(const RayQueryQueue&) = delete;
+
+				RayQueryQueue(RayQueryQueue&&) = delete;
+
+				RayQueryQueue& operator=(const RayQueryQueue&) = delete;
+
+				~RayQueryQueue();
+
+				/**
+				 * Create and map the ring buffer.
+				 *
+				 * @param size the size of the ring buffer in bytes
+				 * @param alignment the alignment of each allocation (e.g. GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT)
+				 */
+				RayQueryQueue(size_t size, size_t alignment) noexcept;
+
+				/**
+				 * Start tracking a new batch of rays.
+				 *
+				 * @param raysCount the number of rays of the batch
+				 * @return the new batch
+				 */
+				RayQueryBatch beginBatch(size_t raysCount) noexcept;
+
+				/**
+				 * Reserve a region for results of consecutive rays of a batch, waiting for the GPU to release it if necessary.
+				 *
+				 * @param batch the batch rays belong to
+				 * @param firstRay the index of the first ray on the batch
+				 * @param raysCount the number of rays
+				 * @return the reserved region
+				 */
+				Allocation allocate(RayQueryBatch batch, size_t firstRay, size_t raysCount) noexcept;
+
+				/**
+				 * Mark regions allocated since the last fence as being written by GPU commands issued so far.
+				 */
+				void fence() noexcept;
+
+				/**
+				 * Retrieve results of a batch if every region of it has been written, without waiting.
+				 *
+				 * @param batch the batch to retrieve
+				 * @param results results of the batch, when ready
+				 * @return TRUE if results are ready (and the batch has been released)
+				 */
+				bool poll(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept;
+
+				/**
+				 * Retrieve results of a batch, waiting for the GPU if needed.
+				 *
+				 * @param batch the batch to retrieve
+				 * @param results results of the batch
+				 */
+				void wait(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept;
+
+				GLuint getBuffer() const noexcept;
+
+				/**
+				 * Get the maximum number of results of a single allocation.
+				 *
+				 * @return half of the ring buffer, in results
+				 */
+				size_t getMaxAllocationRays() const noexcept;
+
+			private:
+				/**
+				 * This is a region being written by the GPU.
+				 */
+				struct PendingRegion {
+					size_t begin;
+
+					size_t end;
+
+					RayQueryBatch batch;
+
+					size_t firstRay;
+
+					/**
+					 * This is 0 until the region is fenced.
+					 */
+					GLsync fence;
+				};
+
+				struct Batch {
+					std::vector<RayQueryResult> results;
+
+					/**
+					 * The number of regions of the batch not copied to results yet.
+					 */
+					size_t pendingRegions;
+				};
+
+				/**
+				 * Copy results of the oldest region to its batch if the GPU has written them.
+				 *
+				 * @param wait TRUE to wait for the GPU
+				 * @return TRUE if the region has been released
+				 */
+				bool resolveOldestRegion(bool wait) noexcept;
+
+				GLuint mBuffer;
+
+				const size_t mSize;
+
+				const size_t mAlignment;
+
+				const glm::uint8* mMapping;
+
+				/**
+				 * The first byte after the last allocation.
+				 */
+				size_t mHead;
+
+				/**
+				 * Regions waiting for the GPU, from the oldest one.
+				 */
+				std::deque<PendingRegion> mPendingRegions;
+
+				/**
+				 * Batches not retrieved yet.
+				 */
+				std::unordered_map<RayQueryBatch, Batch> mBatches;
+
+				RayQueryBatch mNextBatch;
+			};
+		}
+	}
+}
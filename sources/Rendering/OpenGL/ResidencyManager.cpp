@@ -0,0 +1,116 @@
+#include "Rendering/OpenGL/ResidencyManager.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::OpenGL;
+
+ResidencyManager::ResidencyManager(OpenGLPipeline& pipeline, size_t maxModelsPerUpdate) noexcept
+	: mPipeline(pipeline),
+	mMaxModelsPerUpdate(std::max<size_t>(maxModelsPerUpdate, 1)) {
+	mPipeline.setResidencyFeedbackCollection(true);
+}
+
+ResidencyManager::~ResidencyManager() {
+	mPipeline.setResidencyFeedbackCollection(false);
+}
+
+GLuint ResidencyManager::addModel(std::vector<GeometryPrimitive>&& primitives, const glm::mat4& transform) noexcept {
+	const GLuint location = GLuint(mModels.size());
+	if (location >= (GLuint(1) << mPipeline.getCapacity().expOfTwo_maxModels)) return invalidModelHandle;
+
+	// The proxy bounds every sphere of the model, an empty model gets an empty proxy that no ray ever crosses
+	glm::vec3 boundsMin(0), boundsMax(0);
+	if (!primitives.empty()) {
+		boundsMin = glm::vec3(std::numeric_limits<glm::float32>::max());
+		boundsMax = glm::vec3(std::numeric_limits<glm::float32>::lowest());
+
+		for (const auto& primitive : primitives) {
+			boundsMin = glm::min(boundsMin, primitive.getCenter() - glm::vec3(primitive.getRadius()));
+			boundsMax = glm::max(boundsMax, primitive.getCenter() + glm::vec3(primitive.getRadius()));
+		}
+	}
+
+	mModels.push_back(StoredModel{ std::move(primitives), transform, false, mLeastRecentlyHit.end() });
+
+	mPipeline.placeModelProxy(location, boundsMin, boundsMax);
+	mPipeline.setModelTransform(location, transform);
+
+	return location;
+}
+
+void ResidencyManager::setModelTransform(GLuint location, const glm::mat4& transform) noexcept {
+	DBG_ASSERT( (location < mModels.size()) );
+
+	mModels[location].transform = transform;
+
+	mPipeline.setModelTransform(location, transform);
+}
+
+void ResidencyManager::update() noexcept {
+	if (!mPipeline.pollResidencyFeedback(mModelHits)) return;
+
+	// Resident models that have been hit are the most recent ones, those reached through their proxy are requested
+	std::vector<GLuint> requested;
+	for (GLuint location = 0; location < GLuint(mModels.size()); ++location) {
+		if (mModelHits[location] == 0) continue;
+
+		StoredModel& model = mModels[location];
+		if (model.resident) {
+			mLeastRecentlyHit.splice(mLeastRecentlyHit.begin(), mLeastRecentlyHit, model.recency);
+		} else {
+			requested.push_back(location);
+		}
+	}
+
+	// The most requested models are paged first
+	const size_t pagedCount = std::min(requested.size(), mMaxModelsPerUpdate);
+	std::partial_sort(requested.begin(), requested.begin() + pagedCount, requested.end(), [this](GLuint lhs, GLuint rhs) {
+		return mModelHits[lhs] > mModelHits[rhs];
+	});
+	requested.resize(pagedCount);
+
+	std::vector<Model> models;
+	std::vector<ModelTransform> transforms;
+
+	size_t freeBLASesCount = mPipeline.getFreeBLASCount();
+	for (const auto location : requested) {
+		if (freeBLASesCount == 0) {
+			// Make room evicting the least recently hit model, unless it is still visible
+			if ((mLeastRecentlyHit.empty()) || (mModelHits[mLeastRecentlyHit.back()] != 0)) break;
+
+			const GLuint evicted = mLeastRecentlyHit.back();
+			mLeastRecentlyHit.pop_back();
+
+			mModels[evicted].resident = false;
+			mPipeline.evictModel(evicted);
+
+			freeBLASesCount += 1;
+		}
+
+		StoredModel& model = mModels[location];
+		model.resident = true;
+		mLeastRecentlyHit.push_front(location);
+		model.recency = mLeastRecentlyHit.begin();
+
+		freeBLASesCount -= 1;
+
+		// The host copy is kept: the model is built from it again after each eviction
+		models.push_back(Model{ model.primitives, location });
+		transforms.push_back(ModelTransform{ location, model.transform });
+	}
+
+	if (models.empty()) return;
+
+	mPipeline.enqueueModels(std::move(models));
+
+	// Built models are placed with the identity
+	mPipeline.setModelTransforms(transforms);
+}
+
+size_t ResidencyManager::getModelsCount() const noexcept {
+	return mModels.size();
+}
+
+size_t ResidencyManager::getResidentModelsCount() const noexcept {
+	return mLeastRecentlyHit.size();
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "Rendering/OpenGL/OpenGLPipeline.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * This is the pager of models on a pipeline with fewer BLASes than locations (see SceneCapacity::expOfTwo_maxResidentModels):
+			 * every model is kept in host memory and placed on the TLAS as a proxy, then it is built on a BLAS
+			 * as soon as camera rays cross its proxy, evicting models that have not been hit for the longest time.
+			 *
+			 * The working set is bounded by the number of BLASes, while the scene is only bounded by the number of locations.
+			 *
+			 * Usage: create the manager on an empty pipeline (the manager takes every location, from the first one),
+			 *        add models and call update() on the render thread before each frame.
+			 *        A model that has been evicted is only rendered again once the feedback has reached the manager, a few frames later.
+			 */
+			class ResidencyManager {
+			public:
+				ResidencyManager() = delete;
+
+				ResidencyManager(const ResidencyManager&) = delete;
+
+				ResidencyManager(ResidencyManager&&) = delete;
+
+				ResidencyManager& operator=(const ResidencyManager&) = delete;
+
+				/**
+				 * Stop collecting the residency feedback: models are left on the pipeline as they are.
+				 */
+				~ResidencyManager();
+
+				/**
+				 * Start collecting the residency feedback on the given pipeline.
+				 *
+				 * @param pipeline the pipeline models are paged on
+				 * @param maxModelsPerUpdate the maximum number of models built by each update, to bound the time spent paging
+				 */
+				ResidencyManager(OpenGLPipeline& pipeline, size_t maxModelsPerUpdate = 16) noexcept;
+
+				/**
+				 * Add a model to the scene: it is placed as a proxy, and built once a ray crosses it.
+				 *
+				 * @param primitives the geometry of the model
+				 * @param transform the transformation from the model space to the world space
+				 * @return the location of the model, invalidModelHandle if every location is taken
+				 */
+				GLuint addModel(std::vector<GeometryPrimitive>&& primitives, const glm::mat4& transform = glm::mat4(1)) noexcept;
+
+				/**
+				 * Move a model: the transformation is kept across evictions.
+				 *
+				 * @param location the location of the model
+				 * @param transform the transformation from the model space to the world space
+				 */
+				void setModelTransform(GLuint location, const glm::mat4& transform) noexcept;
+
+				/**
+				 * Page models following the latest residency feedback, if any: models reached by rays are built
+				 * (the most reached first) and, when no BLAS is free, models that have not been hit for the longest time are evicted.
+				 *
+				 * Models hit by the latest feedback are never evicted: when all of them are, the working set exceeds the BLASes
+				 * and models left out are paged as soon as a BLAS is freed.
+				 */
+				void update() noexcept;
+
+				/**
+				 * Get the number of models added to the scene.
+				 *
+				 * @return the number of models
+				 */
+				size_t getModelsCount() const noexcept;
+
+				/**
+				 * Get the number of models whose BLAS is in memory.
+				 *
+				 * @return the number of resident models
+				 */
+				size_t getResidentModelsCount() const noexcept;
+
+			private:
+				/**
+				 * This is a model as kept in host memory.
+				 */
+				struct StoredModel {
+					std::vector<GeometryPrimitive> primitives;
+
+					glm::mat4 transform;
+
+					bool resident;
+
+					/**
+					 * The position of the model on mLeastRecentlyHit, only meaningful while the model is resident.
+					 */
+					std::list<GLuint>::iterator recency;
+				};
+
+				OpenGLPipeline& mPipeline;
+
+				const size_t mMaxModelsPerUpdate;
+
+				/**
+				 * Every model of the scene: the model on location l is at l.
+				 */
+				std::vector<StoredModel> mModels;
+
+				/**
+				 * Resident models, from the most recently hit to the least recently hit one.
+				 */
+				std::list<GLuint> mLeastRecentlyHit;
+
+				/**
+				 * The latest residency feedback.
+				 */
+				std::vector<glm::uint32> mModelHits;
+			};
+		}
+	}
+}
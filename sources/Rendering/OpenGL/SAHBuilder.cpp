@@ -0,0 +1,356 @@
+#include "Rendering/OpenGL/SAHBuilder.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::OpenGL;
+
+namespace {
+	/**
+	 * The number of bins each axis is divided in when looking for the best split.
+	 */
+	constexpr size_t sahBinsCount = 16;
+
+	/**
+	 * Subtrees holding at least this many geometry are built as tasks of their own.
+	 */
+	constexpr size_t parallelSubtreeMinGeometry = 4096;
+
+	/**
+	 * These MUST match WIDE_BVH_WIDTH and WIDE_BVH_NO_CHILD in raytrace.comp.
+	 */
+	constexpr glm::uint32 wideBVHWidth = 4;
+	constexpr glm::uint32 wideBVHNoChild = 0xFFFFFFFFu;
+
+	/**
+	 * This is an AABB as its vertices: an AABB with no extent on any axis is empty, as on raytrace.comp.
+	 */
+	struct Bounds {
+		glm::vec3 min;
+
+		glm::vec3 max;
+	};
+
+	const Bounds emptyBounds = { glm::vec3(0), glm::vec3(0) };
+
+	bool isEmpty(const Bounds& bounds) noexcept {
+		const glm::vec3 extent = bounds.max - bounds.min;
+
+		return (extent.x == 0) || (extent.y == 0) || (extent.z == 0);
+	}
+
+	Bounds join(const Bounds& lhs, const Bounds& rhs) noexcept {
+		if (isEmpty(lhs)) return rhs;
+		if (isEmpty(rhs)) return lhs;
+
+		return Bounds{ glm::min(lhs.min, rhs.min), glm::max(lhs.max, rhs.max) };
+	}
+
+	glm::float32 getArea(const Bounds& bounds) noexcept {
+		const glm::vec3 extent = bounds.max - bounds.min;
+
+		return 2 * ((extent.x * extent.z) + (extent.x * extent.y) + (extent.y * extent.z));
+	}
+
+	Bounds boundsOfPrimitive(const GeometryPrimitive& primitive) noexcept {
+		return Bounds{ primitive.getCenter() - glm::vec3(primitive.getRadius()), primitive.getCenter() + glm::vec3(primitive.getRadius()) };
+	}
+
+	Bounds boundsOfNode(const BVHNode& node) noexcept {
+		return Bounds{ node.aabbMin, node.aabbMax };
+	}
+
+	bool isLeaf(const BVHNode& node) noexcept {
+		return (node.left & bvhLeafFlag) != 0;
+	}
+
+	/**
+	 * Store the given bounds on a node: empty bounds are stored as zeros, as WriteAABBOnBLAS_ByIndexes does.
+	 *
+	 * @param node the node
+	 * @param bounds bounds of the node
+	 */
+	void writeBounds(BVHNode& node, const Bounds& bounds) noexcept {
+		node.aabbMin = isEmpty(bounds) ? glm::vec3(0) : bounds.min;
+		node.aabbMax = isEmpty(bounds) ? glm::vec3(0) : bounds.max;
+	}
+}
+
+struct SAHBuilder::ModelBuild {
+	const std::vector<GeometryPrimitive>& primitives;
+
+	BuiltBLAS& blas;
+
+	/**
+	 * The index (in the order geometry has been given) of the geometry stored on each position.
+	 */
+	std::vector<glm::uint32> order;
+
+	glm::uint32 leafsCount;
+};
+
+SAHBuilder::SAHBuilder(const SceneCapacity& capacity, size_t workersCount) noexcept
+	: mCapacity(capacity),
+	mThreadPool(workersCount) {}
+
+void SAHBuilder::build(std::vector<Model>::const_iterator first, std::vector<Model>::const_iterator last, std::vector<BuiltBLAS>& blases) noexcept {
+	blases.resize(size_t(std::distance(first, last)));
+
+	mThreadPool.parallelFor(blases.size(), [this, first, &blases](size_t i) {
+		buildModel((first + i)->primitives, blases[i]);
+	});
+}
+
+void SAHBuilder::buildModel(const std::vector<GeometryPrimitive>& primitives, BuiltBLAS& blas) noexcept {
+	const glm::uint32 geometryCount = glm::uint32(primitives.size());
+	DBG_ASSERT( (geometryCount <= (glm::uint32(1) << (mCapacity.expOfTwo_maxCollectionsForModel + mCapacity.expOfTwo_maxGeometryOnCollection))) );
+	DBG_ASSERT( (mCapacity.expOfTwo_maxCollectionsForModel < maxBLASDepth) );
+
+	const glm::uint32 leafsCount = (geometryCount + (glm::uint32(1) << mCapacity.expOfTwo_maxGeometryOnCollection) - 1) >> mCapacity.expOfTwo_maxGeometryOnCollection;
+
+	blas.geometry.resize(geometryCount);
+	blas.positions.resize(geometryCount);
+
+	if (geometryCount == 0) {
+		// An empty model is just an empty root, that is never traversed
+		blas.nodes.assign(1, BVHNode{ glm::vec3(0), 0, glm::vec3(0), 0 });
+		blas.parents.assign(1, 0);
+		blas.wideNodes.assign(1, WideBVHNode{ glm::vec3(0), 0, { 0, 0, 0 }, { 0, 0, 0 }, 0, 0, { wideBVHNoChild, wideBVHNoChild, wideBVHNoChild, wideBVHNoChild } });
+
+		return;
+	}
+
+	blas.nodes.resize((2 * size_t(leafsCount)) - 1);
+	blas.parents.assign(blas.nodes.size(), 0);
+	blas.wideNodes.resize(std::max<size_t>(leafsCount - 1, 1));
+
+	ModelBuild build = { primitives, blas, std::vector<glm::uint32>(geometryCount), leafsCount };
+	for (glm::uint32 i = 0; i < geometryCount; ++i)
+		build.order[i] = i;
+
+	buildSubtree(build, 0, 0, 0, leafsCount - 1);
+}
+
+void SAHBuilder::buildSubtree(ModelBuild& build, glm::uint32 node, glm::uint32 depth, glm::uint32 firstLeaf, glm::uint32 lastLeaf) noexcept {
+	if (firstLeaf == lastLeaf) {
+		// This is the root of a BLAS with a single leaf
+		emitLeaf(build, firstLeaf);
+		emitWideNode(build, node);
+
+		return;
+	}
+
+	// Each side must still fit a balanced subtree within the levels left below this node
+	DBG_ASSERT( (depth < maxBLASDepth) );
+	const glm::uint32 levelsLeft = maxBLASDepth - depth - 1;
+	const glm::uint32 maxSideLeafsCount = (levelsLeft >= 31) ? std::numeric_limits<glm::uint32>::max() : (glm::uint32(1) << levelsLeft);
+
+	// Children are numbered as emitInternalNode on raytrace.comp numbers them: each internal node is on one end of its range
+	const glm::uint32 split = firstLeaf + splitLeaves(build, maxSideLeafsCount, firstLeaf, lastLeaf) - 1;
+	const glm::uint32 left = (firstLeaf == split) ? (build.leafsCount - 1) + split : split;
+	const glm::uint32 right = (lastLeaf == (split + 1)) ? (build.leafsCount - 1) + split + 1 : split + 1;
+
+	build.blas.parents[left] = node;
+	build.blas.parents[right] = node;
+
+	const auto buildChild = [this, &build, depth](glm::uint32 child, glm::uint32 childFirstLeaf, glm::uint32 childLastLeaf) {
+		if (childFirstLeaf == childLastLeaf) {
+			emitLeaf(build, childFirstLeaf);
+		} else {
+			buildSubtree(build, child, depth + 1, childFirstLeaf, childLastLeaf);
+		}
+	};
+
+	// Geometry of both sides is already in place: the left one can be built by another worker meanwhile
+	if ((size_t(split + 1 - firstLeaf) << mCapacity.expOfTwo_maxGeometryOnCollection) >= parallelSubtreeMinGeometry) {
+		Threading::ThreadPool::TaskGroup group;
+		mThreadPool.run(group, [&buildChild, left, firstLeaf, split]() { buildChild(left, firstLeaf, split); });
+
+		buildChild(right, split + 1, lastLeaf);
+
+		mThreadPool.wait(group);
+	} else {
+		buildChild(left, firstLeaf, split);
+		buildChild(right, split + 1, lastLeaf);
+	}
+
+	BVHNode& internalNode = build.blas.nodes[node];
+	internalNode.left = left;
+	internalNode.right = right;
+	writeBounds(internalNode, join(boundsOfNode(build.blas.nodes[left]), boundsOfNode(build.blas.nodes[right])));
+
+	// The whole subtree is complete: descendants the wide node is collapsed from are ready
+	emitWideNode(build, node);
+}
+
+glm::uint32 SAHBuilder::splitLeaves(ModelBuild& build, glm::uint32 maxSideLeafsCount, glm::uint32 firstLeaf, glm::uint32 lastLeaf) const noexcept {
+	const glm::uint32 leafsCount = lastLeaf - firstLeaf + 1;
+	DBG_ASSERT( (((leafsCount + 1) / 2) <= maxSideLeafsCount) );
+
+	// Skewed splits would make the BLAS too deep: the left side is kept where both sides fit
+	const glm::uint32 minLeftLeafsCount = (leafsCount > maxSideLeafsCount) ? (leafsCount - maxSideLeafsCount) : 1;
+	const glm::uint32 maxLeftLeafsCount = std::min(maxSideLeafsCount, leafsCount - 1);
+
+	const size_t firstGeometry = size_t(firstLeaf) << mCapacity.expOfTwo_maxGeometryOnCollection;
+	const size_t lastGeometry = std::min(build.primitives.size(), size_t(lastLeaf + 1) << mCapacity.expOfTwo_maxGeometryOnCollection);
+
+	glm::vec3 centroidsMin(std::numeric_limits<glm::float32>::max());
+	glm::vec3 centroidsMax(std::numeric_limits<glm::float32>::lowest());
+	for (size_t i = firstGeometry; i < lastGeometry; ++i) {
+		const glm::vec3 centroid = build.primitives[build.order[i]].getCenter();
+
+		centroidsMin = glm::min(centroidsMin, centroid);
+		centroidsMax = glm::max(centroidsMax, centroid);
+	}
+
+	const glm::vec3 centroidsExtent = centroidsMax - centroidsMin;
+
+	// Look for the bin boundary with the lowest cost on any axis, the cost of each side being its area times its geometry
+	glm::float32 bestCost = std::numeric_limits<glm::float32>::max();
+	int bestAxis = -1;
+	size_t bestLeftCount = 0;
+
+	for (int axis = 0; axis < 3; ++axis) {
+		if (!(centroidsExtent[axis] > 0)) continue;
+
+		std::array<size_t, sahBinsCount> binCounts;
+		std::array<Bounds, sahBinsCount> binBounds;
+		binCounts.fill(0);
+		binBounds.fill(emptyBounds);
+
+		const glm::float32 binScale = glm::float32(sahBinsCount) / centroidsExtent[axis];
+		for (size_t i = firstGeometry; i < lastGeometry; ++i) {
+			const GeometryPrimitive& primitive = build.primitives[build.order[i]];
+			const size_t bin = std::min(sahBinsCount - 1, size_t((primitive.getCenter()[axis] - centroidsMin[axis]) * binScale));
+
+			binCounts[bin] += 1;
+			binBounds[bin] = join(binBounds[bin], boundsOfPrimitive(primitive));
+		}
+
+		// Sweep from the right to get the cost of the right side of each boundary, then from the left
+		std::array<glm::float32, sahBinsCount> rightCosts;
+		Bounds rightBounds = emptyBounds;
+		size_t rightCount = 0;
+		for (size_t bin = sahBinsCount - 1; bin > 0; --bin) {
+			rightBounds = join(rightBounds, binBounds[bin]);
+			rightCount += binCounts[bin];
+
+			rightCosts[bin] = getArea(rightBounds) * glm::float32(rightCount);
+		}
+
+		Bounds leftBounds = emptyBounds;
+		size_t leftCount = 0;
+		for (size_t bin = 0; bin < (sahBinsCount - 1); ++bin) {
+			leftBounds = join(leftBounds, binBounds[bin]);
+			leftCount += binCounts[bin];
+
+			const glm::float32 cost = (getArea(leftBounds) * glm::float32(leftCount)) + rightCosts[bin + 1];
+			if ((leftCount > 0) && (leftCount < (lastGeometry - firstGeometry)) && (cost < bestCost)) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestLeftCount = leftCount;
+			}
+		}
+	}
+
+	// Every centroid is on the same point: any split is as good as the others, the median one is never too deep
+	if (bestAxis < 0) return leafsCount / 2;
+
+	// Leaves MUST be full (but the last one): the split is moved to the closest leaf boundary
+	const size_t halfLeaf = (size_t(1) << mCapacity.expOfTwo_maxGeometryOnCollection) >> 1;
+	const glm::uint32 leftLeafsCount = glm::clamp(glm::uint32((bestLeftCount + halfLeaf) >> mCapacity.expOfTwo_maxGeometryOnCollection), minLeftLeafsCount, maxLeftLeafsCount);
+
+	const auto splitGeometry = build.order.begin() + (size_t(firstLeaf + leftLeafsCount) << mCapacity.expOfTwo_maxGeometryOnCollection);
+	std::nth_element(build.order.begin() + firstGeometry, splitGeometry, build.order.begin() + lastGeometry, [&build, bestAxis](glm::uint32 lhs, glm::uint32 rhs) {
+		return build.primitives[lhs].getCenter()[bestAxis] < build.primitives[rhs].getCenter()[bestAxis];
+	});
+
+	return leftLeafsCount;
+}
+
+void SAHBuilder::emitLeaf(ModelBuild& build, glm::uint32 leaf) const noexcept {
+	const glm::uint32 firstGeometry = leaf << mCapacity.expOfTwo_maxGeometryOnCollection;
+	const glm::uint32 geometryCount = std::min(glm::uint32(build.primitives.size()) - firstGeometry, glm::uint32(1) << mCapacity.expOfTwo_maxGeometryOnCollection);
+
+	Bounds bounds = emptyBounds;
+	for (glm::uint32 position = firstGeometry; position < (firstGeometry + geometryCount); ++position) {
+		const glm::uint32 index = build.order[position];
+		const GeometryPrimitive& primitive = build.primitives[index];
+
+		build.blas.geometry[position] = glm::vec4(primitive.getCenter(), primitive.getRadius());
+		build.blas.positions[index] = position;
+
+		bounds = join(bounds, boundsOfPrimitive(primitive));
+	}
+
+	BVHNode& node = build.blas.nodes[(build.leafsCount - 1) + leaf];
+	node.left = bvhLeafFlag | firstGeometry;
+	node.right = geometryCount;
+	writeBounds(node, bounds);
+}
+
+void SAHBuilder::emitWideNode(ModelBuild& build, glm::uint32 node) const noexcept {
+	const std::vector<BVHNode>& nodes = build.blas.nodes;
+	const BVHNode& binaryNode = nodes[node];
+
+	std::array<glm::uint32, wideBVHWidth> children;
+	glm::uint32 childrenCount = 0;
+
+	if (isLeaf(binaryNode)) {
+		// This is the root of a BLAS with a single leaf
+		children[0] = node;
+		childrenCount = 1;
+	} else {
+		// Open every internal child (up to 4 grandchildren): each wide level spans two binary ones, so that traversal stacks stay short
+		for (const glm::uint32 binaryChild : { binaryNode.left, binaryNode.right }) {
+			const BVHNode& childNode = nodes[binaryChild];
+
+			if (isLeaf(childNode)) {
+				children[childrenCount] = binaryChild;
+				childrenCount += 1;
+			} else {
+				children[childrenCount] = childNode.left;
+				children[childrenCount + 1] = childNode.right;
+				childrenCount += 2;
+			}
+		}
+	}
+
+	WideBVHNode wideNode = { binaryNode.aabbMin, 0, { 0, 0, 0 }, { 0, 0, 0 }, 0, 0, { wideBVHNoChild, wideBVHNoChild, wideBVHNoChild, wideBVHNoChild } };
+
+	// The smallest power of two step that covers the whole node with 255 steps, as a biased exponent in [1, 254]
+	const glm::vec3 extent = binaryNode.aabbMax - binaryNode.aabbMin;
+	glm::vec3 step;
+	for (glm::uint32 axis = 0; axis < 3; ++axis) {
+		int exponent = (extent[axis] > 0) ? int(std::ceil(std::log2(extent[axis] / glm::float32(255)))) : -126;
+		if ((std::exp2(glm::float32(exponent)) * glm::float32(255)) < extent[axis]) exponent += 1;
+
+		const glm::uint32 biasedExponent = glm::uint32(glm::clamp(exponent, -126, 127) + 127);
+		wideNode.exponents |= biasedExponent << (8 * axis);
+
+		const glm::uint32 stepBits = biasedExponent << 23;
+		std::memcpy(&step[axis], &stepBits, sizeof(glm::float32));
+	}
+
+	for (glm::uint32 child = 0; child < childrenCount; ++child) {
+		const BVHNode& childNode = nodes[children[child]];
+
+		// Round outwards, so that the quantized AABB contains the original one
+		const glm::vec3 quantizedMin = glm::clamp(glm::floor((childNode.aabbMin - wideNode.origin) / step), glm::vec3(0), glm::vec3(255));
+		const glm::vec3 quantizedMax = glm::clamp(glm::ceil((childNode.aabbMax - wideNode.origin) / step), glm::vec3(0), glm::vec3(255));
+
+		const glm::uint32 shift = 8 * child;
+		for (glm::uint32 axis = 0; axis < 3; ++axis) {
+			wideNode.childMin[axis] |= glm::uint32(quantizedMin[axis]) << shift;
+			wideNode.childMax[axis] |= glm::uint32(quantizedMax[axis]) << shift;
+		}
+
+		if (isLeaf(childNode)) {
+			wideNode.children[child] = childNode.left;
+			wideNode.leafSizes |= (childNode.right - 1) << shift;
+		} else {
+			wideNode.children[child] = children[child];
+		}
+	}
+
+	build.blas.wideNodes[node] = wideNode;
+}
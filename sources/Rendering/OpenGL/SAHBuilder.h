@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Rendering/RenderingPipeline.h"
+
+#include "Rendering/OpenGL/StorageLayout.h"
+
+#include "Threading/ThreadPool.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * This is a BLAS built on the CPU, laid out exactly as BVH_INSERT lays it out on scene buffers (see raytrace.comp),
+			 * so that it can be uploaded as it is: the leaf i holds geometry from i << expOfTwo_maxGeometryOnCollection
+			 * and every leaf but the last one is full, which keeps geometry updates working on the BLAS.
+			 */
+			struct BuiltBLAS {
+				/**
+				 * Nodes of the binary BVH: internal nodes are on [0, leaves - 1), the leaf i is at (leaves - 1) + i.
+				 */
+				std::vector<BVHNode> nodes;
+
+				/**
+				 * Nodes of the wide BVH, each one at the index of the internal node (or the root) it has been collapsed from.
+				 */
+				std::vector<WideBVHNode> wideNodes;
+
+				/**
+				 * Geometry as (center, radius), in the order it is stored.
+				 */
+				std::vector<glm::vec4> geometry;
+
+				/**
+				 * The stored position of each geometry, in the order geometry has been given.
+				 */
+				std::vector<glm::uint32> positions;
+
+				/**
+				 * The parent of each node (the one of the root is meaningless).
+				 */
+				std::vector<glm::uint32> parents;
+			};
+
+			/**
+			 * This is the CPU builder of BLASes: geometry is split with a binned surface area heuristic
+			 * and large subtrees are built in parallel on a thread pool.
+			 *
+			 * BLASes take longer to build than on the GPU (see BLASBuilder), but they are not bound to the order
+			 * geometry is given in nor to a morton curve: this is meant for static models, where traversal is what matters.
+			 *
+			 * Splits are moved towards the median whenever they would make the BLAS deeper than maxBLASDepth.
+			 */
+			class SAHBuilder {
+			public:
+				SAHBuilder() = delete;
+
+				SAHBuilder(const SAHBuilder&) = delete;
+
+				SAHBuilder(SAHBuilder&&) = delete;
+
+				SAHBuilder& operator=(const SAHBuilder&) = delete;
+
+				~SAHBuilder() = default;
+
+				/**
+				 * Spawn the workers of the builder.
+				 *
+				 * @param capacity the scene capacity, as given to the pipeline
+				 * @param workersCount the number of worker threads, 0 means one for each hardware thread
+				 */
+				SAHBuilder(const SceneCapacity& capacity, size_t workersCount = 0) noexcept;
+
+				/**
+				 * Build the BLAS of every given model: models are built in parallel, as well as large subtrees of each model.
+				 *
+				 * @param first the first model to be built
+				 * @param last the model after the last one to be built
+				 * @param blases the BLAS of each model, in the order of models
+				 */
+				void build(std::vector<Model>::const_iterator first, std::vector<Model>::const_iterator last, std::vector<BuiltBLAS>& blases) noexcept;
+
+			private:
+				/**
+				 * This is the state of the BLAS being built for a single model.
+				 */
+				struct ModelBuild;
+
+				/**
+				 * Build the BLAS of a single model.
+				 *
+				 * @param primitives the geometry of the model
+				 * @param blas the built BLAS
+				 */
+				void buildModel(const std::vector<GeometryPrimitive>& primitives, BuiltBLAS& blas) noexcept;
+
+				/**
+				 * Build the subtree over the given range of leaves, splitting geometry on whole leaves.
+				 *
+				 * @param build the model being built
+				 * @param node the node of the subtree root
+				 * @param depth the number of internal nodes above the subtree root
+				 * @param firstLeaf the first leaf of the subtree
+				 * @param lastLeaf the last leaf of the subtree
+				 */
+				void buildSubtree(ModelBuild& build, glm::uint32 node, glm::uint32 depth, glm::uint32 firstLeaf, glm::uint32 lastLeaf) noexcept;
+
+				/**
+				 * Find the number of leaves on the left side of the best split of the given range of leaves,
+				 * reordering geometry of the range so that each side holds its own geometry.
+				 *
+				 * @param build the model being built
+				 * @param maxSideLeafsCount the maximum number of leaves on each side, for both sides to fit the remaining depth
+				 * @param firstLeaf the first leaf of the range
+				 * @param lastLeaf the last leaf of the range
+				 * @return the number of leaves on the left side, in [1, lastLeaf - firstLeaf]
+				 */
+				glm::uint32 splitLeaves(ModelBuild& build, glm::uint32 maxSideLeafsCount, glm::uint32 firstLeaf, glm::uint32 lastLeaf) const noexcept;
+
+				/**
+				 * Store the geometry of the given leaf and emit the leaf node.
+				 *
+				 * @param build the model being built, whose geometry is already ordered
+				 * @param leaf the leaf
+				 */
+				void emitLeaf(ModelBuild& build, glm::uint32 leaf) const noexcept;
+
+				/**
+				 * Collapse the given node together with its children and grandchildren on a wide node, as emitWideNode on raytrace.comp does.
+				 *
+				 * @param build the model being built, whose subtree below the node is complete
+				 * @param node the internal node (or the root)
+				 */
+				void emitWideNode(ModelBuild& build, glm::uint32 node) const noexcept;
+
+				const SceneCapacity mCapacity;
+
+				Threading::ThreadPool mThreadPool;
+			};
+		}
+	}
+}
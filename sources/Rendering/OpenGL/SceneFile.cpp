@@ -0,0 +1,163 @@
+#include "Rendering/OpenGL/SceneFile.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::OpenGL;
+
+SceneFile::SceneFile(const std::string& path) noexcept
+	: mMapping(nullptr),
+	mSize(0),
+	mValid(false),
+#if defined(_WIN32)
+	mFile(INVALID_HANDLE_VALUE),
+	mFileMapping(NULL) {
+	mFile = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (mFile == INVALID_HANDLE_VALUE) return;
+
+	LARGE_INTEGER fileSize;
+	if ((!GetFileSizeEx(mFile, &fileSize)) || (size_t(fileSize.QuadPart) < sizeof(SceneFileHeader))) return;
+	mSize = size_t(fileSize.QuadPart);
+
+	mFileMapping = CreateFileMappingA(mFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mFileMapping == NULL) return;
+
+	mMapping = reinterpret_cast<const glm::uint8*>(MapViewOfFile(mFileMapping, FILE_MAP_READ, 0, 0, 0));
+	if (mMapping == nullptr) return;
+#else
+	mFile(-1) {
+	mFile = open(path.c_str(), O_RDONLY);
+	if (mFile < 0) return;
+
+	struct stat fileStatus;
+	if ((fstat(mFile, &fileStatus) != 0) || (size_t(fileStatus.st_size) < sizeof(SceneFileHeader))) return;
+	mSize = size_t(fileStatus.st_size);
+
+	void* mapping = mmap(nullptr, mSize, PROT_READ, MAP_PRIVATE, mFile, 0);
+	if (mapping == MAP_FAILED) return;
+	mMapping = reinterpret_cast<const glm::uint8*>(mapping);
+
+	// Sections are read once from the beginning to the end: let the kernel read ahead
+	posix_madvise(mapping, mSize, POSIX_MADV_SEQUENTIAL);
+#endif
+
+	const SceneFileHeader& header = *reinterpret_cast<const SceneFileHeader*>(mMapping);
+	if ((std::memcmp(header.magic, sceneFileMagic, sizeof(sceneFileMagic)) != 0) || (header.version != sceneFileVersion)) return;
+
+	for (const auto& section : header.sections)
+		if ((section[0] > mSize) || (section[1] > (mSize - section[0]))) return;
+
+	mValid = true;
+}
+
+SceneFile::~SceneFile() {
+#if defined(_WIN32)
+	if (mMapping != nullptr) UnmapViewOfFile(mMapping);
+	if (mFileMapping != NULL) CloseHandle(mFileMapping);
+	if (mFile != INVALID_HANDLE_VALUE) CloseHandle(mFile);
+#else
+	if (mMapping != nullptr) munmap(const_cast<glm::uint8*>(mMapping), mSize);
+	if (mFile >= 0) close(mFile);
+#endif
+}
+
+bool SceneFile::isValid() const noexcept {
+	return mValid;
+}
+
+SceneCapacity SceneFile::getCapacity() const noexcept {
+	DBG_ASSERT( (mValid) );
+
+	const SceneFileHeader& header = *reinterpret_cast<const SceneFileHeader*>(mMapping);
+
+	return SceneCapacity(header.expOfTwo_maxModels, header.expOfTwo_maxCollectionsForModel, header.expOfTwo_maxGeometryOnCollection, header.expOfTwo_maxResidentModels);
+}
+
+const void* SceneFile::getSection(SceneFileSection section, size_t& size) const noexcept {
+	DBG_ASSERT( (section < SceneFileSection::Count) );
+
+	size = 0;
+	if (!mValid) return nullptr;
+
+	const SceneFileHeader& header = *reinterpret_cast<const SceneFileHeader*>(mMapping);
+	size = size_t(header.sections[size_t(section)][1]);
+
+	return mMapping + header.sections[size_t(section)][0];
+}
+
+SceneFileWriter::SceneFileWriter(const std::string& path, const SceneCapacity& capacity) noexcept
+	: mPath(path),
+	mTemporaryPath(path + ".tmp"),
+	mFile(mTemporaryPath, std::ios::out | std::ios::binary | std::ios::trunc),
+	mSection(SceneFileSection::Count),
+	mFinished(false) {
+	std::memset(&mHeader, 0, sizeof(SceneFileHeader));
+	std::memcpy(mHeader.magic, sceneFileMagic, sizeof(sceneFileMagic));
+	mHeader.version = sceneFileVersion;
+	mHeader.expOfTwo_maxModels = capacity.expOfTwo_maxModels;
+	mHeader.expOfTwo_maxCollectionsForModel = capacity.expOfTwo_maxCollectionsForModel;
+	mHeader.expOfTwo_maxGeometryOnCollection = capacity.expOfTwo_maxGeometryOnCollection;
+	mHeader.expOfTwo_maxResidentModels = capacity.expOfTwo_maxResidentModels;
+
+	// The header is written last, when offsets of sections are known
+	mFile.write(reinterpret_cast<const char*>(&mHeader), sizeof(SceneFileHeader));
+}
+
+SceneFileWriter::~SceneFileWriter() {
+	if (mFinished) return;
+
+	mFile.close();
+	std::remove(mTemporaryPath.c_str());
+}
+
+void SceneFileWriter::beginSection(SceneFileSection section) noexcept {
+	DBG_ASSERT( (section < SceneFileSection::Count) );
+	DBG_ASSERT( (mHeader.sections[size_t(section)][0] == 0) );
+
+	endSection();
+
+	// A failed file is only reported by finish()
+	if (mFile.fail()) return;
+
+	// Pad up to the next page boundary
+	const glm::uint64 position = glm::uint64(mFile.tellp());
+	const glm::uint64 offset = ((position + sceneFileSectionAlignment - 1) / sceneFileSectionAlignment) * sceneFileSectionAlignment;
+	const std::vector<char> padding(size_t(offset - position), 0);
+	mFile.write(padding.data(), std::streamsize(padding.size()));
+
+	mSection = section;
+	mHeader.sections[size_t(section)][0] = offset;
+}
+
+void SceneFileWriter::write(const void* data, size_t size) noexcept {
+	if (mFile.fail()) return;
+
+	DBG_ASSERT( (mSection != SceneFileSection::Count) );
+
+	mFile.write(reinterpret_cast<const char*>(data), std::streamsize(size));
+}
+
+void SceneFileWriter::endSection() noexcept {
+	if ((mSection == SceneFileSection::Count) || (mFile.fail())) return;
+
+	mHeader.sections[size_t(mSection)][1] = glm::uint64(mFile.tellp()) - mHeader.sections[size_t(mSection)][0];
+	mSection = SceneFileSection::Count;
+}
+
+bool SceneFileWriter::finish() noexcept {
+	DBG_ASSERT( (!mFinished) );
+
+	endSection();
+
+	mFile.seekp(0);
+	mFile.write(reinterpret_cast<const char*>(&mHeader), sizeof(SceneFileHeader));
+	mFile.close();
+
+#if defined(_WIN32)
+	// Renaming does not replace an existing file on Windows
+	std::remove(mPath.c_str());
+#endif
+	if ((mFile.fail()) || (std::rename(mTemporaryPath.c_str(), mPath.c_str()) != 0)) return false;
+
+	mFinished = true;
+	return true;
+}
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "Rendering/RenderingPipeline.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * These are sections of a scene file: each one is the whole content of a GPU buffer of OpenGLPipeline,
+			 * except ModelGeometryCount that holds the number of geometry primitives of each model (as uint32).
+			 */
+			enum class SceneFileSection : glm::uint32 {
+				TLAS = 0,
+				BLASNodes = 1,
+				WideBLASNodes = 2,
+				Geometry = 3,
+				ModelMatrices = 4,
+				BLASLinks = 5,
+				ModelGeometryCount = 6,
+				ModelResidency = 7,
+				Count = 8,
+			};
+
+			/**
+			 * This is the header at the beginning of a scene file.
+			 *
+			 * Sections follow the header, each one at an offset multiple of sceneFileSectionAlignment,
+			 * and they are stored exactly as the GPU expects them (little endian, std430 layout):
+			 * a scene is loaded by copying sections to buffers, without parsing or building anything.
+			 */
+			struct SceneFileHeader {
+				/**
+				 * This is sceneFileMagic.
+				 */
+				char magic[8];
+
+				/**
+				 * This is sceneFileVersion: it changes whenever the GPU layout of the scene changes.
+				 */
+				glm::uint32 version;
+
+				/**
+				 * The capacity of the pipeline the scene has been exported from, as in SceneCapacity.
+				 */
+				glm::uint32 expOfTwo_maxModels;
+
+				glm::uint32 expOfTwo_maxCollectionsForModel;
+
+				glm::uint32 expOfTwo_maxGeometryOnCollection;
+
+				glm::uint32 expOfTwo_maxResidentModels;
+
+				glm::uint32 padding;
+
+				/**
+				 * The offset and the size in bytes of each section, in order of SceneFileSection.
+				 */
+				glm::uint64 sections[size_t(SceneFileSection::Count)][2];
+			};
+
+			static_assert( (sizeof(SceneFileHeader) == (32 + (16 * size_t(SceneFileSection::Count)))), "SceneFileHeader must not be padded");
+
+			constexpr char sceneFileMagic[8] = { 'T', 'A', 'C', 'H', 'Y', 'O', 'N', 'S' };
+
+			constexpr glm::uint32 sceneFileVersion = 2;
+
+			/**
+			 * Sections start on page boundaries, so that each one is mapped on its own pages.
+			 */
+			constexpr glm::uint64 sceneFileSectionAlignment = 4096;
+
+			/**
+			 * This is a scene file mapped in memory for reading: sections are read directly from the mapping,
+			 * so that loading a scene costs nothing more than reading the file.
+			 */
+			class SceneFile {
+			public:
+				SceneFile() = delete;
+
+				SceneFile(const SceneFile&) = delete;
+
+				SceneFile(SceneFile&&) = delete;
+
+				SceneFile& operator=(const SceneFile&) = delete;
+
+				~SceneFile();
+
+				/**
+				 * Map the given scene file and check its header.
+				 *
+				 * @param path the scene file
+				 */
+				SceneFile(const std::string& path) noexcept;
+
+				/**
+				 * Check if the file has been mapped and it is a scene file of the current version,
+				 * with every section within the file.
+				 *
+				 * @return TRUE if sections can be read
+				 */
+				bool isValid() const noexcept;
+
+				/**
+				 * Get the capacity of the pipeline the scene has been exported from:
+				 * the scene can only be loaded on a pipeline created with the same capacity.
+				 *
+				 * @return the scene capacity
+				 */
+				SceneCapacity getCapacity() const noexcept;
+
+				/**
+				 * Get the mapped content of a section.
+				 *
+				 * @param section the section
+				 * @param size the size of the section in bytes
+				 * @return the first byte of the section, nullptr if the file is not valid
+				 */
+				const void* getSection(SceneFileSection section, size_t& size) const noexcept;
+
+			private:
+				const glm::uint8* mMapping;
+
+				size_t mSize;
+
+				bool mValid;
+
+#if defined(_WIN32)
+				HANDLE mFile;
+
+				HANDLE mFileMapping;
+#else
+				int mFile;
+#endif
+			};
+
+			/**
+			 * This writes a scene file one section after the other.
+			 *
+			 * The file is written under a temporary name and renamed on finish(),
+			 * so that an interrupted export never leaves a truncated scene behind.
+			 */
+			class SceneFileWriter {
+			public:
+				SceneFileWriter() = delete;
+
+				SceneFileWriter(const SceneFileWriter&) = delete;
+
+				SceneFileWriter(SceneFileWriter&&) = delete;
+
+				SceneFileWriter& operator=(const SceneFileWriter&) = delete;
+
+				/**
+				 * Remove the temporary file if finish() has not been called.
+				 */
+				~SceneFileWriter();
+
+				/**
+				 * Create the temporary file of the scene.
+				 *
+				 * @param path the scene file to be written
+				 * @param capacity the capacity of the pipeline the scene is exported from
+				 */
+				SceneFileWriter(const std::string& path, const SceneCapacity& capacity) noexcept;
+
+				/**
+				 * Start a new section: sections can be written in any order, but only once.
+				 *
+				 * @param section the section written by subsequent calls to write
+				 */
+				void beginSection(SceneFileSection section) noexcept;
+
+				/**
+				 * Append data to the current section.
+				 *
+				 * @param data the data to be written
+				 * @param size the size of data in bytes
+				 */
+				void write(const void* data, size_t size) noexcept;
+
+				/**
+				 * Write the header and move the file to its path.
+				 *
+				 * @return TRUE on success
+				 */
+				bool finish() noexcept;
+
+			private:
+				void endSection() noexcept;
+
+				std::string mPath;
+
+				std::string mTemporaryPath;
+
+				std::ofstream mFile;
+
+				SceneFileHeader mHeader;
+
+				/**
+				 * The section being written, SceneFileSection::Count if none.
+				 */
+				SceneFileSection mSection;
+
+				bool mFinished;
+			};
+		}
+	}
+}
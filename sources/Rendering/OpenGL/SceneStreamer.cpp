@@ -0,0 +1,182 @@
+#include "Rendering/OpenGL/SceneStreamer.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::OpenGL;
+
+namespace {
+	/**
+	 * The minimum size of the ring buffer the worker uploads models through.
+	 */
+	constexpr size_t streamingUploadBufferMinSize = size_t(16) << 20;
+
+	/**
+	 * How long wait() blocks on a fence before checking it again, in nanoseconds.
+	 */
+	constexpr GLuint64 fenceWaitTimeout = 1000000;
+}
+
+SceneStreamer::SceneStreamer(OpenGLPipeline& pipeline, GLFWwindow* window) noexcept
+	: mPipeline(pipeline),
+	mWorkerWindow(nullptr),
+	mBuildingModelsCount(0),
+	mStopping(false) {
+	// The worker context never presents anything: it only shares objects with the pipeline one (hints of the pipeline context are kept)
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	mWorkerWindow = glfwCreateWindow(1, 1, "Tachyon Streamer", nullptr, window);
+	DBG_ASSERT( (mWorkerWindow != nullptr) );
+
+	// Hints are process-wide: windows created later by the application are visible again, as GLFW makes them by default
+	glfwWindowHint(GLFW_VISIBLE, GLFW_TRUE);
+
+	mWorker = std::thread(&SceneStreamer::work, this);
+}
+
+SceneStreamer::~SceneStreamer() {
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mStopping = true;
+	}
+	mCondition.notify_all();
+
+	if (mWorker.joinable()) mWorker.join();
+
+	// Sync objects are shared: those the worker has created can be deleted here
+	for (const auto& built : mBuiltModels)
+		glDeleteSync(built.fence);
+
+	if (mWorkerWindow != nullptr) glfwDestroyWindow(mWorkerWindow);
+}
+
+void SceneStreamer::enqueueModel(std::vector<GeometryPrimitive>&& primitives, GLuint location) noexcept {
+	std::vector<Model> models;
+	models.push_back(Model{ std::move(primitives), location });
+
+	enqueueModels(std::move(models));
+}
+
+void SceneStreamer::enqueueModels(std::vector<Model>&& models) noexcept {
+	// BLASes belong to the pipeline: the worker is only told which ones to write
+	std::vector<GLuint> blases;
+	mPipeline.acquireModelBLASes(models, blases);
+
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mEnqueuedModels.insert(mEnqueuedModels.end(), std::make_move_iterator(models.begin()), std::make_move_iterator(models.end()));
+		mEnqueuedBLASes.insert(mEnqueuedBLASes.end(), blases.cbegin(), blases.cend());
+	}
+
+	mCondition.notify_all();
+}
+
+std::vector<GLuint> SceneStreamer::publish() noexcept {
+	return publishBuiltModels(false);
+}
+
+std::vector<GLuint> SceneStreamer::wait() noexcept {
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mCondition.wait(lock, [this] { return (mEnqueuedModels.empty()) && (mBuildingModelsCount == 0); });
+	}
+
+	return publishBuiltModels(true);
+}
+
+size_t SceneStreamer::getPendingModelsCount() const noexcept {
+	std::unique_lock<std::mutex> lock(mMutex);
+
+	size_t pendingModelsCount = mEnqueuedModels.size() + mBuildingModelsCount;
+	for (const auto& built : mBuiltModels)
+		pendingModelsCount += built.models.size();
+
+	return pendingModelsCount;
+}
+
+std::vector<GLuint> SceneStreamer::publishBuiltModels(bool wait) noexcept {
+	std::vector<std::pair<GLuint, glm::uint32>> models;
+
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+
+		// Groups are built in order, so they complete in order too
+		while (!mBuiltModels.empty()) {
+			const BuiltModels& built = mBuiltModels.front();
+
+			// The worker has flushed the fence: there is no need to flush here
+			GLenum status = glClientWaitSync(built.fence, 0, 0);
+			while ((wait) && (status == GL_TIMEOUT_EXPIRED))
+				status = glClientWaitSync(built.fence, 0, fenceWaitTimeout);
+
+			if ((status != GL_ALREADY_SIGNALED) && (status != GL_CONDITION_SATISFIED)) break;
+
+			models.insert(models.end(), built.models.cbegin(), built.models.cend());
+
+			glDeleteSync(built.fence);
+			mBuiltModels.pop_front();
+		}
+	}
+
+	std::vector<GLuint> locations;
+	if (models.empty()) return locations;
+
+	mPipeline.commitStreamedModels(models);
+
+	locations.reserve(models.size());
+	for (const auto& model : models)
+		locations.push_back(model.first);
+
+	return locations;
+}
+
+void SceneStreamer::work() noexcept {
+	if (mWorkerWindow == nullptr) return;
+
+	glfwMakeContextCurrent(mWorkerWindow);
+
+	{
+		// The builder program, its memory and the upload buffer belong to the worker: only the scene is shared
+		BLASBuilder builder(mPipeline.getCapacity());
+
+		GLint storageBufferOffsetAlignment = 0;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageBufferOffsetAlignment);
+		StreamingBuffer uploadBuffer(std::max(streamingUploadBufferMinSize, 2 * builder.getMaxModelUploadSize(size_t(storageBufferOffsetAlignment))), size_t(storageBufferOffsetAlignment));
+
+		// Bindings are not shared between contexts
+		mPipeline.bindSceneBuffers();
+
+		std::unique_lock<std::mutex> lock(mMutex);
+		while (true) {
+			mCondition.wait(lock, [this] { return (mStopping) || (!mEnqueuedModels.empty()); });
+			if (mStopping) break;
+
+			// Every model enqueued so far is built by the same dispatches
+			std::vector<Model> models;
+			models.swap(mEnqueuedModels);
+			std::vector<GLuint> blases;
+			blases.swap(mEnqueuedBLASes);
+			mBuildingModelsCount = models.size();
+
+			lock.unlock();
+
+			builder.build(uploadBuffer, models.cbegin(), models.cend(), blases.cbegin(), nullptr);
+
+			BuiltModels built;
+			built.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			built.models.reserve(models.size());
+			for (const auto& model : models)
+				built.models.push_back(std::make_pair(model.location, glm::uint32(model.primitives.size())));
+
+			// The fence is only ever signaled once it has been sent to the GPU, and no other context can send it
+			glFlush();
+
+			lock.lock();
+
+			mBuildingModelsCount = 0;
+			mBuiltModels.push_back(std::move(built));
+
+			mCondition.notify_all();
+		}
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
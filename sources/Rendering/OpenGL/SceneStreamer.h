@@ -0,0 +1,152 @@
+#pragma once
+
+#include "Rendering/OpenGL/OpenGLPipeline.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * This is the background loader of models: BLASes are uploaded and built by a worker thread
+			 * on its own GL context, shared with the one of the pipeline, so that the render loop never waits for them.
+			 *
+			 * A built model is published to the pipeline by publish() only once the fence placed after its build
+			 * has signaled: until then its TLAS leaf is left as it is and frames render the scene without it.
+			 *
+			 * Usage: create the streamer on the main thread (GLFW creates windows there only) after the pipeline,
+			 *        enqueue models and call publish() on the render thread before each frame.
+			 *        Locations being streamed MUST be empty and left untouched (not removed, updated, moved, flushed or reset)
+			 *        until their model has been published: a streamed model is placed with the identity and can be moved from then on.
+			 */
+			class SceneStreamer {
+			public:
+				SceneStreamer() = delete;
+
+				SceneStreamer(const SceneStreamer&) = delete;
+
+				SceneStreamer(SceneStreamer&&) = delete;
+
+				SceneStreamer& operator=(const SceneStreamer&) = delete;
+
+				/**
+				 * Stop the worker thread (models not built yet are dropped) and destroy its context:
+				 * this MUST be called on the main thread, before the pipeline is destroyed.
+				 */
+				~SceneStreamer();
+
+				/**
+				 * Create the worker context and start the worker thread.
+				 *
+				 * @param pipeline the pipeline models are streamed to
+				 * @param window the window owning the context of the pipeline
+				 */
+				SceneStreamer(OpenGLPipeline& pipeline, GLFWwindow* window) noexcept;
+
+				/**
+				 * Schedule the build of a model: it MUST be called on the render thread, as the BLAS of the model
+				 * is taken from the pipeline right away (the model is dropped if every BLAS is taken).
+				 *
+				 * @param primitives the geometry of the model
+				 * @param location the location (BLAS) where the model is stored
+				 */
+				void enqueueModel(std::vector<GeometryPrimitive>&& primitives, GLuint location) noexcept;
+
+				/**
+				 * Schedule the build of many models at once: models enqueued together are built by the same dispatches.
+				 *
+				 * @param models the models to be placed
+				 */
+				void enqueueModels(std::vector<Model>&& models) noexcept;
+
+				/**
+				 * Hand models whose build has completed on the GPU to the pipeline, without ever waiting:
+				 * this MUST be called on the render thread, with the pipeline context current.
+				 *
+				 * @return locations of published models
+				 */
+				std::vector<GLuint> publish() noexcept;
+
+				/**
+				 * Wait for every enqueued model to be built and publish it (see publish()).
+				 *
+				 * @return locations of published models
+				 */
+				std::vector<GLuint> wait() noexcept;
+
+				/**
+				 * Get the number of models enqueued and not published yet.
+				 *
+				 * @return the number of pending models
+				 */
+				size_t getPendingModelsCount() const noexcept;
+
+			private:
+				/**
+				 * This is a group of models built by the worker, waiting for the GPU to complete.
+				 */
+				struct BuiltModels {
+					/**
+					 * The location and the number of geometry primitives of each model.
+					 */
+					std::vector<std::pair<GLuint, glm::uint32>> models;
+
+					/**
+					 * This is signaled once every model has been built.
+					 */
+					GLsync fence;
+				};
+
+				/**
+				 * Build enqueued models on the worker context until the streamer is destroyed.
+				 */
+				void work() noexcept;
+
+				/**
+				 * Publish built models from the oldest ones.
+				 *
+				 * @param wait TRUE to wait for the GPU, FALSE to stop at the first group not completed yet
+				 * @return locations of published models
+				 */
+				std::vector<GLuint> publishBuiltModels(bool wait) noexcept;
+
+				OpenGLPipeline& mPipeline;
+
+				/**
+				 * This is the hidden window owning the worker context.
+				 */
+				GLFWwindow* mWorkerWindow;
+
+				mutable std::mutex mMutex;
+
+				/**
+				 * This is notified whenever models are enqueued, built or the streamer is being destroyed.
+				 */
+				std::condition_variable mCondition;
+
+				/**
+				 * Models enqueued and not taken by the worker yet.
+				 */
+				std::vector<Model> mEnqueuedModels;
+
+				/**
+				 * The BLAS each enqueued model is built on, in the order of mEnqueuedModels.
+				 */
+				std::vector<GLuint> mEnqueuedBLASes;
+
+				/**
+				 * The number of models taken by the worker and not built yet.
+				 */
+				size_t mBuildingModelsCount;
+
+				/**
+				 * Models built by the worker, from the oldest ones.
+				 */
+				std::deque<BuiltModels> mBuiltModels;
+
+				bool mStopping;
+
+				std::thread mWorker;
+			};
+		}
+	}
+}
@@ -0,0 +1,279 @@
+#pragma once
+
+#include "Tachyon.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * This flag is set on the left field of leaf BVH nodes.
+			 */
+			constexpr glm::uint32 bvhLeafFlag = 0x80000000u;
+
+			/**
+			 * The maximum number of internal nodes on the path from the root of a BLAS to any of its leaves:
+			 * every BLAS builder MUST honor it, as traversal stacks on raytrace.comp are specialized with it (see maxBLASDepth there).
+			 */
+			constexpr glm::uint32 maxBLASDepth = 48;
+
+			/**
+			 * This is a BVH node as stored on the GPU: it MUST match BVHNode in raytrace.comp (std430 layout).
+			 *
+			 * An empty node has both vertices set to zero.
+			 */
+			struct BVHNode {
+				glm::vec3 aabbMin;
+
+				/**
+				 * For internal nodes this is the index of the left child,
+				 * for leaves this is bvhLeafFlag | the index of the first geometry.
+				 */
+				glm::uint32 left;
+
+				glm::vec3 aabbMax;
+
+				/**
+				 * For internal nodes this is the index of the right child,
+				 * for leaves this is the number of geometry.
+				 */
+				glm::uint32 right;
+			};
+
+			static_assert( (sizeof(BVHNode) == 32), "BVHNode not matching input GLSL");
+
+			/**
+			 * This is a node of the wide BVH every BLAS is collapsed to: it MUST match WideBVHNode in raytrace.comp (std430 layout).
+			 *
+			 * Each field holding per-child bytes stores the child i on the byte i, from the least significant one.
+			 */
+			struct WideBVHNode {
+				/**
+				 * The position vertex of the AABB of the node.
+				 */
+				glm::vec3 origin;
+
+				/**
+				 * The biased exponent (as in a float) of the quantization step on x, y and z.
+				 */
+				glm::uint32 exponents;
+
+				/**
+				 * Children AABBs as multiples of the quantization step from the origin.
+				 */
+				glm::uint32 childMin[3];
+
+				glm::uint32 childMax[3];
+
+				/**
+				 * The number of geometry minus one, for each leaf child.
+				 */
+				glm::uint32 leafSizes;
+
+				glm::uint32 padding;
+
+				/**
+				 * For internal children this is the index of the wide node,
+				 * for leaves this is bvhLeafFlag | the index of the first geometry.
+				 */
+				glm::uint32 children[4];
+			};
+
+			static_assert( (sizeof(WideBVHNode) == 64), "WideBVHNode not matching input GLSL");
+
+			/**
+			 * This is the transformation of a model as stored on the GPU: it MUST match ModelMatrices in raytrace.comp (std430 layout).
+			 *
+			 * An empty model (one that has not been inserted) has both matrices set to zero.
+			 */
+			struct ModelMatrices {
+				/**
+				 * Transforms from the model space to the world space.
+				 */
+				glm::mat4 model;
+
+				/**
+				 * Transforms from the world space to the model space.
+				 */
+				glm::mat4 inverseModel;
+			};
+
+			static_assert( (sizeof(ModelMatrices) == (2 * sizeof(glm::mat4))), "ModelMatrices not matching input GLSL");
+
+			/**
+			 * This describes one of the models inserted by a single dispatch of the BLAS builder:
+			 * it MUST match InsertionBatch in raytrace.comp (std430 layout).
+			 */
+			struct InsertionBatch {
+				/**
+				 * The BLAS where the model is stored.
+				 */
+				glm::uint32 targetBLAS;
+
+				/**
+				 * The index of the first geometry of the model among all the geometry uploaded for the dispatch.
+				 */
+				glm::uint32 geometryOffset;
+
+				glm::uint32 geometryCount;
+
+				/**
+				 * The location (TLAS leaf) of the model: its transformation is reset to the identity.
+				 */
+				glm::uint32 location;
+
+				/**
+				 * The minimum of geometry centers (xyz).
+				 */
+				glm::vec4 centroidsMin;
+
+				/**
+				 * The inverse of the extent of geometry centers (xyz, zero on flat axes).
+				 */
+				glm::vec4 centroidsInvExtent;
+			};
+
+			static_assert( (sizeof(InsertionBatch) == 48), "InsertionBatch not matching input GLSL");
+
+			/**
+			 * This marks a location without a BLAS: only the proxy of its model (if any) is on the TLAS.
+			 */
+			constexpr glm::uint32 nonResidentBLAS = 0xFFFFFFFFu;
+
+			/**
+			 * This flag of a location keeps its model out of the way of every ray: the TLAS leaf is left empty,
+			 * while the model keeps its BLAS. It MUST match INSTANCE_HIDDEN in raytrace.comp.
+			 */
+			constexpr glm::uint32 instanceFlagHidden = 0x00000001u;
+
+			/**
+			 * This flag of a location keeps its model out of the way of occlusion rays (shadow rays and RayQueryType::Occlusion):
+			 * it MUST match INSTANCE_NO_SHADOWS in raytrace.comp.
+			 */
+			constexpr glm::uint32 instanceFlagNoShadows = 0x00000002u;
+
+			/**
+			 * This is where the model of a location is stored: it MUST match ModelResidency in raytrace.comp (std430 layout).
+			 *
+			 * This is the instance table of the scene: many locations can refer to the same BLAS, each one with its own transformation and flags.
+			 *
+			 * The layout is the one of BVHNode, so that the root of a BLAS can be copied on the proxy of its model (flags excluded).
+			 */
+			struct ModelResidency {
+				/**
+				 * The model space AABB of the model while it is not resident.
+				 */
+				glm::vec3 proxyMin;
+
+				/**
+				 * The BLAS storing the model, nonResidentBLAS when only its proxy is on the TLAS.
+				 */
+				glm::uint32 blas;
+
+				glm::vec3 proxyMax;
+
+				/**
+				 * The instanceFlag* flags of the location.
+				 */
+				glm::uint32 flags;
+			};
+
+			static_assert( (sizeof(ModelResidency) == sizeof(BVHNode)), "ModelResidency not matching input GLSL");
+
+			/**
+			 * This is the new transformation of a model as consumed by the TLAS update program:
+			 * it MUST match TransformUpdate in raytrace.comp (std430 layout).
+			 */
+			struct TransformUpdate {
+				ModelMatrices matrices;
+
+				/**
+				 * The model (BLAS) to be moved.
+				 */
+				glm::uint32 location;
+
+				glm::uint32 padding[3];
+			};
+
+			static_assert( (sizeof(TransformUpdate) == (sizeof(ModelMatrices) + 16)), "TransformUpdate not matching input GLSL");
+
+			/**
+			 * This describes the new geometry of a range of a model: it MUST match GeometryUpdate in raytrace.comp (std430 layout).
+			 */
+			struct GeometryUpdate {
+				glm::uint32 targetBLAS;
+
+				/**
+				 * The index of the first replaced geometry, in the order geometry has been given to the BLAS.
+				 */
+				glm::uint32 firstGeometry;
+
+				/**
+				 * The index of the first new geometry on the uploaded geometry.
+				 */
+				glm::uint32 geometryOffset;
+
+				glm::uint32 geometryCount;
+
+				/**
+				 * The number of geometry of the whole model.
+				 */
+				glm::uint32 modelGeometryCount;
+
+				glm::uint32 padding[3];
+			};
+
+			static_assert( (sizeof(GeometryUpdate) == 32), "GeometryUpdate not matching input GLSL");
+
+			/**
+			 * These are the constants of a rendered frame: this MUST match renderConstants in raytrace.comp (std140 layout).
+			 *
+			 * Every vec3 is followed by a scalar, as std140 aligns vec3 to 16 bytes.
+			 */
+			struct RenderConstants {
+				glm::vec3 cameraPosition;
+
+				/**
+				 * The vertical field of view in degrees.
+				 */
+				glm::float32 cameraFoV;
+
+				glm::vec3 cameraViewDir;
+
+				glm::float32 cameraAspect;
+
+				glm::vec3 cameraUpVector;
+
+				glm::uint32 width;
+
+				glm::vec3 lightDirection;
+
+				glm::uint32 height;
+
+				glm::vec2 sampleJitter;
+
+				glm::uint32 accumulatedSamples;
+
+				glm::uint32 keepAccumulation;
+
+				glm::uint32 persistentThreads;
+
+				glm::uint32 collectTraversalStatistics;
+
+				glm::uint32 shadingMode;
+
+				glm::uint32 outputFormat;
+
+				glm::float32 gamma;
+
+				glm::float32 exposure;
+
+				glm::uint32 collectResidencyFeedback;
+
+				glm::uint32 padding;
+			};
+
+			static_assert( (sizeof(RenderConstants) == 112), "RenderConstants not matching input GLSL");
+		}
+	}
+}
@@ -0,0 +1,105 @@
+#include "Rendering/OpenGL/StreamingBuffer.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Rendering::OpenGL;
+
+StreamingBuffer::StreamingBuffer(size_t size, size_t alignment) noexcept
+	: mBuffer(0),
+	mSize(size),
+	mAlignment(std::max<size_t>(alignment, 1)),
+	mMapping(nullptr),
+	mHead(0),
+	mPendingBegin(0),
+	mPendingEnd(0) {
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &mBuffer);
+	glNamedBufferStorage(mBuffer, mSize, NULL, flags);
+	mMapping = reinterpret_cast<glm::uint8*>(glMapNamedBufferRange(mBuffer, 0, mSize, flags));
+
+	DBG_ASSERT( (mMapping != nullptr) );
+}
+
+StreamingBuffer::~StreamingBuffer() {
+	for (const auto& region : mFencedRegions)
+		glDeleteSync(region.fence);
+
+	glUnmapNamedBuffer(mBuffer);
+	glDeleteBuffers(1, &mBuffer);
+}
+
+GLuint StreamingBuffer::getBuffer() const noexcept {
+	return mBuffer;
+}
+
+size_t StreamingBuffer::getSize() const noexcept {
+	return mSize;
+}
+
+size_t StreamingBuffer::getAlignment() const noexcept {
+	return mAlignment;
+}
+
+StreamingBuffer::Allocation StreamingBuffer::allocate(size_t size) noexcept {
+	DBG_ASSERT( (size <= mSize) );
+
+	size_t begin = ((mHead + mAlignment - 1) / mAlignment) * mAlignment;
+
+	// Restart from the beginning of the buffer: what has been allocated so far is still pending,
+	// as commands reading it may not have been issued yet, and it is fenced together with the new allocations
+	if ((begin + size) > mSize) {
+		DBG_ASSERT( (mPendingEnd == 0) );
+
+		if (mHead != mPendingBegin) {
+			mPendingEnd = mHead;
+		} else {
+			mPendingBegin = 0;
+		}
+
+		begin = 0;
+	}
+
+	// Pending allocations are not fenced yet: they MUST never be overwritten (see the usage note on the header)
+	DBG_ASSERT( ((mPendingEnd == 0) || ((begin + size) <= mPendingBegin)) );
+
+	waitForRange(begin, begin + size);
+
+	mHead = begin + size;
+
+	return Allocation{ mMapping + begin, GLintptr(begin), GLsizeiptr(size) };
+}
+
+void StreamingBuffer::fence() noexcept {
+	if ((mHead == mPendingBegin) && (mPendingEnd == 0)) return;
+
+	const GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	if (mPendingEnd != 0) {
+		// Allocations have wrapped: they go from mPendingBegin to the end of the buffer and then up to the head
+		mFencedRegions.push_back(FencedRegion{ mPendingBegin, mPendingEnd, mHead, fence });
+	} else {
+		mFencedRegions.push_back(FencedRegion{ mPendingBegin, mHead, 0, fence });
+	}
+
+	mPendingBegin = mHead;
+	mPendingEnd = 0;
+}
+
+void StreamingBuffer::waitForRange(size_t begin, size_t end) noexcept {
+	// Every overlapping region is waited for: as GPU commands complete in order, older regions are released as well
+	size_t regionsToRelease = 0;
+	for (size_t i = 0; i < mFencedRegions.size(); ++i) {
+		const FencedRegion& region = mFencedRegions[i];
+		const bool overlapping = ((region.begin < end) && (begin < region.end)) || (begin < region.wrappedEnd);
+		if (!overlapping) continue;
+
+		while (glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+
+		regionsToRelease = i + 1;
+	}
+
+	for (size_t i = 0; i < regionsToRelease; ++i) {
+		glDeleteSync(mFencedRegions.front().fence);
+		mFencedRegions.pop_front();
+	}
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Tachyon.h"
+
+namespace Tachyon {
+	namespace Rendering {
+		namespace OpenGL {
+
+			/**
+			 * This is a ring buffer used to stream data from the CPU to the GPU without allocating GPU memory each time.
+			 *
+			 * The whole buffer is persistently and coherently mapped: data is written directly on the mapped memory
+			 * and regions are reused only after the GPU has finished reading them, as signaled by fences.
+			 *
+			 * Usage: allocate regions, write them, issue GPU commands that read them and then call fence().
+			 *        Regions allocated between two fences MUST NOT exceed half of the buffer size.
+			 */
+			class StreamingBuffer {
+			public:
+				/**
+				 * This is a region of the ring buffer ready to be written.
+				 */
+				struct Allocation {
+					/**
+					 * The mapped memory of this region.
+					 */
+					void* data;
+
+					/**
+					 * The offset of this region on the buffer.
+					 */
+					GLintptr offset;
+
+					/**
+					 * The size of this region in bytes.
+					 */
+					GLsizeiptr size;
+				};
+
+				StreamingBuffer() = delete;
+
+				StreamingBuffer(const StreamingBuffer&) = delete;
+
+				StreamingBuffer(StreamingBuffer&&) = delete;
+
+				StreamingBuffer& operator=(const StreamingBuffer&) = delete;
+
+				~StreamingBuffer();
+
+				/**
+				 * Create and map the ring buffer.
+				 *
+				 * @param size the size of the ring buffer in bytes
+				 * @param alignment the alignment of each allocation (e.g. GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT)
+				 */
+				StreamingBuffer(size_t size, size_t alignment) noexcept;
+
+				/**
+				 * Reserve a region of the ring buffer, waiting for the GPU to release it if necessary.
+				 *
+				 * @param size the size of the region in bytes
+				 * @return the reserved region
+				 */
+				Allocation allocate(size_t size) noexcept;
+
+				/**
+				 * Mark regions allocated since the last fence as in use by GPU commands issued so far.
+				 */
+				void fence() noexcept;
+
+				GLuint getBuffer() const noexcept;
+
+				size_t getSize() const noexcept;
+
+				size_t getAlignment() const noexcept;
+
+			private:
+				/**
+				 * Wait for the GPU to release every region overlapping the given range.
+				 *
+				 * @param begin the first byte of the range
+				 * @param end the byte after the last one of the range
+				 */
+				void waitForRange(size_t begin, size_t end) noexcept;
+
+				/**
+				 * This is a region being read by the GPU.
+				 */
+				struct FencedRegion {
+					size_t begin;
+
+					size_t end;
+
+					/**
+					 * The region continues from the beginning of the buffer up to this byte, 0 if it does not wrap.
+					 */
+					size_t wrappedEnd;
+
+					GLsync fence;
+				};
+
+				GLuint mBuffer;
+
+				const size_t mSize;
+
+				const size_t mAlignment;
+
+				glm::uint8* mMapping;
+
+				/**
+				 * The first byte after the last allocation.
+				 */
+				size_t mHead;
+
+				/**
+				 * The first byte allocated since the last fence.
+				 */
+				size_t mPendingBegin;
+
+				/**
+				 * The byte after the last one allocated since the last fence before allocations have wrapped, 0 if they have not:
+				 * pending allocations are then [mPendingBegin, mPendingEnd) and [0, mHead).
+				 */
+				size_t mPendingEnd;
+
+				/**
+				 * Regions waiting for the GPU, from the oldest one.
+				 */
+				std::deque<FencedRegion> mFencedRegions;
+			};
+		}
+	}
+}
@@ -3,8 +3,50 @@
 using namespace Tachyon;
 using namespace Tachyon::Rendering;
 
-RenderingPipeline::RenderingPipeline() noexcept
-	: mWindowWidth(0), mWindowHeight(0) {}
+namespace {
+	/**
+	 * The number of samples of a still image when not told otherwise.
+	 */
+	const glm::uint32 defaultMaxAccumulatedSamples = 16;
+
+	/**
+	 * Compute an element of the van der Corput sequence: the base of each dimension of the Halton sequence.
+	 *
+	 * @param index the index of the element
+	 * @param base the prime base
+	 * @return the element, in [0, 1)
+	 */
+	glm::float32 radicalInverse(glm::uint32 index, glm::uint32 base) noexcept {
+		const glm::float32 invBase = glm::float32(1) / glm::float32(base);
+
+		glm::float32 result = 0, digitWeight = invBase;
+		for (; index > 0; index /= base, digitWeight *= invBase)
+			result += glm::float32(index % base) * digitWeight;
+
+		return result;
+	}
+}
+
+constexpr glm::uint32 SceneCapacity::everyModelResident;
+
+SceneCapacity::SceneCapacity(glm::uint32 expOfTwo_maxModels, glm::uint32 expOfTwo_maxCollectionsForModel, glm::uint32 expOfTwo_maxGeometryOnCollection, glm::uint32 expOfTwo_maxResidentModels) noexcept
+	: expOfTwo_maxModels(expOfTwo_maxModels),
+	expOfTwo_maxCollectionsForModel(expOfTwo_maxCollectionsForModel),
+	expOfTwo_maxGeometryOnCollection(expOfTwo_maxGeometryOnCollection),
+	expOfTwo_maxResidentModels(std::min(expOfTwo_maxResidentModels, expOfTwo_maxModels)) {}
+
+RenderingPipeline::RenderingPipeline(const SceneCapacity& capacity) noexcept
+	: mWindowWidth(0), mWindowHeight(0),
+	mShadingMode(ShadingMode::Headlight),
+	mLightDirection(glm::normalize(glm::vec3(-0.5, 1, 0.5))),
+	mCamera(Camera{ glm::vec3(0, 0, 0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0), glm::float32(60) }),
+	mMaxAccumulatedSamples(defaultMaxAccumulatedSamples),
+	mAccumulatedSamples(0),
+	mTakenLocations(size_t(1) << capacity.expOfTwo_maxModels, false) {
+	mFreeLocations.reserve(mTakenLocations.size());
+	for (size_t location = mTakenLocations.size(); location > 0; --location)
+		mFreeLocations.push_back(GLuint(location - 1));
+}
 
 void RenderingPipeline::resize(glm::uint32 width, glm::uint32 height) noexcept {
 	// Execute callback before doing anything
@@ -13,6 +55,9 @@ void RenderingPipeline::resize(glm::uint32 width, glm::uint32 height) noexcept {
 	// Change width and height values
 	mWindowWidth = width;
 	mWindowHeight = height;
+
+	// Samples of the old size cannot be reused
+	invalidateAccumulation();
 }
 
 glm::uint32 RenderingPipeline::getWidth() const noexcept {
@@ -23,10 +68,153 @@ glm::uint32 RenderingPipeline::getHeight() const noexcept {
 	return mWindowHeight;
 }
 
+void RenderingPipeline::setShadingMode(ShadingMode mode, const glm::vec3& lightDirection) noexcept {
+	mShadingMode = mode;
+	mLightDirection = glm::normalize(lightDirection);
+
+	invalidateAccumulation();
+}
+
+void RenderingPipeline::setCamera(const Camera& camera) noexcept {
+	// Only a camera that has actually moved throws the accumulated image away
+	if ((camera.position == mCamera.position) && (camera.viewDirection == mCamera.viewDirection) && (camera.up == mCamera.up) && (camera.fieldOfView == mCamera.fieldOfView)) return;
+
+	mCamera = camera;
+
+	invalidateAccumulation();
+}
+
+const Camera& RenderingPipeline::getCamera() const noexcept {
+	return mCamera;
+}
+
+void RenderingPipeline::setMaxAccumulatedSamples(glm::uint32 samplesCount) noexcept {
+	mMaxAccumulatedSamples = std::max<glm::uint32>(samplesCount, 1);
+}
+
+glm::uint32 RenderingPipeline::getMaxAccumulatedSamples() const noexcept {
+	return mMaxAccumulatedSamples;
+}
+
+glm::uint32 RenderingPipeline::getAccumulatedSamples() const noexcept {
+	return mAccumulatedSamples;
+}
+
+void RenderingPipeline::invalidateAccumulation() noexcept {
+	mAccumulatedSamples = 0;
+}
+
+bool RenderingPipeline::isAccumulationComplete() const noexcept {
+	return mAccumulatedSamples >= mMaxAccumulatedSamples;
+}
+
+glm::vec2 RenderingPipeline::getSampleJitter() const noexcept {
+	// The first element of the sequence is skipped, as it is always the pixel corner
+	return glm::vec2(radicalInverse(mAccumulatedSamples + 1, 2), radicalInverse(mAccumulatedSamples + 1, 3));
+}
+
+void RenderingPipeline::accountAccumulatedSample() noexcept {
+	++mAccumulatedSamples;
+}
+
+ShadingMode RenderingPipeline::getShadingMode() const noexcept {
+	return mShadingMode;
+}
+
+const glm::vec3& RenderingPipeline::getLightDirection() const noexcept {
+	return mLightDirection;
+}
+
+FrameProfiler& RenderingPipeline::getProfiler() noexcept {
+	return mProfiler;
+}
+
+std::vector<StageStatistics> RenderingPipeline::getFrameStats() const noexcept {
+	return mProfiler.getStatistics();
+}
+
+void RenderingPipeline::resetFrameStats() noexcept {
+	mProfiler.clear();
+}
+
+void RenderingPipeline::setTraceCapture(bool enabled) noexcept {
+	mProfiler.setTraceCapture(enabled);
+}
+
+bool RenderingPipeline::writeChromeTrace(const std::string& path) const noexcept {
+	return mProfiler.writeChromeTrace(path);
+}
+
 void RenderingPipeline::render(glm::uint32 width, glm::uint32 height) noexcept {
 	if ((width != getWidth()) || (height != getHeight())) resize(width, height);
 
 	onRender();
 }
 
+void RenderingPipeline::enqueueModels(std::vector<Model>&& models) noexcept {
+	for (auto& model : models)
+		enqueueModel(std::move(model.primitives), model.location);
+}
+
+void RenderingPipeline::enqueueInstances(const std::vector<ModelInstance>& instances) noexcept {
+	for (const auto& instance : instances)
+		enqueueInstance(instance.source, instance.location);
+}
+
+ModelHandle RenderingPipeline::addModel(std::vector<GeometryPrimitive>&& primitives) noexcept {
+	if (mFreeLocations.empty()) return invalidModelHandle;
+
+	const GLuint location = mFreeLocations.back();
+	mFreeLocations.pop_back();
+	mTakenLocations[location] = true;
+
+	enqueueModel(std::move(primitives), location);
+
+	return location;
+}
+
+ModelHandle RenderingPipeline::addInstance(ModelHandle handle) noexcept {
+	DBG_ASSERT( ((handle < mTakenLocations.size()) && (mTakenLocations[handle])) );
+	if ((handle >= mTakenLocations.size()) || (!mTakenLocations[handle]) || (mFreeLocations.empty())) return invalidModelHandle;
+
+	const GLuint location = mFreeLocations.back();
+	mFreeLocations.pop_back();
+	mTakenLocations[location] = true;
+
+	enqueueInstance(handle, location);
+
+	return location;
+}
+
+void RenderingPipeline::removeModel(ModelHandle handle) noexcept {
+	DBG_ASSERT( ((handle < mTakenLocations.size()) && (mTakenLocations[handle])) );
+	if ((handle >= mTakenLocations.size()) || (!mTakenLocations[handle])) return;
+
+	onRemoveModel(handle);
+
+	mTakenLocations[handle] = false;
+	mFreeLocations.push_back(handle);
+}
+
+void RenderingPipeline::updateModelPrimitives(ModelHandle handle, size_t firstPrimitive, const std::vector<GeometryPrimitive>& primitives) noexcept {
+	DBG_ASSERT( ((handle < mTakenLocations.size()) && (mTakenLocations[handle])) );
+	if ((handle >= mTakenLocations.size()) || (!mTakenLocations[handle]) || (primitives.empty())) return;
+
+	onUpdateModelPrimitives(handle, firstPrimitive, primitives);
+}
+
+void RenderingPipeline::reset() noexcept {
+	onReset();
+
+	mFreeLocations.clear();
+	for (size_t location = mTakenLocations.size(); location > 0; --location)
+		mFreeLocations.push_back(GLuint(location - 1));
+	std::fill(mTakenLocations.begin(), mTakenLocations.end(), false);
+}
+
+void RenderingPipeline::setModelTransforms(const std::vector<ModelTransform>& transforms) noexcept {
+	for (const auto& modelTransform : transforms)
+		setModelTransform(modelTransform.location, modelTransform.transform);
+}
+
 void RenderingPipeline::onResize(glm::uint32 oldWidth, glm::uint32 oldHeight, glm::uint32 newWidth, glm::uint32 newHeight) noexcept {}
\ No newline at end of file
@@ -1,13 +1,241 @@
 #pragma once
 
 #include "GeometryPrimitive.h"
+#include "FrameProfiler.h"
 
 namespace Tachyon {
 	namespace Rendering {
 
+		/**
+		 * This is the maximum amount of geometry a scene can hold, every limit is given as an exponent of two.
+		 *
+		 * Memory used to store the scene is proportional to the number of models
+		 * multiplied by the number of geometry primitives of each model.
+		 */
+		struct SceneCapacity {
+			/**
+			 * This is the default of expOfTwo_maxResidentModels: every model is resident.
+			 */
+			static constexpr glm::uint32 everyModelResident = 0xFFFFFFFF;
+
+			SceneCapacity(glm::uint32 expOfTwo_maxModels = 9, glm::uint32 expOfTwo_maxCollectionsForModel = 12, glm::uint32 expOfTwo_maxGeometryOnCollection = 3, glm::uint32 expOfTwo_maxResidentModels = everyModelResident) noexcept;
+
+			/**
+			 * The maximum number of models (BLASes): this is also the number of TLAS leaves.
+			 */
+			glm::uint32 expOfTwo_maxModels;
+
+			/**
+			 * The maximum number of geometry collections on a model: this is also the number of leaves of each BLAS.
+			 */
+			glm::uint32 expOfTwo_maxCollectionsForModel;
+
+			/**
+			 * The number of geometry primitives on each collection.
+			 */
+			glm::uint32 expOfTwo_maxGeometryOnCollection;
+
+			/**
+			 * The maximum number of models whose BLAS is kept in memory at once, never more than expOfTwo_maxModels:
+			 * other models can only be on the TLAS as proxies (GPU pipelines only, see OpenGL::ResidencyManager).
+			 */
+			glm::uint32 expOfTwo_maxResidentModels;
+		};
+
+		/**
+		 * This is the cost of BVH traversal measured on the last rendered frame.
+		 */
+		struct TraversalStatistics {
+			/**
+			 * The number of traced rays.
+			 */
+			glm::uint32 raysCount;
+
+			/**
+			 * The total number of BVH nodes (both on TLAS and BLASes) tested against rays.
+			 */
+			glm::uint32 totalNodeVisits;
+
+			/**
+			 * The highest number of BVH nodes tested against a single ray.
+			 */
+			glm::uint32 maxNodeVisits;
+		};
+
+		/**
+		 * This is a model to be placed on the scene.
+		 */
+		struct Model {
+			/**
+			 * The geometry of the model.
+			 */
+			std::vector<GeometryPrimitive> primitives;
+
+			/**
+			 * The location (BLAS) where the model is stored.
+			 */
+			GLuint location;
+		};
+
+		/**
+		 * This is a model placed on the scene again, sharing the BLAS of a model already placed.
+		 */
+		struct ModelInstance {
+			/**
+			 * The location of the model whose geometry is shared.
+			 */
+			GLuint source;
+
+			/**
+			 * The location the instance is placed on.
+			 */
+			GLuint location;
+		};
+
+		/**
+		 * This is the new placement of a model on the scene.
+		 */
+		struct ModelTransform {
+			/**
+			 * The location (BLAS) of the model to be moved.
+			 */
+			GLuint location;
+
+			/**
+			 * The transformation from the model space to the world space.
+			 */
+			glm::mat4 transform;
+		};
+
+		/**
+		 * This is the location reported by a ray that has not hit any model.
+		 */
+		constexpr GLuint noModelHit = 0xFFFFFFFF;
+
+		/**
+		 * This identifies a model placed with addModel: it is the location (BLAS) the model is stored at,
+		 * so it can be used wherever a location is expected (e.g. setModelTransform) and it is what rays report on hits.
+		 */
+		typedef GLuint ModelHandle;
+
+		/**
+		 * This is the handle returned by addModel when every location is taken.
+		 */
+		constexpr ModelHandle invalidModelHandle = 0xFFFFFFFF;
+
+		/**
+		 * This is a ray to be cast against the scene.
+		 */
+		struct RayQuery {
+			glm::vec3 origin;
+
+			/**
+			 * Hits closer than this distance are ignored.
+			 */
+			glm::float32 minDistance;
+
+			/**
+			 * The direction of the ray: distances are measured in multiples of its length.
+			 */
+			glm::vec3 direction;
+
+			/**
+			 * Hits farther than this distance are ignored.
+			 */
+			glm::float32 maxDistance;
+		};
+
+		/**
+		 * This is the closest hit of a ray cast against the scene.
+		 */
+		struct RayQueryResult {
+			/**
+			 * The surface normal at the hit point, in world space.
+			 */
+			glm::vec3 normal;
+
+			/**
+			 * The distance of the hit point along the ray, infinity if nothing has been hit.
+			 */
+			glm::float32 distance;
+
+			/**
+			 * The location (BLAS) of the model that has been hit, noModelHit if nothing has been hit.
+			 */
+			GLuint location;
+
+			glm::uint32 padding[3];
+		};
+
+		/**
+		 * This is what a ray query looks for: values MUST match RAY_QUERY_* in raytrace.comp.
+		 */
+		enum class RayQueryType : glm::uint32 {
+			/**
+			 * Find the closest hit of each ray.
+			 */
+			ClosestHit = 0,
+
+			/**
+			 * Find whether each ray hits anything: the traversal stops at the first hit found,
+			 * whose distance and location are reported, while the normal is not computed.
+			 */
+			Occlusion = 1,
+		};
+
+		/**
+		 * This is how rendered surfaces are lit: values MUST match SHADING_* in raytrace.comp.
+		 */
+		enum class ShadingMode : glm::uint32 {
+			/**
+			 * Surfaces are lit from the camera.
+			 */
+			Headlight = 0,
+
+			/**
+			 * Surfaces are lit by a directional light and a shadow ray is cast for each lit point.
+			 */
+			DirectLighting = 1,
+		};
+
+		/**
+		 * This identifies a batch of rays cast with castRays.
+		 */
+		typedef glm::uint64 RayQueryBatch;
+
+		/**
+		 * This is the point of view the scene is rendered from.
+		 */
+		struct Camera {
+			glm::vec3 position;
+
+			/**
+			 * The direction the camera is looking at.
+			 */
+			glm::vec3 viewDirection;
+
+			glm::vec3 up;
+
+			/**
+			 * The vertical field of view in degrees.
+			 */
+			glm::float32 fieldOfView;
+		};
+
+		/**
+		 * Parameters of the tone mapping applied to displayed images (see tonemapping.frag).
+		 */
+		constexpr glm::float32 toneMappingGamma = glm::float32(2.2);
+		constexpr glm::float32 toneMappingExposure = glm::float32(0.1);
+
 		class RenderingPipeline {
 		public:
-			RenderingPipeline() noexcept;
+			/**
+			 * Create the pipeline state shared by every raytracer.
+			 *
+			 * @param capacity the maximum size of the scene
+			 */
+			RenderingPipeline(const SceneCapacity& capacity) noexcept;
 
 			RenderingPipeline(const RenderingPipeline&) = delete;
 
@@ -19,23 +247,308 @@ namespace Tachyon {
 
 			virtual void enqueueModel(std::vector<GeometryPrimitive>&& primitive, GLuint location) noexcept = 0;
 
-			virtual void reset() noexcept = 0;
+			/**
+			 * Place many models on the scene at once.
+			 *
+			 * The default implementation enqueues models one by one,
+			 * pipelines that can do better (e.g. with a single GPU dispatch) should override this.
+			 *
+			 * @param models the models to be placed
+			 */
+			virtual void enqueueModels(std::vector<Model>&& models) noexcept;
+
+			/**
+			 * Place an instance of a model on another location: the instance shares the geometry (and the BLAS) of the model,
+			 * only its TLAS leaf and its transformation are its own. It is placed with the identity, as enqueued models are.
+			 *
+			 * Instances are peers of the model they have been created from: removing any of them leaves the others untouched,
+			 * updating the geometry of any of them updates every one of them, while enqueuing a model on
+			 * the location of an instance gives that location its own geometry again.
+			 *
+			 * @param sourceLocation the location of a model already enqueued (or an instance of it)
+			 * @param location the location of the instance, whose model (if any) is replaced
+			 */
+			virtual void enqueueInstance(GLuint sourceLocation, GLuint location) noexcept = 0;
+
+			/**
+			 * Place many instances at once, see enqueueInstance.
+			 *
+			 * The default implementation enqueues instances one by one.
+			 *
+			 * @param instances the instances to be placed, sources MUST NOT be placed on the same call
+			 */
+			virtual void enqueueInstances(const std::vector<ModelInstance>& instances) noexcept;
+
+			/**
+			 * Move a model placed on the scene: the transformation is applied before the next frame is rendered,
+			 * so it also applies to a model enqueued on the same location before rendering.
+			 *
+			 * Note: moving an empty location has no effect.
+			 *
+			 * @param location the location of the model to be moved
+			 * @param transform the transformation from the model space to the world space
+			 */
+			virtual void setModelTransform(GLuint location, const glm::mat4& transform) noexcept = 0;
+
+			/**
+			 * Move many models placed on the scene, see setModelTransform.
+			 *
+			 * The default implementation moves models one by one.
+			 *
+			 * @param transforms the new placement of each model
+			 */
+			virtual void setModelTransforms(const std::vector<ModelTransform>& transforms) noexcept;
+
+			/**
+			 * Place a model on the first free location, without having to track locations.
+			 *
+			 * Note: locations are either managed with addModel and removeModel or chosen by the caller
+			 *       (enqueueModel, enqueueModels), never both on the same scene.
+			 *
+			 * @param primitives the geometry of the model
+			 * @return the handle of the model, invalidModelHandle if the scene is full
+			 */
+			ModelHandle addModel(std::vector<GeometryPrimitive>&& primitives) noexcept;
+
+			/**
+			 * Place an instance of a model placed with addModel on the first free location, see enqueueInstance.
+			 *
+			 * @param handle the model to be instanced
+			 * @return the handle of the instance, invalidModelHandle if the scene is full
+			 */
+			ModelHandle addInstance(ModelHandle handle) noexcept;
+
+			/**
+			 * Remove a model placed with addModel: its location is emptied and becomes free again,
+			 * while every other model is left untouched.
+			 *
+			 * @param handle the model to be removed
+			 */
+			void removeModel(ModelHandle handle) noexcept;
+
+			/**
+			 * Replace a range of the geometry of a model placed with addModel: only the BVH nodes holding
+			 * the given geometry and their ancestors are refitted, the model is not rebuilt.
+			 *
+			 * Note: the BVH is not reorganized, so geometry moving far from where it was makes traversal slower.
+			 *       Instances share the geometry of their model, so every instance is updated too (see enqueueInstance).
+			 *
+			 * @param handle the model to be updated
+			 * @param firstPrimitive the index of the first primitive to be replaced, in the order the model has been given
+			 * @param primitives the new primitives, that MUST NOT exceed the size of the model
+			 */
+			void updateModelPrimitives(ModelHandle handle, size_t firstPrimitive, const std::vector<GeometryPrimitive>& primitives) noexcept;
+
+			/**
+			 * Remove every model from the scene: every location becomes free again.
+			 */
+			void reset() noexcept;
+
+			/**
+			 * Enable or disable the measurement of BVH traversal cost while rendering.
+			 *
+			 * Note: measuring has a cost, so it should only be enabled when needed.
+			 *
+			 * @param enabled TRUE to collect traversal statistics on subsequent frames
+			 */
+			virtual void setTraversalStatisticsCollection(bool enabled) noexcept = 0;
+
+			/**
+			 * Get the BVH traversal cost of the last frame rendered with statistics collection enabled.
+			 *
+			 * @return the traversal statistics
+			 */
+			virtual TraversalStatistics getTraversalStatistics() const noexcept = 0;
+
+			/**
+			 * Cast a batch of rays against the scene, as it would be rendered now, without waiting for results.
+			 *
+			 * Results of each batch MUST be retrieved (once) with pollRayQueryResults or waitRayQueryResults.
+			 *
+			 * @param rays the rays to be cast
+			 * @param type what is to be found for each ray
+			 * @return the batch to retrieve results of
+			 */
+			virtual RayQueryBatch castRays(const std::vector<RayQuery>& rays, RayQueryType type = RayQueryType::ClosestHit) noexcept = 0;
+
+			/**
+			 * Retrieve results of a batch of rays if they are ready, without waiting.
+			 *
+			 * @param batch the batch returned by castRays
+			 * @param results the closest hit of each ray of the batch, in the same order of rays, when ready
+			 * @return TRUE if results are ready (and the batch has been released)
+			 */
+			virtual bool pollRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept = 0;
+
+			/**
+			 * Retrieve results of a batch of rays, waiting for them if needed.
+			 *
+			 * @param batch the batch returned by castRays
+			 * @param results the closest hit of each ray of the batch, in the same order of rays
+			 */
+			virtual void waitRayQueryResults(RayQueryBatch batch, std::vector<RayQueryResult>& results) noexcept = 0;
+
+			/**
+			 * Choose how rendered surfaces are lit.
+			 *
+			 * @param mode the shading mode
+			 * @param lightDirection the direction towards the light (ShadingMode::DirectLighting only)
+			 */
+			void setShadingMode(ShadingMode mode, const glm::vec3& lightDirection = glm::vec3(-0.5, 1, 0.5)) noexcept;
+
+			/**
+			 * Move the point of view: the default camera is at the origin, looking towards -Z with a field of view of 60 degrees.
+			 *
+			 * @param camera the new camera
+			 */
+			void setCamera(const Camera& camera) noexcept;
+
+			const Camera& getCamera() const noexcept;
+
+			/**
+			 * Choose how many jittered samples are averaged on each pixel while nothing changes.
+			 *
+			 * Every frame adds a sample to the image until the given count is reached,
+			 * then frames present the cached image without tracing any ray.
+			 * Moving the camera, resizing, changing the shading or the scene restarts the accumulation.
+			 *
+			 * @param samplesCount the number of samples of a still image, at least 1
+			 */
+			void setMaxAccumulatedSamples(glm::uint32 samplesCount) noexcept;
+
+			glm::uint32 getMaxAccumulatedSamples() const noexcept;
+
+			/**
+			 * Get the number of samples averaged on the current image.
+			 *
+			 * @return the number of samples, 0 if the image has to be rendered from scratch
+			 */
+			glm::uint32 getAccumulatedSamples() const noexcept;
 
 			void render(glm::uint32 width, glm::uint32 height) noexcept;
 
+			/**
+			 * Get the cost of each pipeline stage over the most recent frames.
+			 *
+			 * Note: pipelines measuring on the GPU read timings back a few frames later,
+			 * so the last frames rendered are not accounted yet.
+			 *
+			 * @return statistics of each stage measured so far
+			 */
+			std::vector<StageStatistics> getFrameStats() const noexcept;
+
+			/**
+			 * Forget stage timings measured so far, e.g. those of warm-up frames.
+			 */
+			void resetFrameStats() noexcept;
+
+			/**
+			 * Start or stop capturing stage timings to be written with writeChromeTrace.
+			 *
+			 * @param enabled TRUE to capture timings from now on, discarding the previous capture
+			 */
+			void setTraceCapture(bool enabled) noexcept;
+
+			/**
+			 * Write stage timings captured so far as a Chrome trace.
+			 *
+			 * @param path the JSON file to be written
+			 * @return TRUE on success
+			 */
+			bool writeChromeTrace(const std::string& path) const noexcept;
+
 		protected:
 			virtual void onResize(glm::uint32 oldWidth, glm::uint32 oldHeight, glm::uint32 newWidth, glm::uint32 newHeight) noexcept;
 
 			virtual void onRender() noexcept = 0;
 
+			/**
+			 * Empty the location of a model: its geometry is not traversed by rays anymore.
+			 *
+			 * @param location the location to be emptied
+			 */
+			virtual void onRemoveModel(GLuint location) noexcept = 0;
+
+			/**
+			 * Replace a range of the geometry of a model and refit its BVH (see updateModelPrimitives).
+			 *
+			 * @param location the location of the model
+			 * @param firstPrimitive the index of the first primitive to be replaced
+			 * @param primitives the new primitives
+			 */
+			virtual void onUpdateModelPrimitives(GLuint location, size_t firstPrimitive, const std::vector<GeometryPrimitive>& primitives) noexcept = 0;
+
+			/**
+			 * Empty every location.
+			 */
+			virtual void onReset() noexcept = 0;
+
 			glm::uint32 getWidth() const noexcept;
 
 			glm::uint32 getHeight() const noexcept;
 
+			FrameProfiler& getProfiler() noexcept;
+
+			ShadingMode getShadingMode() const noexcept;
+
+			/**
+			 * Get the normalized direction towards the light.
+			 *
+			 * @return the light direction
+			 */
+			const glm::vec3& getLightDirection() const noexcept;
+
+			/**
+			 * Discard the accumulated image: pipelines MUST call this whenever the scene changes.
+			 */
+			void invalidateAccumulation() noexcept;
+
+			/**
+			 * Check if the image has as many samples as requested, so that rendering can be skipped.
+			 *
+			 * @return TRUE if the cached image is to be presented as is
+			 */
+			bool isAccumulationComplete() const noexcept;
+
+			/**
+			 * Get the sub-pixel position of the next sample to be accumulated:
+			 * positions follow the Halton sequence, so that any number of samples covers the pixel evenly.
+			 *
+			 * @return the offset from the pixel corner, in [0, 1) pixels
+			 */
+			glm::vec2 getSampleJitter() const noexcept;
+
+			/**
+			 * Account a sample added to the image.
+			 */
+			void accountAccumulatedSample() noexcept;
+
 		private:
 			void resize(glm::uint32 width, glm::uint32 height) noexcept;
 
 			glm::uint32 mWindowWidth, mWindowHeight;
+
+			FrameProfiler mProfiler;
+
+			ShadingMode mShadingMode;
+
+			glm::vec3 mLightDirection;
+
+			Camera mCamera;
+
+			glm::uint32 mMaxAccumulatedSamples;
+
+			glm::uint32 mAccumulatedSamples;
+
+			/**
+			 * Locations not taken by addModel, the lowest one last.
+			 */
+			std::vector<GLuint> mFreeLocations;
+
+			/**
+			 * For each location TRUE if it has been taken by addModel.
+			 */
+			std::vector<bool> mTakenLocations;
 		};
 		
 	}
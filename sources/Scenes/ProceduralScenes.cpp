@@ -0,0 +1,182 @@
+#include "Scenes/ProceduralScenes.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Rendering;
+using namespace Tachyon::Scenes;
+
+namespace {
+	/**
+	 * Spheres of a geometry collection: this is the smallest leaf of the GPU BLAS builder.
+	 */
+	const glm::uint32 expOfTwo_geometryOnCollection = 3;
+
+	glm::uint32 ceilLog2(glm::uint32 value) noexcept {
+		glm::uint32 exponent = 0;
+		while ((glm::uint64(1) << exponent) < glm::uint64(value))
+			++exponent;
+
+		return exponent;
+	}
+
+	/**
+	 * Get the placement of a model on a wall in front of the camera, each model on its own cell.
+	 *
+	 * The model is expected to fit in a unit cube centered on its origin.
+	 *
+	 * @param index the index of the model
+	 * @param modelsCount the number of models on the wall
+	 * @return the transformation of the model
+	 */
+	glm::mat4 wallPlacement(glm::uint32 index, glm::uint32 modelsCount) noexcept {
+		const glm::uint32 columns = std::max(glm::uint32(std::ceil(std::sqrt(glm::float32(modelsCount)))), glm::uint32(1));
+		const glm::uint32 rows = (modelsCount + columns - 1) / columns;
+
+		// The wall is a 4x4 square at a distance of 5, which is framed by the 60 degrees camera
+		const glm::float32 cellSize = glm::float32(4) / glm::float32(std::max(columns, rows));
+		const glm::vec3 cellCenter(
+			(glm::float32(index % columns) + glm::float32(0.5) - glm::float32(columns) / 2) * cellSize,
+			(glm::float32(index / columns) + glm::float32(0.5) - glm::float32(rows) / 2) * cellSize,
+			glm::float32(-5)
+		);
+
+		return glm::translate(cellCenter) * glm::scale(glm::vec3(cellSize * glm::float32(0.9)));
+	}
+}
+
+size_t Scene::getPrimitivesCount() const noexcept {
+	size_t primitivesCount = 0;
+	for (const auto& model : models)
+		primitivesCount += model.primitives.size();
+
+	return primitivesCount;
+}
+
+SceneCapacity Scenes::fittingCapacity(glm::uint32 modelsCount, glm::uint32 maxPrimitivesOnModel) noexcept {
+	const glm::uint32 collectionsCount = (maxPrimitivesOnModel + (glm::uint32(1) << expOfTwo_geometryOnCollection) - 1) >> expOfTwo_geometryOnCollection;
+
+	// Trees with a single node are not worth a special case on shaders
+	return SceneCapacity(
+		std::max(ceilLog2(modelsCount), glm::uint32(1)),
+		std::max(ceilLog2(collectionsCount), glm::uint32(1)),
+		expOfTwo_geometryOnCollection
+	);
+}
+
+Scene Scenes::makeDemo() noexcept {
+	Scene scene;
+	scene.models.push_back(Model{ {
+		GeometryPrimitive(glm::vec3(0, 0, -1), 0.5),
+		GeometryPrimitive(glm::vec3(0.75, 0, -1.5), 0.25),
+		GeometryPrimitive(glm::vec3(0, -100.5, -1), 100),
+	}, 0 });
+	scene.capacity = fittingCapacity(1, 3);
+
+	return scene;
+}
+
+Scene Scenes::makeSphereGrid(glm::uint32 modelsCount, glm::uint32 primitivesOnModel) noexcept {
+	const glm::uint32 side = std::max(glm::uint32(std::ceil(std::sqrt(glm::float32(primitivesOnModel)))), glm::uint32(1));
+	const glm::float32 spacing = glm::float32(1) / glm::float32(side);
+
+	// Every model has the same geometry
+	std::vector<GeometryPrimitive> primitives;
+	primitives.reserve(primitivesOnModel);
+	for (glm::uint32 i = 0; i < primitivesOnModel; ++i) {
+		const glm::vec3 center(
+			(glm::float32(i % side) + glm::float32(0.5)) * spacing - glm::float32(0.5),
+			(glm::float32(i / side) + glm::float32(0.5)) * spacing - glm::float32(0.5),
+			0
+		);
+
+		primitives.emplace_back(center, spacing * glm::float32(0.4));
+	}
+
+	Scene scene;
+	scene.capacity = fittingCapacity(modelsCount, primitivesOnModel);
+	scene.capacity.expOfTwo_maxResidentModels = 0;
+	scene.models.push_back(Model{ std::move(primitives), 0 });
+	for (GLuint location = 0; location < modelsCount; ++location) {
+		if (location != 0) scene.instances.push_back(ModelInstance{ 0, location });
+		scene.transforms.push_back(ModelTransform{ location, wallPlacement(location, modelsCount) });
+	}
+
+	return scene;
+}
+
+Scene Scenes::makeSphereCloud(glm::uint32 modelsCount, glm::uint32 primitivesOnModel, bool overlapping, glm::uint32 seed) noexcept {
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<glm::float32> unitCube(glm::float32(-0.5), glm::float32(0.5));
+
+	// Spheres fill a small fraction of the model volume, so that rays travel across the model
+	const glm::float32 radius = glm::float32(0.3) / std::cbrt(glm::float32(std::max(primitivesOnModel, glm::uint32(1))));
+
+	Scene scene;
+	scene.capacity = fittingCapacity(modelsCount, primitivesOnModel);
+	for (GLuint location = 0; location < modelsCount; ++location) {
+		Model model;
+		model.location = location;
+		model.primitives.reserve(primitivesOnModel);
+		for (glm::uint32 i = 0; i < primitivesOnModel; ++i) {
+			const glm::vec3 center(unitCube(generator), unitCube(generator), unitCube(generator));
+
+			model.primitives.emplace_back(center * (glm::float32(1) - glm::float32(2) * radius), radius);
+		}
+		scene.models.push_back(std::move(model));
+
+		// Overlapping models are slightly shifted, so that their bounds are not exactly the same
+		const glm::mat4 transform = (overlapping) ?
+			glm::translate(glm::vec3(unitCube(generator), unitCube(generator), glm::float32(-5)) * glm::vec3(glm::float32(0.2), glm::float32(0.2), 1)) * glm::scale(glm::vec3(3)) :
+			wallPlacement(location, modelsCount);
+
+		scene.transforms.push_back(ModelTransform{ location, transform });
+	}
+
+	return scene;
+}
+
+const std::vector<std::string>& Scenes::getSceneNames() noexcept {
+	static const std::vector<std::string> names = {
+		"demo",
+		"grid",
+		"huge",
+		"small512",
+		"overlapping",
+		"disjoint",
+	};
+
+	return names;
+}
+
+bool Scenes::makeScene(const std::string& name, Scene& scene) noexcept {
+	// "huge" and "small512" hold the same number of spheres
+	if (name == "demo") {
+		scene = makeDemo();
+	} else if (name == "grid") {
+		scene = makeSphereGrid(16, 64);
+	} else if (name == "huge") {
+		scene = makeSphereCloud(1, 16384, false, 1);
+	} else if (name == "small512") {
+		scene = makeSphereCloud(512, 32, false, 1);
+	} else if (name == "overlapping") {
+		scene = makeSphereCloud(64, 256, true, 1);
+	} else if (name == "disjoint") {
+		scene = makeSphereCloud(64, 256, false, 1);
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+void Scenes::loadScene(const Scene& scene, RenderingPipeline& pipeline) noexcept {
+	pipeline.reset();
+
+	std::vector<Model> models(scene.models);
+	pipeline.enqueueModels(std::move(models));
+
+	if (!scene.instances.empty())
+		pipeline.enqueueInstances(scene.instances);
+
+	if (!scene.transforms.empty())
+		pipeline.setModelTransforms(scene.transforms);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Rendering/RenderingPipeline.h"
+
+namespace Tachyon {
+	namespace Scenes {
+
+		/**
+		 * This is a generated scene, ready to be placed on a rendering pipeline created with its capacity.
+		 *
+		 * Every scene is framed by the default camera: placed at the origin and looking towards -Z.
+		 */
+		struct Scene {
+			/**
+			 * The smallest capacity the scene fits in.
+			 */
+			Rendering::SceneCapacity capacity;
+
+			std::vector<Rendering::Model> models;
+
+			/**
+			 * Models placed again on other locations, sharing the geometry of models on the scene.
+			 */
+			std::vector<Rendering::ModelInstance> instances;
+
+			/**
+			 * The placement of each model, models without one are placed with the identity.
+			 */
+			std::vector<Rendering::ModelTransform> transforms;
+
+			/**
+			 * Get the total number of geometry primitives of the scene.
+			 *
+			 * @return the number of spheres of every model, instances share those of their model
+			 */
+			size_t getPrimitivesCount() const noexcept;
+		};
+
+		/**
+		 * Get the smallest capacity holding the given scene.
+		 *
+		 * @param modelsCount the number of models
+		 * @param maxPrimitivesOnModel the number of geometry primitives of the largest model
+		 * @return the scene capacity
+		 */
+		Rendering::SceneCapacity fittingCapacity(glm::uint32 modelsCount, glm::uint32 maxPrimitivesOnModel) noexcept;
+
+		/**
+		 * Generate the original demo scene: two spheres laying on a huge one.
+		 */
+		Scene makeDemo() noexcept;
+
+		/**
+		 * Generate a wall of models, each one being a regular grid of spheres:
+		 * every model is an instance of the first one, so a single BLAS is built and stored.
+		 *
+		 * @param modelsCount the number of models
+		 * @param primitivesOnModel the number of spheres of each model
+		 * @return the generated scene
+		 */
+		Scene makeSphereGrid(glm::uint32 modelsCount, glm::uint32 primitivesOnModel) noexcept;
+
+		/**
+		 * Generate models made of randomly placed spheres, either all filling the same volume
+		 * (so that every ray crosses many TLAS leaves) or each one in its own cell of a wall.
+		 *
+		 * @param modelsCount the number of models
+		 * @param primitivesOnModel the number of spheres of each model
+		 * @param overlapping TRUE to place every model on the same volume
+		 * @param seed the seed of the random sequence, the same seed generates the same scene
+		 * @return the generated scene
+		 */
+		Scene makeSphereCloud(glm::uint32 modelsCount, glm::uint32 primitivesOnModel, bool overlapping, glm::uint32 seed) noexcept;
+
+		/**
+		 * Get names accepted by makeScene.
+		 *
+		 * @return names of scene presets
+		 */
+		const std::vector<std::string>& getSceneNames() noexcept;
+
+		/**
+		 * Generate a scene preset.
+		 *
+		 * @param name the preset name, one of getSceneNames()
+		 * @param scene the generated scene
+		 * @return FALSE if the preset does not exist
+		 */
+		bool makeScene(const std::string& name, Scene& scene) noexcept;
+
+		/**
+		 * Replace the scene of the given pipeline: the pipeline must have been created with (at least) the scene capacity.
+		 *
+		 * @param scene the scene to be placed
+		 * @param pipeline the pipeline to be filled
+		 */
+		void loadScene(const Scene& scene, Rendering::RenderingPipeline& pipeline) noexcept;
+
+	}
+}
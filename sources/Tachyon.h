@@ -4,6 +4,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <iomanip>
 
 // STL data types
 #include <functional>
@@ -15,15 +16,35 @@
 #include <vector>
 #include <array>
 #include <list>
+#include <deque>
 
 // STL memory
 #include <memory>
 
+// STL threading
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// STL random numbers
+#include <random>
+
+// STL time
+#include <chrono>
+
 // STL algorithms
 #include <algorithm>
 #include <utility>
 #include <limits>
 
+// C runtime
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
 // GLM math library
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm.hpp>
@@ -38,6 +59,17 @@
 // GLFW
 #include <GLFW/glfw3.h>
 
+// Memory mapped files
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 typedef glm::uint32 UnsignedType;
 typedef glm::float32 NumericType;
 
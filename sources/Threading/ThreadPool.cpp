@@ -0,0 +1,150 @@
+#include "Threading/ThreadPool.h"
+
+using namespace Tachyon;
+using namespace Tachyon::Threading;
+
+namespace {
+	/**
+	 * The pool the current thread is a worker of (nullptr for non-worker threads).
+	 */
+	thread_local const ThreadPool* currentPool = nullptr;
+
+	/**
+	 * The index of the queue owned by the current thread (only meaningful when currentPool is not nullptr).
+	 */
+	thread_local size_t currentWorkerIndex = 0;
+}
+
+ThreadPool::TaskGroup::TaskGroup() noexcept
+	: mPendingTasks(0) {}
+
+ThreadPool::ThreadPool(size_t workersCount) noexcept
+	: mQueuedTasks(0), mNextQueue(0), mTerminate(false) {
+	if (workersCount == 0)
+		workersCount = std::max(size_t(std::thread::hardware_concurrency()), size_t(1));
+
+	for (size_t i = 0; i < workersCount; ++i)
+		mQueues.emplace_back(new WorkQueue());
+
+	// Queues must all exist before the first worker starts stealing
+	for (size_t i = 0; i < workersCount; ++i)
+		mWorkers.emplace_back(&ThreadPool::workerMain, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		mTerminate = true;
+	}
+
+	mSleepCondition.notify_all();
+
+	for (auto& worker : mWorkers)
+		worker.join();
+}
+
+size_t ThreadPool::getWorkersCount() const noexcept {
+	return mWorkers.size();
+}
+
+void ThreadPool::push(size_t queueIndex, Task&& task) noexcept {
+	{
+		std::lock_guard<std::mutex> lock(mQueues[queueIndex]->mutex);
+		mQueues[queueIndex]->tasks.push_back(std::move(task));
+	}
+
+	// Taking the sleep mutex guarantees a worker cannot miss the notification between its check and its wait
+	{
+		std::lock_guard<std::mutex> lock(mSleepMutex);
+		++mQueuedTasks;
+	}
+
+	mSleepCondition.notify_one();
+}
+
+bool ThreadPool::pop(size_t queueIndex, Task& task) noexcept {
+	std::lock_guard<std::mutex> lock(mQueues[queueIndex]->mutex);
+
+	if (mQueues[queueIndex]->tasks.empty()) return false;
+
+	task = std::move(mQueues[queueIndex]->tasks.back());
+	mQueues[queueIndex]->tasks.pop_back();
+	--mQueuedTasks;
+
+	return true;
+}
+
+bool ThreadPool::steal(size_t thiefIndex, Task& task) noexcept {
+	for (size_t i = 1; i <= mQueues.size(); ++i) {
+		const size_t victimIndex = (thiefIndex + i) % mQueues.size();
+
+		std::lock_guard<std::mutex> lock(mQueues[victimIndex]->mutex);
+
+		if (mQueues[victimIndex]->tasks.empty()) continue;
+
+		task = std::move(mQueues[victimIndex]->tasks.front());
+		mQueues[victimIndex]->tasks.pop_front();
+		--mQueuedTasks;
+
+		return true;
+	}
+
+	return false;
+}
+
+bool ThreadPool::runPendingTask() noexcept {
+	Task task;
+
+	const bool isWorker = (currentPool == this);
+	const size_t queueIndex = isWorker ? currentWorkerIndex : (mNextQueue++ % mQueues.size());
+
+	if ((isWorker && pop(queueIndex, task)) || steal(queueIndex, task)) {
+		task();
+
+		return true;
+	}
+
+	return false;
+}
+
+void ThreadPool::workerMain(size_t workerIndex) noexcept {
+	currentPool = this;
+	currentWorkerIndex = workerIndex;
+
+	while (true) {
+		if (runPendingTask()) continue;
+
+		std::unique_lock<std::mutex> lock(mSleepMutex);
+		mSleepCondition.wait(lock, [this]() { return (mQueuedTasks.load() != 0) || (mTerminate.load()); });
+
+		if ((mTerminate) && (mQueuedTasks.load() == 0)) break;
+	}
+}
+
+void ThreadPool::run(TaskGroup& group, Task&& task) noexcept {
+	++group.mPendingTasks;
+
+	const size_t queueIndex = (currentPool == this) ? currentWorkerIndex : (mNextQueue++ % mQueues.size());
+
+	Task groupTask(std::move(task));
+	push(queueIndex, [&group, groupTask]() {
+		groupTask();
+
+		--group.mPendingTasks;
+	});
+}
+
+void ThreadPool::wait(TaskGroup& group) noexcept {
+	// Help with pending work instead of blocking: the awaited tasks may be queued behind others
+	while (group.mPendingTasks.load() != 0)
+		if (!runPendingTask()) std::this_thread::yield();
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& job) noexcept {
+	TaskGroup group;
+
+	for (size_t i = 0; i < count; ++i)
+		run(group, [&job, i]() { job(i); });
+
+	wait(group);
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Tachyon.h"
+
+namespace Tachyon {
+	namespace Threading {
+
+		/**
+		 * This is a work-stealing thread pool.
+		 *
+		 * Each worker owns a double-ended queue of tasks: the owner pushes and pops from the back
+		 * (so recently spawned, cache-hot work is executed first), while idle workers steal from
+		 * the front of other queues (so large, old chunks of work migrate between threads).
+		 *
+		 * Threads waiting for a TaskGroup do not sleep: they keep executing pending tasks,
+		 * so tasks are allowed to spawn and wait for other tasks without deadlocking the pool.
+		 */
+		class ThreadPool {
+		public:
+			typedef std::function<void()> Task;
+
+			/**
+			 * A collection of tasks that can be waited for as a whole.
+			 */
+			class TaskGroup {
+				friend class ThreadPool;
+
+			public:
+				TaskGroup() noexcept;
+
+				TaskGroup(const TaskGroup&) = delete;
+
+				TaskGroup& operator=(const TaskGroup&) = delete;
+
+				~TaskGroup() = default;
+
+			private:
+				std::atomic<size_t> mPendingTasks;
+			};
+
+			ThreadPool(const ThreadPool&) = delete;
+
+			ThreadPool(ThreadPool&&) = delete;
+
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			/**
+			 * Spawn the pool workers.
+			 *
+			 * @param workersCount the number of worker threads, 0 means one for each hardware thread
+			 */
+			ThreadPool(size_t workersCount = 0) noexcept;
+
+			~ThreadPool();
+
+			size_t getWorkersCount() const noexcept;
+
+			/**
+			 * Schedule the given task as part of the given group.
+			 *
+			 * When called from a worker the task is queued on the worker own queue,
+			 * otherwise queues are selected in a round-robin fashion.
+			 *
+			 * @param group the group the task will be accounted on
+			 * @param task the task to be executed
+			 */
+			void run(TaskGroup& group, Task&& task) noexcept;
+
+			/**
+			 * Execute pending tasks until every task in the given group has been completed.
+			 *
+			 * @param group the group to wait for
+			 */
+			void wait(TaskGroup& group) noexcept;
+
+			/**
+			 * Execute job(i) for each i in [0, count) on the pool and wait for all of them to complete.
+			 *
+			 * @param count the number of jobs
+			 * @param job the job to be executed
+			 */
+			void parallelFor(size_t count, const std::function<void(size_t)>& job) noexcept;
+
+		private:
+			struct WorkQueue {
+				std::mutex mutex;
+
+				std::deque<Task> tasks;
+			};
+
+			void push(size_t queueIndex, Task&& task) noexcept;
+
+			bool pop(size_t queueIndex, Task& task) noexcept;
+
+			bool steal(size_t thiefIndex, Task& task) noexcept;
+
+			bool runPendingTask() noexcept;
+
+			void workerMain(size_t workerIndex) noexcept;
+
+			std::vector<std::unique_ptr<WorkQueue>> mQueues;
+
+			std::vector<std::thread> mWorkers;
+
+			std::mutex mSleepMutex;
+
+			std::condition_variable mSleepCondition;
+
+			std::atomic<size_t> mQueuedTasks;
+
+			std::atomic<size_t> mNextQueue;
+
+			std::atomic<bool> mTerminate;
+		};
+
+	}
+}
@@ -1,6 +1,10 @@
 #include "Rendering/OpenGL/OpenGLPipeline.h"
+#include "Rendering/OpenGL/SceneStreamer.h"
+#include "Rendering/OpenGL/ResidencyManager.h"
+#include "Rendering/CPU/CPUPipeline.h"
+#include "Scenes/ProceduralScenes.h"
 
-void GLAPIENTRY
+void APIENTRY
 MessageCallback(GLenum source,
 	GLenum type,
 	GLuint id,
@@ -40,7 +44,441 @@ std::string get_opengl_compute_info() {
 	return stringstream.str();
 }
 
+namespace {
+	/**
+	 * This is the configuration given on the command line.
+	 */
+	struct Options {
+		/**
+		 * Render on an offscreen framebuffer of a hidden window instead of on a visible window.
+		 */
+		bool headless = false;
+
+		/**
+		 * Build models of the generated scene in background while frames are being rendered.
+		 */
+		bool stream = false;
+
+		/**
+		 * Build models of the generated scene on the CPU with a surface area heuristic instead of on the GPU.
+		 */
+		bool sah = false;
+
+		/**
+		 * Render on the CPU instead of on the GPU: frames are always headless and no window is opened.
+		 */
+		bool cpu = false;
+
+		glm::uint32 width = 480;
+
+		glm::uint32 height = 360;
+
+		/**
+		 * The number of frames to be rendered, 0 means until the window is closed.
+		 */
+		glm::uint32 frames = 0;
+
+		/**
+		 * The number of jittered samples accumulated on each pixel of a still image.
+		 */
+		glm::uint32 samples = 16;
+
+		/**
+		 * The number of models of the generated scene kept in GPU memory at once, 0 keeps every model resident.
+		 */
+		glm::uint32 residentModels = 0;
+
+		/**
+		 * The number of work groups of the persistent threads rendering mode, 0 dispatches one work group for each screen tile.
+		 */
+		glm::uint32 persistentThreads = 0;
+
+		/**
+		 * The number of threads of the CPU renderer, 0 means one for each hardware thread.
+		 */
+		glm::uint32 threads = 0;
+
+		std::string scene = "demo";
+
+		/**
+		 * The scene file to be rendered instead of a generated scene, none when empty.
+		 */
+		std::string loadScene;
+
+		/**
+		 * The scene file the rendered scene is exported to before rendering, nothing is written when empty.
+		 */
+		std::string saveScene;
+
+		/**
+		 * The PPM image the last frame is written to in headless mode.
+		 */
+		std::string output = "tachyon.ppm";
+
+		/**
+		 * The PPM image the last headless frame is compared with (e.g. one written by the other renderer), none when empty.
+		 */
+		std::string compare;
+
+		/**
+		 * The Chrome trace stage timings are written to, nothing is written when empty.
+		 */
+		std::string trace;
+
+		/**
+		 * The directory linked programs are cached on, nothing is cached when empty.
+		 */
+		std::string programCache;
+	};
+
+	void printUsage(const char* program) {
+		std::cout << "Usage: " << program << " [options]" << std::endl
+			<< "  --headless          render offscreen (a hidden window is still required by GLFW)" << std::endl
+			<< "  --stream            build models in background while rendering, frames keep going until every model is shown" << std::endl
+			<< "  --sah               build models on the CPU with a surface area heuristic, for faster rendering (not with --stream or --resident)" << std::endl
+			<< "  --cpu               render headless on the CPU, without any window nor GPU (only generated scenes)" << std::endl
+			<< "  --width <pixels>    the width of the rendered image (default 480)" << std::endl
+			<< "  --height <pixels>   the height of the rendered image (default 360)" << std::endl
+			<< "  --frames <count>    the number of frames to render (default: until the window is closed, as many as samples if headless)" << std::endl
+			<< "  --samples <count>   the number of samples accumulated on each pixel while nothing moves (default 16)" << std::endl
+			<< "  --resident <count>  keep at most this many models in GPU memory, paging them as they become visible (not with --stream)" << std::endl
+			<< "  --persistent-threads <groups>  render with this many work groups pulling screen tiles (default 0: one work group for each tile)" << std::endl
+			<< "  --threads <count>   the number of CPU rendering threads (default 0: one for each hardware thread)" << std::endl
+			<< "  --scene <name>      the scene to render (default demo), one of:";
+		for (const auto& name : Tachyon::Scenes::getSceneNames())
+			std::cout << " " << name;
+		std::cout << std::endl
+			<< "  --load-scene <file> render a scene file instead of a generated scene" << std::endl
+			<< "  --save-scene <file> write the scene to a file to be loaded with --load-scene" << std::endl
+			<< "  --output <file>     the PPM image the last headless frame is written to (default tachyon.ppm)" << std::endl
+			<< "  --compare <file>    compare the last headless frame with a PPM image, such as one rendered by the other renderer" << std::endl
+			<< "  --trace <file>      write stage timings as a Chrome trace" << std::endl
+			<< "  --program-cache <directory>  keep linked GPU programs in an existing directory to speed up later launches" << std::endl;
+	}
+
+	bool parseUnsigned(const char* text, glm::uint32& value) {
+		char* end = nullptr;
+		const unsigned long parsed = std::strtoul(text, &end, 10);
+		if ((end == text) || (*end != '\0') || (parsed > std::numeric_limits<glm::uint32>::max())) return false;
+
+		value = glm::uint32(parsed);
+		return true;
+	}
+
+	bool parseOptions(int argc, char** argv, Options& options) {
+		bool framesGiven = false;
+
+		for (int i = 1; i < argc; ++i) {
+			const std::string option(argv[i]);
+
+			if (option == "--headless") {
+				options.headless = true;
+				continue;
+			}
+
+			if (option == "--stream") {
+				options.stream = true;
+				continue;
+			}
+
+			if (option == "--sah") {
+				options.sah = true;
+				continue;
+			}
+
+			if (option == "--cpu") {
+				options.cpu = true;
+				continue;
+			}
+
+			// Every other option has a value
+			if (i + 1 >= argc) return false;
+			const char* value = argv[++i];
+
+			if (option == "--width") {
+				if ((!parseUnsigned(value, options.width)) || (options.width == 0)) return false;
+			} else if (option == "--height") {
+				if ((!parseUnsigned(value, options.height)) || (options.height == 0)) return false;
+			} else if (option == "--frames") {
+				if (!parseUnsigned(value, options.frames)) return false;
+				framesGiven = true;
+			} else if (option == "--samples") {
+				if ((!parseUnsigned(value, options.samples)) || (options.samples == 0)) return false;
+			} else if (option == "--resident") {
+				if ((!parseUnsigned(value, options.residentModels)) || (options.residentModels == 0)) return false;
+			} else if (option == "--persistent-threads") {
+				if (!parseUnsigned(value, options.persistentThreads)) return false;
+			} else if (option == "--threads") {
+				if (!parseUnsigned(value, options.threads)) return false;
+			} else if (option == "--scene") {
+				options.scene = value;
+			} else if (option == "--load-scene") {
+				options.loadScene = value;
+			} else if (option == "--save-scene") {
+				options.saveScene = value;
+			} else if (option == "--output") {
+				options.output = value;
+			} else if (option == "--compare") {
+				options.compare = value;
+			} else if (option == "--trace") {
+				options.trace = value;
+			} else if (option == "--program-cache") {
+				options.programCache = value;
+			} else {
+				return false;
+			}
+		}
+
+		// Streamed models are always resident
+		if ((options.stream) && (options.residentModels != 0)) return false;
+
+		// Streamed and paged models are built on the GPU
+		if ((options.sah) && ((options.stream) || (options.residentModels != 0))) return false;
+
+		// The CPU renderer has neither background builds, nor paging, nor persistent work groups, nor scene files
+		if ((options.cpu) && ((options.stream) || (options.sah) || (options.residentModels != 0) || (options.persistentThreads != 0) || (!options.loadScene.empty()) || (!options.saveScene.empty()))) return false;
+
+		// There is no window to render the CPU image on
+		if (options.cpu) options.headless = true;
+
+		// Only headless frames are read back
+		if ((!options.compare.empty()) && (!options.headless)) return false;
+
+		// Nobody can close a hidden window: by default render until the image has every sample
+		if ((options.headless) && ((!framesGiven) || (options.frames == 0))) options.frames = options.samples;
+
+		return true;
+	}
+
+	/**
+	 * Rounding and floating point differences between renderers stay within this difference on each channel.
+	 */
+	const glm::uint32 comparisonTolerance = 2;
+
+	/**
+	 * Read the content of the bound framebuffer.
+	 *
+	 * @param width the framebuffer width
+	 * @param height the framebuffer height
+	 * @param pixels RGB triples, row by row starting from the bottom one
+	 */
+	void readFramebuffer(glm::uint32 width, glm::uint32 height, std::vector<glm::uint8>& pixels) {
+		pixels.resize(size_t(width) * 3 * size_t(height));
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, GLsizei(width), GLsizei(height), GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+	}
+
+	/**
+	 * Write an image as a binary PPM image.
+	 *
+	 * @param path the image file
+	 * @param width the image width
+	 * @param height the image height
+	 * @param pixels RGB triples, row by row starting from the bottom one
+	 * @return TRUE on success
+	 */
+	bool writePPM(const std::string& path, glm::uint32 width, glm::uint32 height, const std::vector<glm::uint8>& pixels) {
+		const size_t rowSize = size_t(width) * 3;
+
+		std::ofstream image(path, std::ios::out | std::ios::binary | std::ios::trunc);
+		if (!image.is_open()) return false;
+
+		image << "P6\n" << width << " " << height << "\n255\n";
+
+		// OpenGL rows go from the bottom to the top, PPM rows the other way around
+		for (glm::uint32 row = height; row > 0; --row)
+			image.write(reinterpret_cast<const char*>(pixels.data() + (size_t(row - 1) * rowSize)), std::streamsize(rowSize));
+
+		return image.good();
+	}
+
+	/**
+	 * Read a binary PPM image, as written by writePPM.
+	 *
+	 * @param path the image file
+	 * @param width the image width
+	 * @param height the image height
+	 * @param pixels RGB triples, row by row starting from the bottom one
+	 * @return TRUE on success
+	 */
+	bool readPPM(const std::string& path, glm::uint32& width, glm::uint32& height, std::vector<glm::uint8>& pixels) {
+		std::ifstream image(path, std::ios::in | std::ios::binary);
+		if (!image.is_open()) return false;
+
+		std::string magic;
+		glm::uint32 maxValue = 0;
+		image >> magic >> width >> height >> maxValue;
+		if ((!image.good()) || (magic != "P6") || (maxValue != 255)) return false;
+
+		// A single whitespace separates the header from pixels
+		image.get();
+
+		const size_t rowSize = size_t(width) * 3;
+		pixels.resize(rowSize * size_t(height));
+
+		// PPM rows go from the top to the bottom
+		for (glm::uint32 row = height; row > 0; --row)
+			image.read(reinterpret_cast<char*>(pixels.data() + (size_t(row - 1) * rowSize)), std::streamsize(rowSize));
+
+		return image.good();
+	}
+
+	/**
+	 * Print how much an image differs from a reference PPM image.
+	 *
+	 * @param path the reference image file
+	 * @param width the image width
+	 * @param height the image height
+	 * @param pixels RGB triples, row by row starting from the bottom one
+	 * @return TRUE if the reference image has been read and has the same size
+	 */
+	bool compareWithPPM(const std::string& path, glm::uint32 width, glm::uint32 height, const std::vector<glm::uint8>& pixels) {
+		glm::uint32 referenceWidth = 0, referenceHeight = 0;
+		std::vector<glm::uint8> reference;
+		if (!readPPM(path, referenceWidth, referenceHeight, reference)) {
+			std::cout << "Error: cannot read " << path << std::endl;
+
+			return false;
+		}
+
+		if ((referenceWidth != width) || (referenceHeight != height)) {
+			std::cout << "Error: " << path << " is " << referenceWidth << "x" << referenceHeight << ", not " << width << "x" << height << std::endl;
+
+			return false;
+		}
+
+		glm::uint64 totalDifference = 0;
+		glm::uint32 maxDifference = 0;
+		size_t differentPixels = 0;
+		for (size_t pixel = 0; pixel < pixels.size() / 3; ++pixel) {
+			glm::uint32 pixelDifference = 0;
+			for (size_t channel = (pixel * 3); channel < ((pixel + 1) * 3); ++channel) {
+				const glm::uint32 difference = glm::uint32(std::abs(int(pixels[channel]) - int(reference[channel])));
+
+				totalDifference += difference;
+				pixelDifference = std::max(pixelDifference, difference);
+			}
+
+			maxDifference = std::max(maxDifference, pixelDifference);
+			if (pixelDifference > comparisonTolerance) ++differentPixels;
+		}
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "Compared with " << path << ": mean difference " << (glm::float64(totalDifference) / glm::float64(std::max<size_t>(pixels.size(), 1)))
+			<< ", max difference " << maxDifference << " of 255, "
+			<< (glm::float64(differentPixels) * glm::float64(300) / glm::float64(std::max<size_t>(pixels.size(), 1))) << "% pixels differ by more than " << comparisonTolerance << std::endl;
+
+		return true;
+	}
+
+	void printStatistics(const std::vector<Tachyon::Rendering::StageStatistics>& statistics) {
+		std::cout << std::fixed << std::setprecision(3);
+		for (const auto& stage : statistics)
+			std::cout << "  " << std::left << std::setw(10) << stage.name << std::right
+				<< " samples: " << std::setw(5) << stage.samplesCount
+				<< "  min: " << std::setw(9) << stage.minMilliseconds << " ms"
+				<< "  avg: " << std::setw(9) << stage.averageMilliseconds << " ms"
+				<< "  p99: " << std::setw(9) << stage.p99Milliseconds << " ms" << std::endl;
+	}
+
+	/**
+	 * Render a generated scene headless on the CPU renderer, which needs neither a window nor an OpenGL context.
+	 *
+	 * @param options the configuration given on the command line
+	 * @param scene the generated scene
+	 * @return the exit code of the application
+	 */
+	int renderOnCPU(const Options& options, Tachyon::Scenes::Scene& scene) {
+		Tachyon::Rendering::CPU::CPUPipeline raytracer(scene.capacity, options.threads);
+
+		std::cout << "Rendering with: CPU, " << raytracer.getWorkersCount() << " threads" << std::endl;
+
+		const glm::uint64 loadingBegin = Tachyon::Rendering::FrameProfiler::now();
+		Tachyon::Scenes::loadScene(scene, raytracer);
+		std::cout << "Scene loaded in " << (glm::float64(Tachyon::Rendering::FrameProfiler::now() - loadingBegin) / glm::float64(1000000)) << " ms" << std::endl;
+
+		raytracer.setMaxAccumulatedSamples(options.samples);
+
+		if (!options.trace.empty()) raytracer.setTraceCapture(true);
+
+		// Frames are complete as soon as render returns
+		Tachyon::Rendering::FrameProfiler frameProfiler(std::max<size_t>(options.frames, 240));
+
+		const glm::uint64 renderingBegin = Tachyon::Rendering::FrameProfiler::now();
+
+		glm::uint32 renderedFrames = 0;
+		while (renderedFrames < options.frames) {
+			const glm::uint64 frameBegin = Tachyon::Rendering::FrameProfiler::now();
+
+			raytracer.render(options.width, options.height);
+
+			frameProfiler.record("Frame", frameBegin, Tachyon::Rendering::FrameProfiler::now());
+			++renderedFrames;
+		}
+
+		const glm::float64 renderingSeconds = glm::float64(Tachyon::Rendering::FrameProfiler::now() - renderingBegin) / glm::float64(1000000000);
+
+		bool compared = true;
+		if (renderedFrames > 0) {
+			// Pixels are tone mapped as the OpenGL renderer displays them, so that images of both renderers can be compared
+			std::vector<glm::uint8> pixels;
+			raytracer.getDisplayPixels(pixels);
+
+			if (writePPM(options.output, options.width, options.height, pixels)) {
+				std::cout << "Last frame written to " << options.output << std::endl;
+			} else {
+				std::cout << "Error: cannot write " << options.output << std::endl;
+			}
+
+			if (!options.compare.empty()) compared = compareWithPPM(options.compare, options.width, options.height, pixels);
+		}
+
+		std::cout << "Rendered " << renderedFrames << " frames at " << options.width << "x" << options.height
+			<< " in " << renderingSeconds << " s (" << (glm::float64(renderedFrames) / std::max(renderingSeconds, glm::float64(1e-9))) << " frames/s)" << std::endl;
+		printStatistics(frameProfiler.getStatistics());
+		printStatistics(raytracer.getFrameStats());
+
+		if ((!options.trace.empty()) && (!raytracer.writeChromeTrace(options.trace)))
+			std::cout << "Error: cannot write " << options.trace << std::endl;
+
+		return (compared) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+}
+
 int main(int argc, char** argv) {
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+
+		return EXIT_FAILURE;
+	}
+
+	// A scene file is mapped upfront, as the pipeline capacity is stored on it
+	std::unique_ptr<Tachyon::Rendering::OpenGL::SceneFile> sceneFile;
+	Tachyon::Scenes::Scene scene;
+	if (!options.loadScene.empty()) {
+		sceneFile.reset(new Tachyon::Rendering::OpenGL::SceneFile(options.loadScene));
+		if (!sceneFile->isValid()) {
+			std::cout << "Error: " << options.loadScene << " is not a valid scene file" << std::endl;
+
+			return EXIT_FAILURE;
+		}
+
+		scene.capacity = sceneFile->getCapacity();
+	} else if (!Tachyon::Scenes::makeScene(options.scene, scene)) {
+		std::cout << "Error: unknown scene " << options.scene << std::endl;
+
+		return EXIT_FAILURE;
+	} else if (options.residentModels != 0) {
+		// BLASes come in powers of two: round the working set up
+		glm::uint32 expOfTwo_maxResidentModels = 0;
+		while ((glm::uint64(1) << expOfTwo_maxResidentModels) < options.residentModels) ++expOfTwo_maxResidentModels;
+
+		scene.capacity.expOfTwo_maxResidentModels = std::min(expOfTwo_maxResidentModels, scene.capacity.expOfTwo_maxModels);
+	}
+
+	// The CPU renderer does not need GLFW at all
+	if (options.cpu) return renderOnCPU(options, scene);
 
 	// Initialize GLFW
 	if (glfwInit() == 0) {
@@ -53,11 +491,10 @@ int main(int argc, char** argv) {
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-	// TODO: let the user decide the input antialiasing
-	glfwWindowHint(GLFW_SAMPLES, 16);
+	// The headless mode renders on its own framebuffer: the hidden window only provides the context
+	glfwWindowHint(GLFW_VISIBLE, (options.headless) ? GLFW_FALSE : GLFW_TRUE);
 
-	// TODO: let the user specify preferred resolution
-	GLFWwindow* window = glfwCreateWindow(480, 360, "Tachyon Raytracer", nullptr, nullptr);
+	GLFWwindow* window = glfwCreateWindow(int(options.width), int(options.height), "Tachyon Raytracer", nullptr, nullptr);
 
 	if (!window) {
 		std::cout << "Error: cannot open a window" << std::endl;
@@ -84,11 +521,6 @@ int main(int argc, char** argv) {
 	glEnable(GL_DEBUG_OUTPUT);
 	glDebugMessageCallback(MessageCallback, 0);
 
-	// Retrieve the initial window size to initialize the renderer
-	int initialWidth, initialHeight;
-	glfwGetWindowSize(window, &initialWidth, &initialHeight);
-
-
 	std::string rendererId =
 		std::string("OpenGL v") +
 		std::string((const char*)glGetString(GL_VERSION)) +
@@ -114,36 +546,218 @@ int main(int argc, char** argv) {
 
 	std::cout << "Max SSBO Block size: " << maxBlockSize << std::endl;
 
+	// In headless mode frames are rendered on an offscreen framebuffer, as the hidden window one may not be backed by memory
+	GLuint headlessFramebuffer = 0, headlessColorbuffer = 0;
+	if (options.headless) {
+		glCreateRenderbuffers(1, &headlessColorbuffer);
+		glNamedRenderbufferStorage(headlessColorbuffer, GL_RGBA8, GLsizei(options.width), GLsizei(options.height));
+
+		glCreateFramebuffers(1, &headlessFramebuffer);
+		glNamedFramebufferRenderbuffer(headlessFramebuffer, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, headlessColorbuffer);
+
+		if (glCheckNamedFramebufferStatus(headlessFramebuffer, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+			std::cout << "Error: cannot create the offscreen framebuffer" << std::endl;
+
+			return EXIT_FAILURE;
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, headlessFramebuffer);
+	}
+
 	// Now it is safe to create the renderer
-	std::unique_ptr<Tachyon::Rendering::OpenGL::OpenGLPipeline> raytracer(new Tachyon::Rendering::OpenGL::OpenGLPipeline());
+	Tachyon::Rendering::OpenGL::Pipeline::Program::setBinaryCacheDirectory(options.programCache);
+	std::unique_ptr<Tachyon::Rendering::OpenGL::OpenGLPipeline> raytracer(new Tachyon::Rendering::OpenGL::OpenGLPipeline(scene.capacity));
+
+	// Paged models are placed as proxies, only those rays reach are ever built
+	std::unique_ptr<Tachyon::Rendering::OpenGL::ResidencyManager> residencyManager;
+
+	const glm::uint64 loadingBegin = Tachyon::Rendering::FrameProfiler::now();
+	if (sceneFile) {
+		if (!raytracer->importScene(*sceneFile)) {
+			std::cout << "Error: cannot load " << options.loadScene << std::endl;
+
+			return EXIT_FAILURE;
+		}
+
+		// The mapping is not needed once sections have been uploaded
+		sceneFile.reset();
+	} else if (options.residentModels != 0) {
+		residencyManager.reset(new Tachyon::Rendering::OpenGL::ResidencyManager(*raytracer));
+
+		std::unordered_map<GLuint, glm::mat4> sceneTransforms;
+		for (const auto& modelTransform : scene.transforms)
+			sceneTransforms[modelTransform.location] = modelTransform.transform;
+
+		// Models are paged one by one: instances are paged as copies of their model
+		std::unordered_map<GLuint, const Tachyon::Rendering::Model*> sceneModels;
+		for (const auto& model : scene.models)
+			sceneModels[model.location] = &model;
+
+		for (const auto& instance : scene.instances) {
+			const auto source = sceneModels.find(instance.source);
+			if (source == sceneModels.end()) continue;
+
+			const auto transform = sceneTransforms.find(instance.location);
+			residencyManager->addModel(std::vector<Tachyon::Rendering::GeometryPrimitive>(source->second->primitives), (transform != sceneTransforms.end()) ? transform->second : glm::mat4(1));
+		}
+
+		for (auto& model : scene.models) {
+			const auto transform = sceneTransforms.find(model.location);
+			residencyManager->addModel(std::move(model.primitives), (transform != sceneTransforms.end()) ? transform->second : glm::mat4(1));
+		}
+	} else if (options.sah) {
+		raytracer->reset();
+		raytracer->enqueueStaticModels(std::move(scene.models));
+
+		if (!scene.instances.empty())
+			raytracer->enqueueInstances(scene.instances);
+
+		if (!scene.transforms.empty())
+			raytracer->setModelTransforms(scene.transforms);
+	} else if (!options.stream) {
+		Tachyon::Scenes::loadScene(scene, *raytracer);
+	}
+	glFinish();
+	std::cout << "Scene loaded in " << (glm::float64(Tachyon::Rendering::FrameProfiler::now() - loadingBegin) / glm::float64(1000000)) << " ms" << std::endl;
+
+	// Streamed models are placed as soon as they are published: the scene is exported once every model has been
+	std::unique_ptr<Tachyon::Rendering::OpenGL::SceneStreamer> streamer;
+	std::unordered_map<GLuint, glm::mat4> streamedTransforms;
+	std::unordered_multimap<GLuint, GLuint> streamedInstances;
+	if ((options.stream) && (!sceneFile)) {
+		streamer.reset(new Tachyon::Rendering::OpenGL::SceneStreamer(*raytracer, window));
+
+		for (const auto& modelTransform : scene.transforms)
+			streamedTransforms[modelTransform.location] = modelTransform.transform;
+
+		// Instances are placed as soon as their model has been published
+		for (const auto& instance : scene.instances)
+			streamedInstances.insert(std::make_pair(instance.source, instance.location));
+
+		std::vector<Tachyon::Rendering::Model> models(scene.models);
+		streamer->enqueueModels(std::move(models));
+	} else if ((!options.saveScene.empty()) && (!raytracer->exportScene(options.saveScene))) {
+		std::cout << "Error: cannot write " << options.saveScene << std::endl;
+	}
 
-	raytracer->reset();
+	// Anti-aliasing comes from samples accumulated over frames, rather than from a multisampled framebuffer
+	raytracer->setMaxAccumulatedSamples(options.samples);
 
-	raytracer->enqueueModel({
-		Tachyon::Rendering::GeometryPrimitive(glm::vec3(0, 0, -1), 0.5),
-		Tachyon::Rendering::GeometryPrimitive(glm::vec3(0.75, 0, -1.5), 0.25),
-		Tachyon::Rendering::GeometryPrimitive(glm::vec3(0, -100.5, -1), 100),
-		}, 0);
+	raytracer->setPersistentThreads(options.persistentThreads);
+
+	if (!options.trace.empty()) raytracer->setTraceCapture(true);
+
+	// Wall-clock frame times, measured up to the completion of each frame on the GPU
+	Tachyon::Rendering::FrameProfiler frameProfiler(std::max<size_t>(options.frames, 240));
+
+	glFinish();
+	const glm::uint64 renderingBegin = Tachyon::Rendering::FrameProfiler::now();
+
+	glm::uint32 renderedFrames = 0;
+	while ((options.frames == 0) ? (!glfwWindowShouldClose(window)) : ((renderedFrames < options.frames) || ((streamer) && (streamer->getPendingModelsCount() > 0)))) {
+		const glm::uint64 frameBegin = Tachyon::Rendering::FrameProfiler::now();
 
-	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
 
-		int windowWidth, windowHeight;
-		glfwGetWindowSize(window, &windowWidth, &windowHeight);
+		// Models built meanwhile join the scene, without waiting for those still being built
+		if (streamer) {
+			std::vector<GLuint> locations = streamer->publish();
+
+			// Instances are moved together with published models
+			std::vector<Tachyon::Rendering::ModelInstance> instances;
+			const size_t publishedCount = locations.size();
+			for (size_t published = 0; published < publishedCount; ++published) {
+				const auto sourceInstances = streamedInstances.equal_range(locations[published]);
+				for (auto instance = sourceInstances.first; instance != sourceInstances.second; ++instance) {
+					instances.push_back(Tachyon::Rendering::ModelInstance{ locations[published], instance->second });
+					locations.push_back(instance->second);
+				}
+			}
 
-		raytracer->render(static_cast<glm::uint32>(windowWidth), static_cast<glm::uint32>(windowHeight));
+			if (!instances.empty()) raytracer->enqueueInstances(instances);
 
-		glfwSwapBuffers(window);
+			std::vector<Tachyon::Rendering::ModelTransform> transforms;
+			for (const auto location : locations) {
+				const auto transform = streamedTransforms.find(location);
+				if (transform != streamedTransforms.end()) transforms.push_back(Tachyon::Rendering::ModelTransform{ location, transform->second });
+			}
+
+			if (!transforms.empty()) raytracer->setModelTransforms(transforms);
+		}
+
+		// Models that rays have reached on previous frames are paged in
+		if (residencyManager) residencyManager->update();
+
+		if (options.headless) {
+			raytracer->render(options.width, options.height);
+
+			glFinish();
+		} else {
+			int windowWidth, windowHeight;
+			glfwGetWindowSize(window, &windowWidth, &windowHeight);
+
+			raytracer->render(static_cast<glm::uint32>(windowWidth), static_cast<glm::uint32>(windowHeight));
+
+			glfwSwapBuffers(window);
+		}
+
+		frameProfiler.record("Frame", frameBegin, Tachyon::Rendering::FrameProfiler::now());
+		++renderedFrames;
+	}
+
+	const glm::float64 renderingSeconds = glm::float64(Tachyon::Rendering::FrameProfiler::now() - renderingBegin) / glm::float64(1000000000);
+
+	// The worker context must be destroyed before the pipeline and by the main thread
+	if (streamer) {
+		streamer.reset();
+
+		if ((!options.saveScene.empty()) && (!raytracer->exportScene(options.saveScene)))
+			std::cout << "Error: cannot write " << options.saveScene << std::endl;
 	}
 
+	bool compared = true;
+	if ((options.headless) && (renderedFrames > 0)) {
+		std::vector<glm::uint8> pixels;
+		readFramebuffer(options.width, options.height, pixels);
+
+		if (writePPM(options.output, options.width, options.height, pixels)) {
+			std::cout << "Last frame written to " << options.output << std::endl;
+		} else {
+			std::cout << "Error: cannot write " << options.output << std::endl;
+		}
+
+		if (!options.compare.empty()) compared = compareWithPPM(options.compare, options.width, options.height, pixels);
+	}
+
+	std::cout << "Rendered " << renderedFrames << " frames at " << options.width << "x" << options.height
+		<< " in " << renderingSeconds << " s (" << (glm::float64(renderedFrames) / std::max(renderingSeconds, glm::float64(1e-9))) << " frames/s)" << std::endl;
+	printStatistics(frameProfiler.getStatistics());
+	printStatistics(raytracer->getFrameStats());
+
+	if (residencyManager) {
+		std::cout << "Resident models: " << residencyManager->getResidentModelsCount() << " of " << residencyManager->getModelsCount() << std::endl;
+
+		residencyManager.reset();
+	}
+
+	if ((!options.trace.empty()) && (!raytracer->writeChromeTrace(options.trace)))
+		std::cout << "Error: cannot write " << options.trace << std::endl;
+
 	// Destroy the renderer
 	raytracer.reset();
 
+	// Destroy the offscreen framebuffer
+	if (options.headless) {
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &headlessFramebuffer);
+		glDeleteRenderbuffers(1, &headlessColorbuffer);
+	}
+
 	// Destroy the renderer surface
 	glfwDestroyWindow(window);
 
 	// Terminate GLFW
 	glfwTerminate();
 
-    return EXIT_SUCCESS;
+    return (compared) ? EXIT_SUCCESS : EXIT_FAILURE;
 }